@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Compare the query throughput of the C callback API and of the C++ coroutine
+ * front-end (caniot/controller.hpp).
+ *
+ * Every device is queried QUERIES times in a row, by a state machine in the
+ * event callback (C) or by one coroutine per device (C++). The driver is a
+ * loopback answering every query, so that only the controller and the
+ * dispatch of the responses are measured.
+ *
+ * Heap allocations are counted to check that awaiting a query does not
+ * allocate: only coroutines creation does.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+#include <caniot/caniot_private.h>
+#include <caniot/controller.hpp>
+
+#define DEVICES	  32u
+#define QUERIES	  (1u << 15u)
+#define LOOP_SIZE 64u
+
+static uint64_t allocations;
+
+void *operator new(std::size_t size)
+{
+	allocations++;
+
+	void *const ptr = std::malloc(size);
+	if (ptr == nullptr) throw std::bad_alloc();
+
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t size) noexcept
+{
+	(void)size;
+	std::free(ptr);
+}
+
+/* Loopback FIFO, every query sent is answered */
+static struct {
+	struct caniot_frame frames[LOOP_SIZE];
+	uint32_t head;
+	uint32_t tail;
+} loop;
+
+static void get_time(uint32_t *sec, uint16_t *ms)
+{
+	*sec = 0u;
+	if (ms != NULL) *ms = 0u;
+}
+
+static int loop_send(const struct caniot_frame *frame, uint32_t delay_ms)
+{
+	(void)delay_ms;
+
+	if (loop.tail - loop.head == LOOP_SIZE) return -CANIOT_EAGAIN;
+
+	struct caniot_frame *const resp = &loop.frames[loop.tail++ % LOOP_SIZE];
+
+	*resp	       = *frame;
+	resp->id.query = CANIOT_RESPONSE;
+	resp->len      = 8u;
+
+	return 0;
+}
+
+static int loop_recv(struct caniot_frame *frame)
+{
+	if (loop.head == loop.tail) return -CANIOT_EAGAIN;
+
+	*frame = loop.frames[loop.head++ % LOOP_SIZE];
+
+	return 0;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000llu + ts.tv_nsec;
+}
+
+static struct caniot_drivers_api loop_driv(void)
+{
+	struct caniot_drivers_api driv = {};
+
+	driv.get_time = get_time;
+	driv.send     = loop_send;
+	driv.recv     = loop_recv;
+
+	return driv;
+}
+
+/*____________________________________________________________________________*/
+
+struct c_ctx {
+	struct caniot_frame req;
+	uint32_t remaining[DEVICES];
+	uint32_t done;
+};
+
+static bool c_event_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	struct c_ctx *const ctx = static_cast<struct c_ctx *>(user_data);
+
+	if (ev->status != CANIOT_CONTROLLER_EVENT_STATUS_OK) return true;
+
+	ctx->done++;
+	if (--ctx->remaining[ev->did] != 0u) {
+		caniot_controller_query(ev->controller, ev->did, &ctx->req, 1000u);
+	}
+
+	return true;
+}
+
+static double bench_c(void)
+{
+	const struct caniot_drivers_api driv = loop_driv();
+	struct caniot_controller ctrl;
+	struct c_ctx ctx;
+
+	caniot_build_query_telemetry(&ctx.req, CANIOT_ENDPOINT_APP);
+	ctx.done = 0u;
+
+	caniot_controller_driv_init(&ctrl, &driv, c_event_cb, &ctx);
+
+	const uint64_t start = now_ns();
+
+	for (caniot_did_t did = 0u; did < DEVICES; did++) {
+		ctx.remaining[did] = QUERIES;
+		caniot_controller_query(&ctrl, did, &ctx.req, 1000u);
+	}
+
+	while (ctx.done != DEVICES * QUERIES) {
+		caniot_controller_process(&ctrl);
+	}
+
+	const uint64_t elapsed = now_ns() - start;
+
+	caniot_controller_deinit(&ctrl);
+
+	return (double)DEVICES * QUERIES * 1000000000.0 / elapsed;
+}
+
+/*____________________________________________________________________________*/
+
+static caniot::task poll(caniot::controller &ctrl, caniot_did_t did, uint32_t &done)
+{
+	struct caniot_frame req;
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+
+	for (uint32_t i = 0u; i < QUERIES; i++) {
+		const caniot::query_result res = co_await ctrl.query(did, req, 1000u);
+		if (!res.ok()) break;
+
+		done++;
+	}
+}
+
+static double bench_coro(uint64_t *query_allocations)
+{
+	const struct caniot_drivers_api driv = loop_driv();
+	caniot::controller ctrl(&driv);
+	caniot::task tasks[DEVICES];
+	uint32_t done = 0u;
+
+	const uint64_t start = now_ns();
+
+	for (caniot_did_t did = 0u; did < DEVICES; did++) {
+		tasks[did] = poll(ctrl, did, done);
+	}
+
+	const uint64_t allocated = allocations;
+
+	while (done != DEVICES * QUERIES) {
+		ctrl.process();
+	}
+
+	const uint64_t elapsed = now_ns() - start;
+
+	*query_allocations = allocations - allocated;
+
+	return (double)DEVICES * QUERIES * 1000000000.0 / elapsed;
+}
+
+int main(void)
+{
+	uint64_t query_allocations;
+
+	const double c	  = bench_c();
+	const double coro = bench_coro(&query_allocations);
+
+	printf("%8s %16s %8s\n", "api", "queries/s", "ratio");
+	printf("%8s %16.0f %8.2f\n", "C", c, 1.0);
+	printf("%8s %16.0f %8.2f\n", "C++", coro, coro / c);
+	printf("heap allocations while awaiting %u queries: %lu\n",
+	       DEVICES * QUERIES,
+	       (unsigned long)query_allocations);
+
+	return 0;
+}
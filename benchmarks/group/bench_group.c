@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Measure the query throughput of a controller group depending on the number
+ * of buses.
+ *
+ * Each bus is a loopback driver answering every frame sent by its controller,
+ * one producer thread per bus submits queries (without timeout) as fast as the
+ * submission ring accepts them. Responses are counted in the group callback.
+ *
+ * Throughput should scale with the number of buses as long as there are
+ * enough cores for the bus and producer threads.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <caniot/caniot_private.h>
+#include <caniot/ctrl_group.h>
+
+#define DURATION_MS 500u
+#define MAX_BUSES   CONFIG_CANIOT_CTRL_GROUP_MAX_BUSES
+#define LOOP_SIZE   64u
+
+/* Loopback FIFO of a bus, only accessed by the bus thread */
+static struct {
+	struct caniot_frame frames[LOOP_SIZE];
+	uint32_t head;
+	uint32_t tail;
+} loops[MAX_BUSES];
+
+static uint64_t responses;
+static bool producing;
+
+static void get_time(uint32_t *sec, uint16_t *ms)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	*sec = ts.tv_sec;
+	if (ms != NULL) *ms = ts.tv_nsec / 1000000u;
+}
+
+static int loop_send(uint8_t bus, const struct caniot_frame *frame)
+{
+	if (loops[bus].head - loops[bus].tail == LOOP_SIZE) return -CANIOT_EAGAIN;
+
+	struct caniot_frame *const resp = &loops[bus].frames[loops[bus].head++ % LOOP_SIZE];
+
+	*resp	       = *frame;
+	resp->id.query = CANIOT_RESPONSE;
+
+	return 0;
+}
+
+static int loop_recv(uint8_t bus, struct caniot_frame *frame)
+{
+	if (loops[bus].head == loops[bus].tail) return -CANIOT_EAGAIN;
+
+	*frame = loops[bus].frames[loops[bus].tail++ % LOOP_SIZE];
+
+	return 0;
+}
+
+#define LOOP_DRIVERS(_n)                                                                 \
+	static int loop_send##_n(const struct caniot_frame *frame, uint32_t delay_ms)    \
+	{                                                                                \
+		(void)delay_ms;                                                          \
+		return loop_send(_n, frame);                                             \
+	}                                                                                \
+	static int loop_recv##_n(struct caniot_frame *frame)                             \
+	{                                                                                \
+		return loop_recv(_n, frame);                                             \
+	}
+
+LOOP_DRIVERS(0)
+LOOP_DRIVERS(1)
+LOOP_DRIVERS(2)
+LOOP_DRIVERS(3)
+
+static const struct caniot_drivers_api drivs[] = {
+	{.get_time = get_time, .send = loop_send0, .recv = loop_recv0},
+	{.get_time = get_time, .send = loop_send1, .recv = loop_recv1},
+	{.get_time = get_time, .send = loop_send2, .recv = loop_recv2},
+	{.get_time = get_time, .send = loop_send3, .recv = loop_recv3},
+};
+
+static bool event_cb(struct caniot_ctrl_group *group,
+		     uint8_t bus,
+		     const caniot_controller_event_t *ev,
+		     void *user_data)
+{
+	(void)group;
+	(void)bus;
+	(void)ev;
+	(void)user_data;
+
+	responses++; /* callback calls are serialized */
+
+	return true;
+}
+
+struct producer {
+	struct caniot_ctrl_group *group;
+	uint8_t bus;
+};
+
+static void *producer_thread(void *arg)
+{
+	struct producer *p = arg;
+	struct caniot_frame req;
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+
+	while (__atomic_load_n(&producing, __ATOMIC_ACQUIRE)) {
+		caniot_ctrl_group_submit(p->group, p->bus, p->bus, &req, 0u, NULL, NULL);
+	}
+
+	return NULL;
+}
+
+static double bench(uint8_t buses)
+{
+	struct caniot_ctrl_group group;
+	struct producer producers[MAX_BUSES];
+	pthread_t threads[MAX_BUSES];
+
+	caniot_ctrl_group_init(&group, event_cb, NULL);
+	for (uint8_t bus = 0u; bus < buses; bus++) {
+		loops[bus].head = loops[bus].tail = 0u;
+		caniot_ctrl_group_add_bus(&group, &drivs[bus]);
+	}
+	group.poll_period_us = 0u;
+
+	responses = 0u;
+	producing = true;
+	caniot_ctrl_group_start(&group);
+
+	for (uint8_t bus = 0u; bus < buses; bus++) {
+		producers[bus].group = &group;
+		producers[bus].bus   = bus;
+		pthread_create(&threads[bus], NULL, producer_thread, &producers[bus]);
+	}
+
+	usleep(DURATION_MS * 1000u);
+
+	__atomic_store_n(&producing, false, __ATOMIC_RELEASE);
+	for (uint8_t bus = 0u; bus < buses; bus++) {
+		pthread_join(threads[bus], NULL);
+	}
+	caniot_ctrl_group_stop(&group);
+
+	return responses * 1000.0 / DURATION_MS;
+}
+
+int main(void)
+{
+	printf("%8s %16s %8s (%ld cores)\n",
+	       "buses",
+	       "queries/s",
+	       "scaling",
+	       sysconf(_SC_NPROCESSORS_ONLN));
+
+	const double single = bench(1u);
+	printf("%8u %16.0f %8.2f\n", 1u, single, 1.0);
+
+	for (uint8_t buses = 2u; buses <= ARRAY_SIZE(drivs); buses++) {
+		const double qps = bench(buses);
+		printf("%8u %16.0f %8.2f\n", buses, qps, qps / single);
+	}
+
+	return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Compare the controller receive throughput when frames are passed one by one
+ * (caniot_controller_rx_frame()) or by bursts (caniot_controller_rx_frames()).
+ *
+ * A query is pending on every device, the bus traffic is made of telemetry
+ * frames which do not answer them, the timeout queue is aged by 1 ms per frame.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <caniot/caniot_private.h>
+#include <caniot/controller.h>
+
+#define SEED 0
+
+#define FRAMES	  (1u << 20u)
+#define MAX_BURST 256u
+
+static struct caniot_frame traffic[FRAMES];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000llu + ts.tv_nsec;
+}
+
+static bool event_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	(void)ev;
+	(*(uint32_t *)user_data)++;
+
+	return true;
+}
+
+static void setup(struct caniot_controller *ctrl, uint32_t *events)
+{
+	struct caniot_frame req;
+
+	caniot_controller_init(ctrl, event_cb, events);
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	for (caniot_did_t did = 0u; did < CANIOT_DID_BROADCAST; did++) {
+		caniot_controller_query_register(ctrl, did, &req, 100000000u);
+	}
+}
+
+static double bench(uint32_t burst)
+{
+	struct caniot_controller ctrl;
+	uint32_t events = 0u;
+
+	setup(&ctrl, &events);
+
+	const uint64_t start = now_ns();
+
+	for (uint32_t i = 0u; i < FRAMES; i += burst) {
+		if (burst == 1u) {
+			caniot_controller_rx_frame(&ctrl, 1u, &traffic[i]);
+		} else {
+			caniot_controller_rx_frames(&ctrl, burst, &traffic[i], burst);
+		}
+	}
+
+	const uint64_t elapsed = now_ns() - start;
+
+	if (events != FRAMES) {
+		printf("unexpected events count %u\n", events);
+	}
+
+	return (double)FRAMES * 1000000000.0 / elapsed;
+}
+
+int main(void)
+{
+	srand(SEED);
+
+	for (uint32_t i = 0u; i < FRAMES; i++) {
+		const caniot_did_t did = rand() % CANIOT_DID_BROADCAST;
+
+		caniot_build_query_telemetry(&traffic[i], CANIOT_ENDPOINT_BOARD_CONTROL);
+		traffic[i].id.query = CANIOT_RESPONSE;
+		traffic[i].id.cls   = CANIOT_DID_CLS(did);
+		traffic[i].id.sid   = CANIOT_DID_SID(did);
+		traffic[i].len	    = 8u;
+	}
+
+	const double single = bench(1u);
+
+	printf("%8s %16s %8s\n", "burst", "frames/s", "gain");
+	printf("%8u %16.0f %8.2f\n", 1u, single, 1.0);
+
+	for (uint32_t burst = 8u; burst <= MAX_BURST; burst *= 2u) {
+		const double fps = bench(burst);
+
+		printf("%8u %16.0f %8.2f\n", burst, fps, fps / single);
+	}
+
+	return 0;
+}
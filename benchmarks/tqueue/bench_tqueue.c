@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Compare the controller timeout queue backends (delta list vs timing wheel).
+ *
+ * N pending queries are kept in the queue, each round emulates a controller
+ * iteration: a response cancels a random query, a new query is queued, then
+ * the queue is aged by 1 ms and expired queries are re-queued.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <caniot/caniot_private.h>
+#include <caniot/tqueue.h>
+
+#define SEED 0
+
+#define MAX_PENDING 4096u
+#define ROUNDS	    20000u
+
+#define TIMEOUT_MIN 100u
+#define TIMEOUT_MAX 5000u
+
+static uint32_t rdm_timeout(void)
+{
+	return TIMEOUT_MIN + (rand() % (TIMEOUT_MAX - TIMEOUT_MIN + 1u));
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000llu + ts.tv_nsec;
+}
+
+static struct caniot_pendq_time_handle dlist_items[MAX_PENDING];
+
+static double bench_dlist(uint32_t pending)
+{
+	struct caniot_pendq_time_handle *root = NULL;
+	struct caniot_pendq_time_handle *item;
+
+	srand(SEED);
+
+	for (uint32_t i = 0u; i < pending; i++) {
+		dlist_items[i].next    = NULL;
+		dlist_items[i].timeout = rdm_timeout();
+		caniot_tqueue_queue(&root, &dlist_items[i]);
+	}
+
+	const uint64_t start = now_ns();
+
+	for (uint32_t r = 0u; r < ROUNDS; r++) {
+		item = &dlist_items[rand() % pending];
+		if (caniot_tqueue_remove(&root, item)) {
+			item->timeout = rdm_timeout();
+			caniot_tqueue_queue(&root, item);
+		}
+
+		caniot_tqueue_shift(&root, 1u);
+		while ((item = caniot_tqueue_pop_expired(&root)) != NULL) {
+			item->next    = NULL;
+			item->timeout = rdm_timeout();
+			caniot_tqueue_queue(&root, item);
+		}
+	}
+
+	return (double)(now_ns() - start) / ROUNDS;
+}
+
+static struct caniot_twheel wheel;
+static struct caniot_twheel_node wheel_nodes[MAX_PENDING];
+
+static double bench_twheel(uint32_t pending)
+{
+	struct caniot_twheel_node *node;
+
+	srand(SEED);
+
+	caniot_twheel_init(&wheel);
+
+	for (uint32_t i = 0u; i < pending; i++) {
+		caniot_twheel_add(&wheel, &wheel_nodes[i], rdm_timeout());
+	}
+
+	const uint64_t start = now_ns();
+
+	for (uint32_t r = 0u; r < ROUNDS; r++) {
+		node = &wheel_nodes[rand() % pending];
+		if (caniot_twheel_remove(&wheel, node)) {
+			caniot_twheel_add(&wheel, node, rdm_timeout());
+		}
+
+		caniot_twheel_advance(&wheel, 1u);
+		while ((node = caniot_twheel_pop_expired(&wheel)) != NULL) {
+			caniot_twheel_add(&wheel, node, rdm_timeout());
+		}
+	}
+
+	return (double)(now_ns() - start) / ROUNDS;
+}
+
+int main(void)
+{
+	printf("%8s %16s %16s %8s\n", "pending", "dlist (ns/iter)", "twheel (ns/iter)", "ratio");
+
+	for (uint32_t pending = 4u; pending <= MAX_PENDING; pending *= 2u) {
+		const double dlist  = bench_dlist(pending);
+		const double twheel = bench_twheel(pending);
+
+		printf("%8u %16.1f %16.1f %8.2f\n", pending, dlist, twheel, dlist / twheel);
+	}
+
+	return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CANIOT_BUSLOAD_H_
+#define _CANIOT_BUSLOAD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <caniot/caniot.h>
+#include <caniot/caniot_config.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*____________________________________________________________________________*/
+
+/* Bit time of CAN frames
+ *
+ * A standard data frame is made of 34 + 8 * len bits subject to bit stuffing
+ * (SOF, identifier, RTR, IDE, r0, DLC, data and CRC), a stuff bit being
+ * inserted after 5 consecutive bits of the same level, and 13 bits which are
+ * not (CRC delimiter, ACK slot and delimiter, EOF and interframe space).
+ *
+ * CANIOT_FRAME_BITS_MAX() gives the worst case.
+ *
+ * Frames are not processed a bit at a time: the CRC is computed a nibble at a
+ * time and stuff bits are counted a run of bits of the same level at a time.
+ */
+
+/**
+ * @brief Exact number of bits a standard data frame takes on the bus, stuff
+ * bits included.
+ *
+ * @param std_id 11-bit identifier
+ * @param data Payload
+ * @param len Payload length (at most 8)
+ */
+uint32_t caniot_can_frame_bits(uint16_t std_id, const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Exact number of bits a CANIOT frame takes on the bus
+ */
+uint32_t caniot_frame_bits(const struct caniot_frame *frame);
+
+/**
+ * @brief Number of bits of each frame of a trace (e.g. a capture) and their
+ * total, to measure the load of a trace.
+ *
+ * Frames are processed one after the other (the CRC and the stuffing of a
+ * frame are serial), the arguments are only checked once for the whole trace.
+ *
+ * @param frames Frames
+ * @param count Number of frames
+ * @param bits Number of bits of each frame, can be NULL
+ * @return uint64_t Total number of bits
+ */
+uint64_t caniot_frames_bits(const struct caniot_frame *frames,
+			    size_t count,
+			    uint32_t *bits);
+
+/*____________________________________________________________________________*/
+
+#if CONFIG_CANIOT_BUSLOAD
+
+/**
+ * @brief Rolling bus load meter
+ *
+ * Bits of the frames seen are accumulated in CONFIG_CANIOT_BUSLOAD_BUCKETS
+ * buckets of CONFIG_CANIOT_BUSLOAD_BUCKET_MS, the load is measured over the
+ * last full buckets and the current one.
+ *
+ * Times passed to a meter must come from a single clock: attach a meter to
+ * either a controller (caniot_controller_busload_attach(), controller time) or
+ * a device (caniot_device_busload_attach(), drivers API time). It is not
+ * thread-safe.
+ */
+struct caniot_busload {
+	uint32_t bitrate; /* bit/s */
+
+	/* Bits of each bucket, "head" is the current one */
+	uint32_t buckets[CONFIG_CANIOT_BUSLOAD_BUCKETS];
+	uint8_t head;
+
+	/* Time the current bucket started at (ms) */
+	uint32_t head_ms;
+
+	/* Time the meter was initialized at (ms) */
+	uint32_t start_ms;
+
+	/* Totals since initialization */
+	uint64_t bits;
+	uint32_t frames;
+};
+
+void caniot_busload_init(struct caniot_busload *bl, uint32_t bitrate, uint32_t now_ms);
+
+/**
+ * @brief Account "bits" of bus time at "now_ms"
+ */
+void caniot_busload_add(struct caniot_busload *bl, uint32_t now_ms, uint32_t bits);
+
+/**
+ * @brief Account a frame (exact bit count) at "now_ms"
+ */
+void caniot_busload_add_frame(struct caniot_busload *bl,
+			      uint32_t now_ms,
+			      const struct caniot_frame *frame);
+
+/**
+ * @brief Number of bits seen within the window ending at "now_ms"
+ */
+uint32_t caniot_busload_window_bits(struct caniot_busload *bl, uint32_t now_ms);
+
+/**
+ * @brief Bus load within the window ending at "now_ms", in 1/10000
+ * (10000 is 100 %)
+ *
+ * The window is CONFIG_CANIOT_BUSLOAD_BUCKETS - 1 buckets plus the time
+ * elapsed in the current one.
+ */
+uint32_t caniot_busload_get(struct caniot_busload *bl, uint32_t now_ms);
+
+#endif /* CONFIG_CANIOT_BUSLOAD */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CANIOT_BUSLOAD_H_ */
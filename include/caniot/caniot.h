@@ -181,6 +181,14 @@ struct caniot_frame {
 
 typedef struct caniot_frame caniot_frame_t;
 
+/**
+ * @brief Worst-case number of bits a standard (11-bit ID) data frame with "len"
+ * bytes of payload takes on the bus: 47 bits of framing (interframe space
+ * included), 8 bits per byte and, at worst, a stuff bit every 4 bits (after the
+ * first 5) of the 34 + 8 * len bits subject to bit stuffing.
+ */
+#define CANIOT_FRAME_BITS_MAX(len) (47u + 8u * (len) + (33u + 8u * (len)) / 4u)
+
 struct caniot_drivers_api {
 
 	/* Fill the buffer with random data */
@@ -198,8 +206,12 @@ struct caniot_drivers_api {
 	 * Note:
 	 * 	- Should not block.
 	 * 	- Should be thread safe (in a multi-threaded environment).
+	 * 	- With CONFIG_CANIOT_TXQ, "delay_ms" is always 0 (delays are handled
+	 * 	  by the library).
 	 *
-	 * Return 0 on success, any other value on error.
+	 * Return 0 on success, -CANIOT_EAGAIN if the hardware mailbox is full
+	 * (the frame is sent again later with CONFIG_CANIOT_TXQ), any other value
+	 * on error.
 	 */
 	int (*send)(const struct caniot_frame *frame, uint32_t delay_ms);
 
@@ -213,6 +225,36 @@ struct caniot_drivers_api {
 	 * Return 0 on success, -CANIOT_EAGAIN if no frame is available.
 	 */
 	int (*recv)(struct caniot_frame *frame);
+
+#if CONFIG_CANIOT_DRIVERS_BURST_SIZE
+	/**
+	 * @brief Receive up to "max" CANIOT frames at once (optional, can be NULL)
+	 *
+	 * Note:
+	 * 	- Should not block.
+	 * 	- Should be thread safe (in a multi-threaded environment).
+	 *
+	 * Return the number of frames received, 0 or -CANIOT_EAGAIN if no frame is
+	 * available, any other negative value on error.
+	 */
+	int (*recv_burst)(struct caniot_frame *frames, size_t max);
+
+	/**
+	 * @brief Send "count" CANIOT frames at once (optional, can be NULL)
+	 *
+	 * Frame i is sent with delay delays_ms[i], all frames are sent without
+	 * delay if "delays_ms" is NULL.
+	 *
+	 * Note:
+	 * 	- Should not block.
+	 * 	- Should be thread safe (in a multi-threaded environment).
+	 *
+	 * Return the number of frames sent (in order), negative value on error.
+	 */
+	int (*send_burst)(const struct caniot_frame *frames,
+			  size_t count,
+			  const uint32_t *delays_ms);
+#endif
 };
 
 // Return if deviceid is broadcast
@@ -32,6 +32,17 @@
 #define CONFIG_CANIOT_MAX_PENDING_QUERIES 4U
 #endif
 
+/* Controllers can allocate pending queries from a pool provided at
+ * initialization, handles are then 16-bit */
+#ifndef CONFIG_CANIOT_CTRL_POOL_EXT
+#define CONFIG_CANIOT_CTRL_POOL_EXT 0u
+#endif
+
+/* Query handles embed a generation counter, stale handles are rejected */
+#ifndef CONFIG_CANIOT_CTRL_HANDLE_GEN
+#define CONFIG_CANIOT_CTRL_HANDLE_GEN 0u
+#endif
+
 #ifndef CONFIG_CANIOT_ATTRIBUTE_NAME
 #define CONFIG_CANIOT_ATTRIBUTE_NAME 0u
 #endif
@@ -48,8 +59,210 @@
 #define CONFIG_CANIOT_ASSERT 0
 #endif
 
-#ifndef CONFIG_CANIOT_QUERY_ID
-#define CONFIG_CANIOT_QUERY_ID 0u
+/* Maximum number of frames moved per recv_burst() call of the drivers API,
+ * 0 disables burst support */
+#ifndef CONFIG_CANIOT_DRIVERS_BURST_SIZE
+#define CONFIG_CANIOT_DRIVERS_BURST_SIZE 0u
+#endif
+
+/* Rolling bus load meter, fed by controllers and devices */
+#ifndef CONFIG_CANIOT_BUSLOAD
+#define CONFIG_CANIOT_BUSLOAD 0u
+#endif
+
+#ifndef CONFIG_CANIOT_BUSLOAD_BUCKETS
+#define CONFIG_CANIOT_BUSLOAD_BUCKETS 10u
+#endif
+
+#ifndef CONFIG_CANIOT_BUSLOAD_BUCKET_MS
+#define CONFIG_CANIOT_BUSLOAD_BUCKET_MS 100u
+#endif
+
+/* Transmit queue ordered by CAN identifier and release time, in controllers
+ * and devices */
+#ifndef CONFIG_CANIOT_TXQ
+#define CONFIG_CANIOT_TXQ 0u
+#endif
+
+#ifndef CONFIG_CANIOT_TXQ_SIZE
+#define CONFIG_CANIOT_TXQ_SIZE 8u
+#endif
+
+#if CONFIG_CANIOT_TXQ && (CONFIG_CANIOT_TXQ_SIZE > 255u)
+#error "CONFIG_CANIOT_TXQ_SIZE must not exceed 255"
+#endif
+
+/* Maximum number of queries pending for the same device */
+#ifndef CONFIG_CANIOT_CTRL_PIPELINE_DEPTH
+#define CONFIG_CANIOT_CTRL_PIPELINE_DEPTH 1u
+#endif
+
+#ifndef CONFIG_CANIOT_CTRL_TIMING_WHEEL
+#define CONFIG_CANIOT_CTRL_TIMING_WHEEL 0u
+#endif
+
+#ifndef CONFIG_CANIOT_CTRL_TWHEEL_LEVELS
+#define CONFIG_CANIOT_CTRL_TWHEEL_LEVELS 4u
+#endif
+
+/* Number of entries of the controller submission ring (power of 2),
+ * 0 disables caniot_controller_submit() */
+#ifndef CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+#define CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE 0u
+#endif
+
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE & (CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE - 1)
+#error "CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE must be a power of 2"
+#endif
+#if !CONFIG_CANIOT_CTRL_DRIVERS_API
+#error "CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE requires CONFIG_CANIOT_CTRL_DRIVERS_API"
+#endif
+#endif
+
+/* Controller cache of the last telemetry and attribute values received */
+#ifndef CONFIG_CANIOT_CTRL_CACHE
+#define CONFIG_CANIOT_CTRL_CACHE 0u
+#endif
+
+/* Number of cached attributes (power of 2) */
+#ifndef CONFIG_CANIOT_CTRL_CACHE_ATTRS
+#define CONFIG_CANIOT_CTRL_CACHE_ATTRS 32u
+#endif
+
+#if CONFIG_CANIOT_CTRL_CACHE &&                                                          \
+	(CONFIG_CANIOT_CTRL_CACHE_ATTRS & (CONFIG_CANIOT_CTRL_CACHE_ATTRS - 1))
+#error "CONFIG_CANIOT_CTRL_CACHE_ATTRS must be a power of 2"
+#endif
+
+/* Identical read queries pending on the same device share a single frame */
+#ifndef CONFIG_CANIOT_CTRL_COALESCE
+#define CONFIG_CANIOT_CTRL_COALESCE 0u
+#endif
+
+#if CONFIG_CANIOT_CTRL_COALESCE && !CONFIG_CANIOT_CTRL_DRIVERS_API
+#error "CONFIG_CANIOT_CTRL_COALESCE requires CONFIG_CANIOT_CTRL_DRIVERS_API"
+#endif
+
+/* Broadcast queries complete once the devices expected responded */
+#ifndef CONFIG_CANIOT_CTRL_BCAST_EXPECT
+#define CONFIG_CANIOT_CTRL_BCAST_EXPECT 0u
+#endif
+
+/* Responses to a broadcast query reported at once, with the bitfield of the
+ * devices which responded */
+#ifndef CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+#define CONFIG_CANIOT_CTRL_BCAST_AGGREGATE 0u
+#endif
+
+/* Round-trip time estimation and adaptive timeouts */
+#ifndef CONFIG_CANIOT_CTRL_RTT
+#define CONFIG_CANIOT_CTRL_RTT 0u
+#endif
+
+#ifndef CONFIG_CANIOT_CTRL_RTT_TIMEOUT_INIT_MS
+#define CONFIG_CANIOT_CTRL_RTT_TIMEOUT_INIT_MS 1000u
+#endif
+
+#ifndef CONFIG_CANIOT_CTRL_RTT_TIMEOUT_MIN_MS
+#define CONFIG_CANIOT_CTRL_RTT_TIMEOUT_MIN_MS 20u
+#endif
+
+#ifndef CONFIG_CANIOT_CTRL_RTT_TIMEOUT_MAX_MS
+#define CONFIG_CANIOT_CTRL_RTT_TIMEOUT_MAX_MS 5000u
+#endif
+
+/* Controller counters and round-trip time histograms */
+#ifndef CONFIG_CANIOT_CTRL_METRICS
+#define CONFIG_CANIOT_CTRL_METRICS 0u
+#endif
+
+/* Queries sent again with a backoff when they time out */
+#ifndef CONFIG_CANIOT_CTRL_RETRY
+#define CONFIG_CANIOT_CTRL_RETRY 0u
+#endif
+
+#if CONFIG_CANIOT_CTRL_RETRY && !CONFIG_CANIOT_CTRL_DRIVERS_API
+#error "CONFIG_CANIOT_CTRL_RETRY requires CONFIG_CANIOT_CTRL_DRIVERS_API"
+#endif
+
+/* Pipelined bulk attribute read/write operations */
+#ifndef CONFIG_CANIOT_CTRL_BULK
+#define CONFIG_CANIOT_CTRL_BULK 0u
+#endif
+
+#if CONFIG_CANIOT_CTRL_BULK && !CONFIG_CANIOT_CTRL_DRIVERS_API
+#error "CONFIG_CANIOT_CTRL_BULK requires CONFIG_CANIOT_CTRL_DRIVERS_API"
+#endif
+
+/* Controller-side shadow of device configurations, synchronized with the
+ * attributes which differ only */
+#ifndef CONFIG_CANIOT_CTRL_SHADOW
+#define CONFIG_CANIOT_CTRL_SHADOW 0u
+#endif
+
+#if CONFIG_CANIOT_CTRL_SHADOW && !CONFIG_CANIOT_CTRL_BULK
+#error "CONFIG_CANIOT_CTRL_SHADOW requires CONFIG_CANIOT_CTRL_BULK"
+#endif
+
+/* Registry of the devices seen by the controller */
+#ifndef CONFIG_CANIOT_CTRL_REGISTRY
+#define CONFIG_CANIOT_CTRL_REGISTRY 0u
+#endif
+
+/* Scheduler of periodic queries, under a bus load ceiling */
+#ifndef CONFIG_CANIOT_CTRL_SCHED
+#define CONFIG_CANIOT_CTRL_SCHED 0u
+#endif
+
+#ifndef CONFIG_CANIOT_CTRL_SCHED_MAX_JOBS
+#define CONFIG_CANIOT_CTRL_SCHED_MAX_JOBS 16u
+#endif
+
+/* Default bus bitrate (bit/s) */
+#ifndef CONFIG_CANIOT_CTRL_SCHED_BITRATE
+#define CONFIG_CANIOT_CTRL_SCHED_BITRATE 500000u
+#endif
+
+/* Default percentage of the bus time the controller traffic can use */
+#ifndef CONFIG_CANIOT_CTRL_SCHED_LOAD_PERCENT
+#define CONFIG_CANIOT_CTRL_SCHED_LOAD_PERCENT 30u
+#endif
+
+/* Bus time (ms) the budget can be accumulated for while idle */
+#ifndef CONFIG_CANIOT_CTRL_SCHED_BURST_MS
+#define CONFIG_CANIOT_CTRL_SCHED_BURST_MS 20u
+#endif
+
+#if CONFIG_CANIOT_CTRL_SCHED && !CONFIG_CANIOT_CTRL_DRIVERS_API
+#error "CONFIG_CANIOT_CTRL_SCHED requires CONFIG_CANIOT_CTRL_DRIVERS_API"
+#endif
+
+/* Group of controllers processed by one thread each (POSIX threads only) */
+#ifndef CONFIG_CANIOT_CTRL_GROUP
+#define CONFIG_CANIOT_CTRL_GROUP 0u
+#endif
+
+#ifndef CONFIG_CANIOT_CTRL_GROUP_MAX_BUSES
+#define CONFIG_CANIOT_CTRL_GROUP_MAX_BUSES 4u
+#endif
+
+#if CONFIG_CANIOT_CTRL_GROUP && !CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+#error "CONFIG_CANIOT_CTRL_GROUP requires CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE"
+#endif
+
+/* Queue deferring controller events to worker threads (POSIX threads only) */
+#ifndef CONFIG_CANIOT_CTRL_EVQ
+#define CONFIG_CANIOT_CTRL_EVQ 0u
+#endif
+
+#ifndef CONFIG_CANIOT_CTRL_EVQ_SIZE
+#define CONFIG_CANIOT_CTRL_EVQ_SIZE 32u
+#endif
+
+/* SocketCAN drivers API backend (Linux only) */
+#ifndef CONFIG_CANIOT_SOCKETCAN
+#define CONFIG_CANIOT_SOCKETCAN 0u
 #endif
 
 #define CANIOT_ATTR_NAME_MAX_LEN 48u
@@ -8,6 +8,19 @@
 #define _CANIOT_CONTROLLER_H
 
 #include "caniot.h"
+#include "tqueue.h"
+
+#if CONFIG_CANIOT_CTRL_SHADOW
+#include "device.h"
+#endif
+
+#if CONFIG_CANIOT_BUSLOAD
+#include "busload.h"
+#endif
+
+#if CONFIG_CANIOT_TXQ
+#include "txq.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -15,18 +28,49 @@ extern "C" {
 
 #define CANIOT_TIMEOUT_FOREVER ((uint32_t)-1)
 
-struct caniot_pendq_time_handle {
-	union {
-		uint32_t timeout; /* Timeout if response is not yet received */
-		uint32_t delay;	  /* Delay the query took when response is received */
-	};			  /* in ms */
+/**
+ * @brief Handle of a pending query (0 = invalid)
+ *
+ * 16 bits with CONFIG_CANIOT_CTRL_POOL_EXT, so that pools larger than 255
+ * queries can be provided.
+ *
+ * With CONFIG_CANIOT_CTRL_HANDLE_GEN, bits 0-15 are 1 + the index of the query
+ * in the pool and bits 16-30 the generation of the slot, incremented each time
+ * the slot is allocated: a handle of a completed query never designates a
+ * query allocated afterwards in the same slot (until 32768 allocations).
+ */
+#if CONFIG_CANIOT_CTRL_HANDLE_GEN
+typedef uint32_t caniot_handle_t;
+#elif CONFIG_CANIOT_CTRL_POOL_EXT
+typedef uint16_t caniot_handle_t;
+#else
+typedef uint8_t caniot_handle_t;
+#endif
 
-	/* next query in the time queue
-	 * @see
-	 * https://github.com/lucasdietrich/AVRTOS/blob/master/src/avrtos/dstruct/tqueue.c
-	 */
-	struct caniot_pendq_time_handle *next;
+#if CONFIG_CANIOT_CTRL_RTT
+/* Timeout derived from the round-trip times measured for the device,
+ * see caniot_controller_rtt_timeout() */
+#define CANIOT_TIMEOUT_ADAPTIVE ((uint32_t)-2)
+#endif
+
+#if CONFIG_CANIOT_CTRL_RETRY
+/**
+ * @brief Retry policy of a query, see caniot_controller_query_retry()
+ */
+struct caniot_retry_policy {
+	/* Maximum number of times the frame is sent, including the first one */
+	uint8_t max_attempts;
+
+	/* Multiplier applied to the backoff after each retry (0 or 1: constant) */
+	uint8_t multiplier;
+
+	/* Delay between the timeout of the first attempt and the second one */
+	uint32_t backoff_ms;
+
+	/* Random delay in [0, jitter_ms] added to each backoff */
+	uint32_t jitter_ms;
 };
+#endif
 
 struct caniot_pendq {
 	/**
@@ -38,7 +82,14 @@ struct caniot_pendq {
 	 * @brief Handle identifying the query.
 	 * (0 = invalid)
 	 */
-	uint8_t handle;
+	caniot_handle_t handle;
+
+#if CONFIG_CANIOT_CTRL_HANDLE_GEN
+	/**
+	 * @brief Generation of the slot, kept when the query is freed
+	 */
+	uint16_t gen;
+#endif
 
 	/**
 	 * @brief Query type, in order to identify the response.
@@ -48,13 +99,6 @@ struct caniot_pendq {
 	 */
 	caniot_frame_type_t query_type;
 
-#if CONFIG_CANIOT_QUERY_ID
-	/**
-	 * @brief Query ID, in order to identify the response.
-	 */
-	uint16_t query_id;
-#endif
-
 	union {
 		/**
 		 * @brief Requested endpoint if query_type is
@@ -70,15 +114,96 @@ struct caniot_pendq {
 	};
 
 	union {
+#if CONFIG_CANIOT_CTRL_TIMING_WHEEL
+		struct caniot_twheel_node tie; /* for timeout wheel */
+#else
 		struct caniot_pendq_time_handle tie; /* for timeout queue */
-		struct caniot_pendq *next;	     /* for memory allocation */
+#endif
+		struct caniot_pendq *next; /* for memory allocation */
 	};
 
+	/**
+	 * @brief Next query pending on the same device (index queue)
+	 */
+	struct caniot_pendq *dev_next;
+
+#if CONFIG_CANIOT_CTRL_RETRY
+	struct {
+		/* Query frame, sent again on retry */
+		struct caniot_frame frame;
+		struct caniot_retry_policy policy;
+
+		/* Timeout of each attempt */
+		uint32_t timeout;
+
+		/* Backoff before the next retry */
+		uint32_t backoff_ms;
+
+		/* Number of times the frame has been sent */
+		uint8_t attempts;
+
+		/* Waiting for the backoff to elapse (not for the timeout) */
+		uint8_t backoff : 1u;
+	} retry;
+#endif
+
+#if CONFIG_CANIOT_CTRL_COALESCE
+	/**
+	 * @brief Query the frame was sent for, if the query is coalesced onto it
+	 * (NULL for the query which sent the frame)
+	 */
+	struct caniot_pendq *leader;
+
+	/**
+	 * @brief First query coalesced onto this one if it is the leader, next one
+	 * otherwise
+	 */
+	struct caniot_pendq *coalesced;
+#endif
+
+#if CONFIG_CANIOT_CTRL_BULK
+	/* Bulk operation the query belongs to (NULL if none) and index of the
+	 * queried attribute in it */
+	struct caniot_ctrl_bulk *bulk;
+	uint16_t bulk_index;
+#endif
+
+#if CONFIG_CANIOT_CTRL_RTT || CONFIG_CANIOT_CTRL_METRICS
+	/* Controller time the query was sent at */
+	uint32_t sent_ms;
+
+	/* The response time is a valid round-trip time sample (frame sent once,
+	 * for this query) */
+	uint8_t rtt_sample : 1u;
+#endif
+
+#if CONFIG_CANIOT_TXQ && CONFIG_CANIOT_CTRL_DRIVERS_API
+	/* The driver failed to send the queued frame, the query expires right
+	 * away and is cancelled (unless retried) */
+	uint8_t send_failed : 1u;
+#endif
+
 	/**
 	 * @brief Bitfield of notified devices in case of broadcast query.
 	 */
 	uint64_t notified;
 
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+	/**
+	 * @brief Bitfield of devices expected to respond to a broadcast query,
+	 * the query completes once all of them are notified (0 = until timeout).
+	 */
+	uint64_t expected;
+#endif
+
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+	/**
+	 * @brief Responses to an aggregated broadcast query, indexed by DID
+	 * (NULL if not aggregated)
+	 */
+	struct caniot_frame *aggregate;
+#endif
+
 	/**
 	 * @brief User context
 	 *
@@ -103,6 +228,13 @@ typedef enum {
 	 * "pq" is set.
 	 */
 	CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY,
+
+	/**
+	 * @brief Query completed from the controller cache, no frame was sent.
+	 *
+	 * "handle" is 0, "response" is built from the cached value.
+	 */
+	CANIOT_CONTROLLER_EVENT_CONTEXT_CACHE,
 } caniot_controller_event_context_t;
 
 typedef enum {
@@ -128,7 +260,7 @@ typedef enum {
 	CANIOT_CONTROLLER_EVENT_STATUS_TIMEOUT,
 
 	/**
-	 * @brief A query was cancelled
+	 * @brief A query was cancelled, or its frame could not be sent
 	 *
 	 * "pq" is set, reponse is NULL.
 	 */
@@ -166,7 +298,7 @@ typedef struct {
 	 * @brief Handle to identify the query if context is:
 	 * - CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY
 	 */
-	uint8_t handle;
+	caniot_handle_t handle;
 
 	/**
 	 * @brief Pointer to the response frame if status is:
@@ -174,7 +306,15 @@ typedef struct {
 	 * - CANIOT_CONTROLLER_EVENT_STATUS_ERROR
 	 */
 	const struct caniot_frame *response;
-	
+
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+	/**
+	 * @brief Devices which responded, if the query is a broadcast one and
+	 * the event terminates it
+	 */
+	uint64_t responders;
+#endif
+
 	/**
 	 * @brief User context
 	 *
@@ -231,6 +371,13 @@ struct caniot_discovery_params {
 
 	uint32_t timeout; /* in ms */
 
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+	/* In ACTIVE mode, if not 0, bitfield of the devices expected to respond:
+	 * the discovery stops as soon as all of them responded
+	 * (e.g. caniot_controller_registry_alive()) */
+	uint64_t expected;
+#endif
+
 	caniot_controller_discovery_cb_t user_callback;
 	void *user_data;
 
@@ -240,21 +387,308 @@ struct caniot_discovery_params {
 	} data;
 };
 
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+/**
+ * @brief Callback called by the controller thread once a submitted query has
+ * been passed to caniot_controller_query().
+ *
+ * @param ctrl Controller
+ * @param ret Return value of caniot_controller_query() (handle, 0 or error),
+ * -CANIOT_ECANCELED if the controller was deinitialized before
+ * @param user_data User data of the submission
+ */
+typedef void (*caniot_controller_submit_cb_t)(struct caniot_controller *ctrl,
+					      int ret,
+					      void *user_data);
+
+struct caniot_submit_req {
+	caniot_did_t did;
+	uint32_t timeout;
+	struct caniot_frame frame;
+	caniot_controller_submit_cb_t cb;
+	void *user_data;
+};
+
+/* Bounded multi-producer single-consumer ring
+ * (D. Vyukov's bounded queue, producers only contend on "enqueue_pos") */
+struct caniot_submit_ring {
+	uint32_t enqueue_pos; /* shared by producers */
+	uint32_t dequeue_pos; /* owned by the controller thread */
+
+	struct {
+		uint32_t seq;
+		struct caniot_submit_req req;
+	} cells[CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE];
+};
+#endif
+
+#if CONFIG_CANIOT_CTRL_RTT
+/* Round-trip time estimator of a device (RFC 6298) */
+struct caniot_ctrl_rtt {
+	int32_t srtt;	/* smoothed round-trip time, in ms scaled by 8 */
+	int32_t rttvar; /* round-trip time variation, in ms scaled by 4 */
+	uint8_t valid : 1u;
+};
+#endif
+
+#if CONFIG_CANIOT_CTRL_METRICS
+/* Round-trip time histogram buckets: [0, 1[, [1, 2[, [2, 4[, ... [1024, inf[ ms */
+#define CANIOT_CTRL_RTT_BUCKETS 12u
+
+/**
+ * @brief Controller metrics, only made of uint32_t counters
+ * (see caniot_controller_metrics_snapshot())
+ */
+struct caniot_ctrl_metrics {
+	uint32_t sent;	    /* frames sent by the controller (retries included) */
+	uint32_t ok;	    /* responses to queries */
+	uint32_t error;	    /* error responses to queries */
+	uint32_t timeout;   /* queries timed out */
+	uint32_t cancelled; /* queries cancelled */
+	uint32_t orphan;    /* frames which are not responses to queries */
+	uint32_t pqalloc;   /* queries rejected with -CANIOT_EPQALLOC */
+	uint32_t busy;	    /* queries rejected with -CANIOT_EBUSY */
+
+	/* Round-trip times of the queries to each device */
+	uint32_t rtt_hist[CANIOT_DID_MAX_COUNT][CANIOT_CTRL_RTT_BUCKETS];
+};
+#endif
+
+#if CONFIG_CANIOT_CTRL_CACHE
+struct caniot_ctrl_cache_telemetry {
+	uint32_t time_ms; /* controller time the frame was received at */
+	uint8_t valid : 1u;
+	uint8_t len : 4u;
+	unsigned char buf[8u];
+};
+
+struct caniot_ctrl_cache_attr {
+	uint32_t time_ms;
+	uint32_t val;
+	uint16_t key;
+	caniot_did_t did;
+	uint8_t valid : 1u;
+};
+
+struct caniot_ctrl_cache {
+	struct caniot_ctrl_cache_telemetry telemetry[CANIOT_DID_MAX_COUNT]
+						   [CANIOT_ENDPOINT_BOARD_CONTROL + 1u];
+
+	/* Open addressing hash table indexed by (did, key) */
+	struct caniot_ctrl_cache_attr attrs[CONFIG_CANIOT_CTRL_CACHE_ATTRS];
+};
+#endif
+
+#if CONFIG_CANIOT_CTRL_BULK
+/* Number of consecutive attributes of a section (attribute part 0) */
+#define CANIOT_BULK_KEY_STEP 0x10u
+
+struct caniot_bulk_attr {
+	uint16_t key;
+
+	/* Value to write, or value read */
+	uint32_t val;
+
+	/* 0 on success, -CANIOT_ETIMEOUT, -CANIOT_ECANCELED, error of the query or
+	 * error code of the error frame received otherwise */
+	int status;
+};
+
+struct caniot_ctrl_bulk;
+
+/**
+ * @brief Called once all attributes of a bulk operation are completed
+ *
+ * @param ctrl Controller
+ * @param bulk Bulk operation, "failed" attributes have a non-zero status
+ * @param user_data User data of the bulk operation
+ */
+typedef void (*caniot_controller_bulk_cb_t)(struct caniot_controller *ctrl,
+					    struct caniot_ctrl_bulk *bulk,
+					    void *user_data);
+
+/**
+ * @brief Bulk attribute read/write operation, see caniot_controller_bulk_start()
+ *
+ * Owned by the caller, must live until its callback is called.
+ */
+struct caniot_ctrl_bulk {
+	caniot_did_t did;
+
+	/* Write "val" of each attribute instead of reading it */
+	bool write;
+
+	/* Maximum number of queries pending at the same time */
+	uint8_t window;
+
+	/* Timeout of each query (CANIOT_TIMEOUT_FOREVER excluded) */
+	uint32_t timeout;
+
+	struct caniot_bulk_attr *attrs;
+	uint16_t count;
+
+	caniot_controller_bulk_cb_t cb;
+	void *user_data;
+
+	/* Internal state */
+	uint16_t next;	  /* next attribute to query */
+	uint16_t pending; /* queries pending */
+	uint16_t failed;  /* attributes completed with an error */
+	bool running;
+};
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_REGISTRY
+struct caniot_ctrl_registry_entry {
+	/* Controller time the last frame of the device was received at */
+	uint32_t last_seen_ms;
+
+	/* Endpoint and type of the last frame received */
+	caniot_endpoint_t endpoint : 2u;
+	caniot_frame_type_t type : 2u;
+};
+
+/**
+ * @brief Devices seen by the controller, updated with every frame received
+ */
+struct caniot_ctrl_registry {
+	/* Bitmap of the devices seen (bit "did") */
+	uint64_t present;
+
+	struct caniot_ctrl_registry_entry devices[CANIOT_DID_MAX_COUNT];
+};
+
+/**
+ * @brief Device of the registry, see caniot_controller_registry_get()
+ */
+struct caniot_ctrl_device_info {
+	caniot_did_t did;
+	caniot_device_class_t cls;
+	uint8_t sid;
+
+	/* Time passed since the last frame of the device was received */
+	uint32_t age_ms;
+
+	caniot_endpoint_t endpoint;
+	caniot_frame_type_t type;
+};
+
+/**
+ * @brief Called for each device of the registry, return false to stop
+ */
+typedef bool (*caniot_controller_registry_cb_t)(struct caniot_controller *ctrl,
+						const struct caniot_ctrl_device_info *info,
+						void *user_data);
+#endif
+
+#if CONFIG_CANIOT_CTRL_SCHED
+/**
+ * @brief Periodic query, see caniot_controller_sched_add()
+ */
+struct caniot_ctrl_sched_job {
+	bool active;
+	caniot_did_t did;
+
+	/* 0 is the highest priority */
+	uint8_t priority;
+
+	struct caniot_frame frame;
+	uint32_t period_ms;
+	uint32_t timeout_ms;
+
+	/* Controller time the job is due at */
+	uint32_t due_ms;
+
+	/* Queries sent */
+	uint32_t runs;
+
+	/* Periods skipped, because the query could not be sent or the job was
+	 * more than a period late */
+	uint32_t missed;
+};
+
+/**
+ * @brief Scheduler of periodic queries
+ *
+ * The bus load ceiling is enforced with a budget of bits (token bucket),
+ * credited with "load_percent" of the bus time and debited with the worst-case
+ * size (CANIOT_FRAME_BITS_MAX()) of every frame sent or received by the
+ * controller. A job is only sent if the budget covers its query and response.
+ */
+struct caniot_ctrl_sched {
+	struct caniot_ctrl_sched_job jobs[CONFIG_CANIOT_CTRL_SCHED_MAX_JOBS];
+
+	uint32_t bitrate; /* bit/s */
+	uint8_t load_percent;
+
+	/* Budget in bits, negative when frames received exceeded it */
+	int32_t credits;
+
+	/* Controller time and remainder (in bit * 100000) of the last credit */
+	uint32_t credit_ms;
+	uint32_t credit_rem;
+};
+#endif
+
+#if CONFIG_CANIOT_CTRL_SHADOW
+/**
+ * @brief Controller-side copy of the configuration of a device, see
+ * caniot_controller_shadow_attach()
+ */
+struct caniot_ctrl_shadow {
+	struct caniot_device_config config;
+
+	/* Attributes (CANIOT_ATTR_KEY_ATTR()) of "config" received from the device */
+	uint64_t known;
+
+	/* Writes of the last synchronization */
+	struct caniot_ctrl_bulk bulk;
+	struct caniot_bulk_attr attrs[CANIOT_CONFIG_ATTR_COUNT];
+};
+#endif
+
 struct caniot_controller {
 	struct {
+#if CONFIG_CANIOT_CTRL_POOL_EXT
+		/* Pool of queries to be allocated, "pool_storage" unless provided
+		 * with caniot_controller_init_pool() */
+		struct caniot_pendq *pool;
+		uint16_t pool_size;
+
+		struct caniot_pendq pool_storage[CONFIG_CANIOT_MAX_PENDING_QUERIES];
+#else
 		/* Pool of queries to be allocated */
 		struct caniot_pendq pool[CONFIG_CANIOT_MAX_PENDING_QUERIES];
+#endif
 
 		/* Free list of unallocated blocks */
 		struct caniot_pendq *free_list;
 
+#if CONFIG_CANIOT_CTRL_TIMING_WHEEL
+		/* Timeout wheel */
+		struct caniot_twheel timeout_wheel;
+#else
 		/* Timeout queue */
 		struct caniot_pendq_time_handle *timeout_queue;
+#endif
+
+		/* Queries pending on each device, in the order they were registered,
+		 * whatever their timeout. Last entry is for broadcast queries. */
+		struct caniot_pendq *index[CANIOT_DID_BROADCAST + 1u];
 
 		/* bitfield of pending devices */
 		uint64_t pending_devices_bf;
+
+#if CONFIG_CANIOT_CTRL_COALESCE
+		/* Set while a response is dispatched to coalesced queries */
+		bool fanout;
+#endif
 	} pendingq;
 
+	/* Time in ms, advanced before received frames are handled */
+	uint32_t clock_ms;
+
 	/* Reference when caniot_controller_process() was last called */
 	struct {
 		uint32_t sec;
@@ -265,7 +699,7 @@ struct caniot_controller {
 	struct {
 		struct caniot_discovery_params params;
 		uint8_t pending : 1u;
-		uint8_t handle; /* pq handle for the discovery query */
+		caniot_handle_t handle; /* pq handle for the discovery query */
 	} discovery;
 #endif
 
@@ -281,6 +715,57 @@ struct caniot_controller {
 	 */
 	const struct caniot_drivers_api *driv;
 #endif
+
+#if CONFIG_CANIOT_CTRL_RTT
+	/* Round-trip time estimator of each device */
+	struct caniot_ctrl_rtt rtt[CANIOT_DID_MAX_COUNT];
+#endif
+
+#if CONFIG_CANIOT_CTRL_METRICS
+	struct {
+		/* Sequence number, odd while counters are updated (seqlock) */
+		uint32_t seq;
+		struct caniot_ctrl_metrics data;
+	} metrics;
+#endif
+
+#if CONFIG_CANIOT_CTRL_CACHE
+	/* Last values received, from any response */
+	struct caniot_ctrl_cache cache;
+#endif
+
+#if CONFIG_CANIOT_CTRL_REGISTRY
+	/* Devices seen, kept until forgotten (discoveries included) */
+	struct caniot_ctrl_registry registry;
+#endif
+
+#if CONFIG_CANIOT_CTRL_SCHED
+	/* Periodic queries */
+	struct caniot_ctrl_sched sched;
+#endif
+
+#if CONFIG_CANIOT_BUSLOAD
+	/* Bus load meter fed with the frames received and sent (NULL if none) */
+	struct caniot_busload *busload;
+#endif
+
+#if CONFIG_CANIOT_TXQ && CONFIG_CANIOT_CTRL_DRIVERS_API
+	/* Frames waiting for the driver, flushed by query() and process() */
+	struct caniot_txq txq;
+
+	/* Last flush stopped on a full mailbox */
+	bool txq_blocked;
+#endif
+
+#if CONFIG_CANIOT_CTRL_SHADOW
+	/* Configuration shadow of each device (NULL if none) */
+	struct caniot_ctrl_shadow *shadows[CANIOT_DID_MAX_COUNT];
+#endif
+
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+	/* Queries submitted by other threads */
+	struct caniot_submit_ring submit_ring;
+#endif
 };
 
 typedef struct caniot_controller caniot_controller_t;
@@ -311,9 +796,42 @@ int caniot_controller_driv_init(struct caniot_controller *ctrl,
 				caniot_controller_event_cb_t cb,
 				void *user_data);
 
+#if CONFIG_CANIOT_CTRL_POOL_EXT
+/**
+ * @brief Same as caniot_controller_init(), but pending queries are allocated
+ * from the "pool_size" queries of "pool" (instead of the
+ * CONFIG_CANIOT_MAX_PENDING_QUERIES ones of the controller).
+ *
+ * @param pool Pool of queries, must outlive the controller
+ * @param pool_size Number of queries in the pool (1 to 65535)
+ * @return int 0 on success, -CANIOT_EINVAL if the pool is invalid
+ */
+int caniot_controller_init_pool(struct caniot_controller *ctrl,
+				struct caniot_pendq *pool,
+				size_t pool_size,
+				caniot_controller_event_cb_t cb,
+				void *user_data);
+
+/**
+ * @brief Same as caniot_controller_driv_init(), with a caller-provided pool
+ *
+ * @see caniot_controller_init_pool()
+ */
+int caniot_controller_driv_init_pool(struct caniot_controller *ctrl,
+				     struct caniot_pendq *pool,
+				     size_t pool_size,
+				     const struct caniot_drivers_api *driv,
+				     caniot_controller_event_cb_t cb,
+				     void *user_data);
+#endif
+
 /**
  * @brief Deinitialize a controller
  *
+ * Pending queries are cancelled without event, queries submitted with
+ * caniot_controller_submit() but not performed yet are completed with
+ * -CANIOT_ECANCELED.
+ *
  * @param ctrl
  * @return int
  */
@@ -346,6 +864,11 @@ uint32_t caniot_controller_next_timeout(const struct caniot_controller *ctrl);
  * BROADCAST
  * 	- otherwise a context is allocated and the query will
  * 	  be automatically cancelled after timeout
+ *
+ * Note: Up to CONFIG_CANIOT_CTRL_PIPELINE_DEPTH queries can be pending for the
+ *  same device, -CANIOT_EBUSY is returned beyond. Responses are matched by
+ *  endpoint/attribute key, in the order the queries were registered.
+ *
  * @return int handle on success (> 0), negative value on error, 0 if no context allocated
  */
 int caniot_controller_query_register(struct caniot_controller *ctrl,
@@ -361,7 +884,8 @@ int caniot_controller_query_register(struct caniot_controller *ctrl,
  * @return true	If pending
  * @return false if not pending
  */
-bool caniot_controller_query_pending(struct caniot_controller *ctrl, uint8_t handle);
+bool caniot_controller_query_pending(struct caniot_controller *ctrl,
+				     caniot_handle_t handle);
 
 /**
  * @brief Cancel a pending query given its handle.
@@ -373,9 +897,67 @@ bool caniot_controller_query_pending(struct caniot_controller *ctrl, uint8_t han
  * @return int 0 on success, negative value on error
  */
 int caniot_controller_query_cancel(struct caniot_controller *ctrl,
-				   uint8_t handle,
+				   caniot_handle_t handle,
 				   bool suppress);
 
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+/**
+ * @brief Set the devices expected to respond to a pending broadcast query.
+ *
+ * The query completes with a terminated event (and is released) as soon as
+ * all of them responded, instead of waiting for its timeout. Should be called
+ * before responses are processed, e.g. right after caniot_controller_query().
+ *
+ * @param ctrl Controller
+ * @param handle Handle of a broadcast query
+ * @param expected Bitfield of the expected devices (bit "did"), 0 to wait for
+ * the timeout
+ * @return int 0 on success, -CANIOT_ENOHANDLE if the query is not pending,
+ * -CANIOT_EINVAL if it is not a broadcast query
+ */
+int caniot_controller_query_expect(struct caniot_controller *ctrl,
+				   caniot_handle_t handle,
+				   uint64_t expected);
+#endif
+
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+/**
+ * @brief Aggregate the responses to a pending broadcast query.
+ *
+ * Responses are copied to "results" at the index of the responding device,
+ * instead of calling the event callback for each one. A single event
+ * terminates the query, with the bitfield of the devices which responded in
+ * "responders":
+ * - status OK and "response" NULL if all expected devices responded (see
+ *   caniot_controller_query_expect(), needs CONFIG_CANIOT_CTRL_BCAST_EXPECT),
+ * - status TIMEOUT or CANCELLED otherwise.
+ *
+ * @param ctrl Controller
+ * @param handle Handle of a broadcast query
+ * @param results Array of CANIOT_DID_MAX_COUNT frames, must live until the
+ * query terminates
+ * @return int 0 on success, -CANIOT_ENOHANDLE if the query is not pending,
+ * -CANIOT_EINVAL if it is not a broadcast query
+ */
+int caniot_controller_query_aggregate(struct caniot_controller *ctrl,
+				      caniot_handle_t handle,
+				      struct caniot_frame *results);
+#endif
+
+/**
+ * @brief Get the CAN filter/mask matching all frames a controller can handle
+ * (i.e. responses)
+ */
+static inline uint16_t caniot_controller_get_filter(void)
+{
+	return CANIOT_ID(0U, CANIOT_RESPONSE, 0U, 0U, 0U);
+}
+
+static inline uint16_t caniot_controller_get_mask(void)
+{
+	return CANIOT_ID(0U, 0x1U, 0U, 0U, 0U);
+}
+
 /**
  * @brief Process a single frame received from the CAN bus
  *
@@ -388,6 +970,27 @@ int caniot_controller_rx_frame(struct caniot_controller *ctrl,
 			       uint32_t time_passed_ms,
 			       const struct caniot_frame *frame);
 
+/**
+ * @brief Process a burst of frames received from the CAN bus
+ *
+ * All frames are dispatched to the pending queries first, then the timeout
+ * queue is aged once by "time_passed_ms" and expired queries callbacks are
+ * called. Frames which are not addressed to the controller are skipped.
+ *
+ * Note: Responses in the burst are matched before queries expire, even if the
+ * timeout would have elapsed before their reception.
+ *
+ * @param ctrl Controller
+ * @param time_passed_ms Time passed since last call to caniot_controller_process() in ms
+ * @param frames Array of received frames
+ * @param count Number of frames in the array
+ * @return int Number of frames handled on success, negative value on error
+ */
+int caniot_controller_rx_frames(struct caniot_controller *ctrl,
+				uint32_t time_passed_ms,
+				const struct caniot_frame *frames,
+				size_t count);
+
 /*____________________________________________________________________________*/
 
 /**
@@ -399,7 +1002,7 @@ int caniot_controller_rx_frame(struct caniot_controller *ctrl,
  * @return int
  */
 int caniot_controller_query_user_data_set(struct caniot_controller *ctrl,
-					  uint8_t handle,
+					  caniot_handle_t handle,
 					  void *user_data);
 
 /**
@@ -410,7 +1013,7 @@ int caniot_controller_query_user_data_set(struct caniot_controller *ctrl,
  * @return void* Pointer to the user data
  */
 void *caniot_controller_query_user_data_get(struct caniot_controller *ctrl,
-					    uint8_t handle);
+					    caniot_handle_t handle);
 
 /*____________________________________________________________________________*/
 
@@ -424,13 +1027,70 @@ void *caniot_controller_query_user_data_get(struct caniot_controller *ctrl,
  * @param did ID of the device to query
  * @param frame Frame to send
  * @param timeout Timeout in ms, a value of 0 means no timeout.
+ * CANIOT_TIMEOUT_ADAPTIVE to derive it from the round-trip times measured for
+ * the device (CONFIG_CANIOT_CTRL_RTT).
  * @return int Handle of the query, 0 if not tracked, negative value on error
+ *
+ * With CONFIG_CANIOT_CTRL_COALESCE, a telemetry or read-attribute query
+ * identical to one already pending on the device is not sent, but gets its own
+ * handle and timeout and is completed by the response to the pending one. If
+ * the pending one times out or is cancelled first, the coalesced query keeps
+ * waiting for that response until its own timeout.
  */
 int caniot_controller_query(struct caniot_controller *ctrl,
 			    caniot_did_t did,
 			    struct caniot_frame *frame,
 			    uint32_t timeout);
 
+#if CONFIG_CANIOT_CTRL_RTT
+/**
+ * @brief Get the timeout of a query to the device: SRTT + 4 * RTTVAR, bounded
+ * by CONFIG_CANIOT_CTRL_RTT_TIMEOUT_MIN_MS and CONFIG_CANIOT_CTRL_RTT_TIMEOUT_MAX_MS.
+ *
+ * CONFIG_CANIOT_CTRL_RTT_TIMEOUT_INIT_MS until a round-trip time is measured
+ * (and for broadcast queries).
+ *
+ * Round-trip times are measured with the time passed to the controller between
+ * a query and its response. Queries sent more than once are not measured.
+ */
+uint32_t caniot_controller_rtt_timeout(const struct caniot_controller *ctrl,
+				       caniot_did_t did);
+#endif
+
+#if CONFIG_CANIOT_CTRL_METRICS
+/**
+ * @brief Copy a consistent snapshot of the controller metrics.
+ *
+ * Can be called from any thread, metrics are only updated by the thread
+ * processing the controller, which never waits for readers.
+ */
+void caniot_controller_metrics_snapshot(const struct caniot_controller *ctrl,
+					struct caniot_ctrl_metrics *metrics);
+#endif
+
+#if CONFIG_CANIOT_CTRL_RETRY
+/**
+ * @brief Same as caniot_controller_query(), but the query is sent again if no
+ * response is received within "timeout", according to the retry policy.
+ *
+ * The TIMEOUT event is only reported after the last attempt timed out. A
+ * response received while waiting for the backoff completes the query.
+ *
+ * @param ctrl Controller
+ * @param did ID of the device to query (not broadcast)
+ * @param frame Frame to send
+ * @param timeout Timeout of each attempt in ms (neither 0 nor
+ * CANIOT_TIMEOUT_FOREVER), CANIOT_TIMEOUT_ADAPTIVE is evaluated once
+ * @param policy Retry policy, copied
+ * @return int Handle of the query, negative value on error
+ */
+int caniot_controller_query_retry(struct caniot_controller *ctrl,
+				  caniot_did_t did,
+				  struct caniot_frame *frame,
+				  uint32_t timeout,
+				  const struct caniot_retry_policy *policy);
+#endif
+
 /**
  * @brief Send a query without tracking it.
  *
@@ -456,6 +1116,268 @@ int caniot_controller_send(struct caniot_controller *ctrl,
  */
 int caniot_controller_process(struct caniot_controller *ctrl);
 
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+/**
+ * @brief Submit a query from any thread, lock-free.
+ *
+ * The query is performed by the thread calling caniot_controller_process()
+ * (the only one allowed to use the other functions of the controller), as if
+ * caniot_controller_query() was called, then:
+ * - "cb" (if not NULL) is called with the return value of the query,
+ * - "user_data" is attached to the query and passed in its events.
+ *
+ * @param ctrl Controller
+ * @param did Device ID
+ * @param frame Query frame (copied)
+ * @param timeout Query timeout (see caniot_controller_query())
+ * @param cb Completion callback, called from the controller thread
+ * @param user_data User data
+ * @return int 0 on success, -CANIOT_EAGAIN if the submission ring is full
+ */
+int caniot_controller_submit(struct caniot_controller *ctrl,
+			     caniot_did_t did,
+			     const struct caniot_frame *frame,
+			     uint32_t timeout,
+			     caniot_controller_submit_cb_t cb,
+			     void *user_data);
+#endif
+
+#if CONFIG_CANIOT_CTRL_CACHE
+/**
+ * @brief Get the cached response to a telemetry or read-attribute query.
+ *
+ * @param ctrl Controller
+ * @param did Device ID
+ * @param query Telemetry or read-attribute query frame
+ * @param max_age_ms Maximum age of the cached value
+ * @param response Response frame built from the cached value
+ * @return int 0 on success, -CANIOT_ENOTSUP if the query cannot be cached,
+ * -CANIOT_ENOATTR if no value younger than "max_age_ms" is cached
+ */
+int caniot_controller_cache_lookup(struct caniot_controller *ctrl,
+				   caniot_did_t did,
+				   const struct caniot_frame *query,
+				   uint32_t max_age_ms,
+				   struct caniot_frame *response);
+
+/**
+ * @brief Same as caniot_controller_query(), but if a value younger than
+ * "max_age_ms" is cached for the query, the event callback is called
+ * synchronously (context CANIOT_CONTROLLER_EVENT_CONTEXT_CACHE) and no frame
+ * is sent.
+ *
+ * @param user_data User data of the event, whether the query completes from
+ * the cache (with handle 0, no query is pending) or is sent
+ * @return int 0 if the query completed from the cache, see
+ * caniot_controller_query() otherwise.
+ */
+int caniot_controller_query_cached(struct caniot_controller *ctrl,
+				   caniot_did_t did,
+				   struct caniot_frame *frame,
+				   uint32_t timeout,
+				   uint32_t max_age_ms,
+				   void *user_data);
+
+/**
+ * @brief Drop all cached values of a device (CANIOT_DID_BROADCAST for all)
+ */
+void caniot_controller_cache_invalidate(struct caniot_controller *ctrl, caniot_did_t did);
+#endif
+
+#if CONFIG_CANIOT_CTRL_BULK
+/**
+ * @brief Fill "count" attributes with consecutive keys starting at "first_key"
+ * (e.g. CANIOT_ATTR_KEY_CONFIG_TELEMETRY_PERIOD to read a configuration).
+ */
+static inline void caniot_controller_bulk_keys_range(struct caniot_bulk_attr *attrs,
+						     uint16_t count,
+						     uint16_t first_key)
+{
+	for (uint16_t i = 0u; i < count; i++) {
+		attrs[i].key	= first_key + i * CANIOT_BULK_KEY_STEP;
+		attrs[i].val	= 0u;
+		attrs[i].status = 0;
+	}
+}
+
+/**
+ * @brief Read or write the attributes of a device, with up to "window" queries
+ * pending at the same time.
+ *
+ * A query is sent for the next attribute as soon as one completes, the
+ * callback of the operation is called once all attributes completed, instead
+ * of the event callback of the controller for each query. Attribute values
+ * read are stored in "attrs".
+ *
+ * Note: The window is also bounded by CONFIG_CANIOT_CTRL_PIPELINE_DEPTH and by
+ *  the available pending queries. An attribute whose query cannot be sent while
+ *  no other query of the operation is pending completes with the error.
+ *
+ * Note: The callback can be called before the function returns if no query
+ *  could be sent at all.
+ *
+ * @param ctrl Controller
+ * @param bulk Operation, "did", "write", "window", "timeout", "attrs", "count",
+ * "cb" and "user_data" are set by the caller
+ * @return int 0 on success, -CANIOT_EINVAL if the operation is invalid,
+ * -CANIOT_EBUSY if it is already running
+ */
+int caniot_controller_bulk_start(struct caniot_controller *ctrl,
+				 struct caniot_ctrl_bulk *bulk);
+
+/**
+ * @brief Cancel the pending queries of a bulk operation, attributes not
+ * completed yet get the -CANIOT_ECANCELED status and the callback is called.
+ *
+ * @return int 0 on success, -CANIOT_ENOHANDLE if the operation is not running
+ */
+int caniot_controller_bulk_cancel(struct caniot_controller *ctrl,
+				  struct caniot_ctrl_bulk *bulk);
+#endif
+
+#if CONFIG_CANIOT_CTRL_REGISTRY
+/**
+ * @brief Get the bitmap of the devices a frame was received from within the
+ * last "max_age_ms" (bit "did"), CANIOT_TIMEOUT_FOREVER for all devices seen.
+ */
+uint64_t caniot_controller_registry_alive(const struct caniot_controller *ctrl,
+					  uint32_t max_age_ms);
+
+/**
+ * @brief Get the registry information of a device
+ *
+ * @return int 0 on success, -CANIOT_EDEVICE if the device was never seen (or
+ * forgotten)
+ */
+int caniot_controller_registry_get(const struct caniot_controller *ctrl,
+				   caniot_did_t did,
+				   struct caniot_ctrl_device_info *info);
+
+/**
+ * @brief Call "cb" for each device seen within the last "max_age_ms", in
+ * ascending DID order.
+ *
+ * @return int Number of devices passed to the callback
+ */
+int caniot_controller_registry_iterate(struct caniot_controller *ctrl,
+				       uint32_t max_age_ms,
+				       caniot_controller_registry_cb_t cb,
+				       void *user_data);
+
+/**
+ * @brief Remove a device from the registry (CANIOT_DID_BROADCAST for all)
+ */
+void caniot_controller_registry_forget(struct caniot_controller *ctrl, caniot_did_t did);
+#endif
+
+#if CONFIG_CANIOT_BUSLOAD
+/**
+ * @brief Feed "bl" (NULL to detach it) with the frames received and sent by
+ * the controller, at the time of the controller (time passed to
+ * caniot_controller_rx_frame() or measured by caniot_controller_process()).
+ */
+void caniot_controller_busload_attach(struct caniot_controller *ctrl,
+				      struct caniot_busload *bl);
+#endif
+
+#if CONFIG_CANIOT_CTRL_SCHED
+/**
+ * @brief Set the bus bitrate and the percentage of the bus time the controller
+ * traffic can use.
+ *
+ * Defaults are CONFIG_CANIOT_CTRL_SCHED_BITRATE and
+ * CONFIG_CANIOT_CTRL_SCHED_LOAD_PERCENT.
+ *
+ * @return int 0 on success, -CANIOT_EINVAL if bitrate is 0 or load_percent not
+ * in [1, 100]
+ */
+int caniot_controller_sched_config(struct caniot_controller *ctrl,
+				   uint32_t bitrate,
+				   uint8_t load_percent);
+
+/**
+ * @brief Add a periodic query, sent by caniot_controller_process() every
+ * "period_ms" (as long as the bus load ceiling allows it).
+ *
+ * Jobs are phased over their period as they are added, so that jobs of the same
+ * period are not due at the same time. Among due jobs, the one with the highest
+ * priority is sent first, if the budget does not allow it, lower priority jobs
+ * wait too.
+ *
+ * Responses and timeouts are reported to the event callback as for any query.
+ * If the query cannot be sent (e.g. the previous one is still pending), the
+ * period is skipped.
+ *
+ * @param ctrl Controller
+ * @param did Device to query (not broadcast)
+ * @param frame Query, copied
+ * @param period_ms Period (not 0)
+ * @param timeout_ms Timeout of each query (not 0)
+ * @param priority Priority, 0 is the highest
+ * @return int Job ID on success, -CANIOT_EAGAIN if all jobs are in use,
+ * -CANIOT_EINVAL on invalid argument
+ */
+int caniot_controller_sched_add(struct caniot_controller *ctrl,
+				caniot_did_t did,
+				const struct caniot_frame *frame,
+				uint32_t period_ms,
+				uint32_t timeout_ms,
+				uint8_t priority);
+
+/**
+ * @brief Remove a periodic query (its pending query is not cancelled)
+ */
+int caniot_controller_sched_remove(struct caniot_controller *ctrl, int job);
+
+/**
+ * @brief Get the time in ms until the next job can be sent: it is due and the
+ * budget covers it. CANIOT_TIMEOUT_FOREVER if there is no job.
+ *
+ * Also taken into account by caniot_controller_next_timeout().
+ */
+uint32_t caniot_controller_sched_next_deadline(const struct caniot_controller *ctrl);
+#endif
+
+#if CONFIG_CANIOT_CTRL_SHADOW
+/**
+ * @brief Attach a configuration shadow to a device (NULL to detach it).
+ *
+ * Once attached, the value of each configuration attribute received from the
+ * device (read or write responses) is copied in the shadow. Attributes can be
+ * read with caniot_controller_bulk_start() to populate it.
+ *
+ * @return int 0 on success, -CANIOT_EBUSY if a synchronization of the current
+ * shadow is running
+ */
+int caniot_controller_shadow_attach(struct caniot_controller *ctrl,
+				    caniot_did_t did,
+				    struct caniot_ctrl_shadow *shadow);
+
+/**
+ * @brief Push a configuration to a device, only the attributes which differ
+ * from the shadow (or are not known yet) are written, as a bulk operation.
+ *
+ * The shadow is updated with the responses to the writes.
+ *
+ * @param ctrl Controller
+ * @param did Device, with a shadow attached
+ * @param config Configuration to push
+ * @param window Maximum number of writes pending at the same time
+ * @param timeout Timeout of each write
+ * @param cb Called once all writes completed (see caniot_controller_bulk_start())
+ * @param user_data User data of the callback
+ * @return int Number of attributes written (0 if the device is already in sync,
+ * the callback is not called then), negative value on error
+ */
+int caniot_controller_shadow_sync(struct caniot_controller *ctrl,
+				  caniot_did_t did,
+				  const struct caniot_device_config *config,
+				  uint8_t window,
+				  uint32_t timeout,
+				  caniot_controller_bulk_cb_t cb,
+				  void *user_data);
+#endif
+
 /*____________________________________________________________________________*/
 
 // Discovery
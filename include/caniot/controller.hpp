@@ -0,0 +1,472 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CANIOT_CONTROLLER_HPP_
+#define _CANIOT_CONTROLLER_HPP_
+
+/**
+ * @brief C++20 coroutine front-end of the controller (header-only)
+ *
+ * Queries are awaited from a coroutine instead of being tracked in the event
+ * callback:
+ *
+ *  caniot::task poll(caniot::controller &ctrl, caniot_did_t did)
+ *  {
+ *  	struct caniot_frame req;
+ *  	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+ *
+ *  	const caniot::query_result res = co_await ctrl.query(did, req, 1000u);
+ *  	if (res.ok()) {
+ *  		...
+ *  	}
+ *  }
+ *
+ * The awaiter lives in the coroutine frame, so awaiting a query does not
+ * allocate (only creating the coroutine does). It owns the pending query:
+ * destroying a coroutine suspended on a query cancels it (without event).
+ *
+ * Coroutines are never resumed from the event callback, but once
+ * caniot::controller::process() (or rx_frame()) returned, so that they can
+ * freely issue new queries. The controller must outlive the coroutines
+ * awaiting its queries.
+ */
+
+#if __cplusplus < 202002L
+#error "caniot/controller.hpp requires C++20"
+#endif
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+#include <caniot/caniot.h>
+#include <caniot/controller.h>
+
+#if !CONFIG_CANIOT_CTRL_DRIVERS_API
+#error "caniot/controller.hpp requires CONFIG_CANIOT_CTRL_DRIVERS_API"
+#endif
+
+namespace caniot
+{
+
+class controller;
+
+struct query_result {
+	/* 0 if the query was sent, negative error otherwise (status is then
+	 * irrelevant) */
+	int ret = 0;
+
+	caniot_controller_event_status_t status = CANIOT_CONTROLLER_EVENT_STATUS_CANCELLED;
+
+	caniot_did_t did = 0u;
+
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+	/* Devices which responded, for broadcast queries */
+	uint64_t responders = 0u;
+#endif
+
+	/* Response, valid if status is OK or ERROR */
+	struct caniot_frame response = {};
+
+	bool ok() const noexcept
+	{
+		return ret == 0 && status == CANIOT_CONTROLLER_EVENT_STATUS_OK;
+	}
+};
+
+/**
+ * @brief Awaitable query, returned by caniot::controller::query()
+ *
+ * The query is sent when awaited, and the coroutine is resumed with the event
+ * terminating it: OK, ERROR, TIMEOUT or CANCELLED. Intermediate responses to
+ * broadcast queries are passed to the controller event callback.
+ */
+class query_awaiter
+{
+public:
+	query_awaiter(controller &ctrl,
+		      caniot_did_t did,
+		      const struct caniot_frame &frame,
+		      uint32_t timeout) noexcept
+		: m_ctrl(ctrl), m_did(did), m_frame(frame), m_timeout(timeout)
+	{
+	}
+
+	query_awaiter(const query_awaiter &)		= delete;
+	query_awaiter &operator=(const query_awaiter &) = delete;
+
+	inline ~query_awaiter();
+
+	bool await_ready() const noexcept
+	{
+		return false;
+	}
+
+	inline bool await_suspend(std::coroutine_handle<> waiter) noexcept;
+
+	query_result await_resume() noexcept
+	{
+		return std::move(m_result);
+	}
+
+	/* Handle of the query while it is pending, 0 otherwise */
+	caniot_handle_t handle() const noexcept
+	{
+		return m_state == state::pending ? m_handle : 0u;
+	}
+
+private:
+	friend class controller;
+
+	enum class state : uint8_t {
+		idle,	 /* not awaited yet */
+		pending, /* query pending, in the controller pending list */
+		ready,	 /* query terminated, in the controller ready list */
+		done,	 /* resumed */
+	};
+
+	controller &m_ctrl;
+	caniot_did_t m_did;
+	struct caniot_frame m_frame;
+	uint32_t m_timeout;
+
+	state m_state		 = state::idle;
+	caniot_handle_t m_handle = 0u;
+	std::coroutine_handle<> m_waiter;
+	query_result m_result;
+
+	/* Intrusive link in the controller pending or ready list */
+	query_awaiter *m_next = nullptr;
+};
+
+/**
+ * @brief Controller owning a struct caniot_controller, whose queries can be
+ * awaited.
+ *
+ * The per-query user data of the queries sent by query() are reserved,
+ * events of other queries and of unsolicited frames are passed to the event
+ * callback given to the constructor (if any).
+ */
+class controller
+{
+public:
+	controller(const struct caniot_drivers_api *driv,
+		   caniot_controller_event_cb_t cb = nullptr,
+		   void *user_data		   = nullptr) noexcept
+		: m_cb(cb), m_user_data(user_data)
+	{
+		m_init_ret = caniot_controller_driv_init(&m_ctrl, driv, event_cb, this);
+	}
+
+	controller(const controller &)		  = delete;
+	controller &operator=(const controller &) = delete;
+
+	~controller()
+	{
+		caniot_controller_deinit(&m_ctrl);
+	}
+
+	/* Return value of the controller initialization */
+	int init_ret() const noexcept
+	{
+		return m_init_ret;
+	}
+
+	struct caniot_controller *get() noexcept
+	{
+		return &m_ctrl;
+	}
+
+	/**
+	 * @brief Query to await, the frame is copied and sent when awaited.
+	 *
+	 * @param timeout Timeout in ms (not 0, see caniot_controller_query())
+	 */
+	query_awaiter query(caniot_did_t did,
+			    const struct caniot_frame &frame,
+			    uint32_t timeout) noexcept
+	{
+		return query_awaiter(*this, did, frame, timeout);
+	}
+
+	/**
+	 * @brief Same as caniot_controller_process(), then resume the coroutines
+	 * whose query terminated.
+	 */
+	int process() noexcept
+	{
+		const int ret = caniot_controller_process(&m_ctrl);
+		resume_ready();
+		return ret;
+	}
+
+	/**
+	 * @brief Same as caniot_controller_rx_frame(), then resume the coroutines
+	 * whose query terminated.
+	 */
+	int rx_frame(uint32_t time_passed_ms, const struct caniot_frame *frame) noexcept
+	{
+		const int ret = caniot_controller_rx_frame(&m_ctrl, time_passed_ms, frame);
+		resume_ready();
+		return ret;
+	}
+
+	/**
+	 * @brief Resume the coroutines whose query terminated, in order.
+	 */
+	void resume_ready() noexcept
+	{
+		while (m_ready_head != nullptr) {
+			query_awaiter *const aw = m_ready_head;
+
+			m_ready_head = aw->m_next;
+			if (m_ready_head == nullptr) m_ready_tail = nullptr;
+
+			aw->m_next  = nullptr;
+			aw->m_state = query_awaiter::state::done;
+
+			/* may destroy the awaiter */
+			aw->m_waiter.resume();
+		}
+	}
+
+	/* Number of queries awaited */
+	uint32_t pending_count() const noexcept
+	{
+		return m_pending_count;
+	}
+
+private:
+	friend class query_awaiter;
+
+	static query_awaiter **find(query_awaiter **head, const query_awaiter *aw) noexcept
+	{
+		while (*head != nullptr && *head != aw) {
+			head = &(*head)->m_next;
+		}
+
+		return *head != nullptr ? head : nullptr;
+	}
+
+	void pending_add(query_awaiter *aw) noexcept
+	{
+		aw->m_next     = m_pending_head;
+		m_pending_head = aw;
+		m_pending_count++;
+	}
+
+	bool pending_remove(query_awaiter *aw) noexcept
+	{
+		query_awaiter **const link = find(&m_pending_head, aw);
+		if (link == nullptr) return false;
+
+		*link	   = aw->m_next;
+		aw->m_next = nullptr;
+		m_pending_count--;
+
+		return true;
+	}
+
+	void ready_remove(query_awaiter *aw) noexcept
+	{
+		query_awaiter *prev = nullptr;
+
+		for (query_awaiter *it = m_ready_head; it != nullptr; it = it->m_next) {
+			if (it == aw) {
+				if (prev != nullptr) {
+					prev->m_next = it->m_next;
+				} else {
+					m_ready_head = it->m_next;
+				}
+				if (m_ready_tail == it) m_ready_tail = prev;
+				break;
+			}
+			prev = it;
+		}
+
+		aw->m_next = nullptr;
+	}
+
+	void ready_push(query_awaiter *aw) noexcept
+	{
+		if (m_ready_tail != nullptr) {
+			m_ready_tail->m_next = aw;
+		} else {
+			m_ready_head = aw;
+		}
+		m_ready_tail = aw;
+	}
+
+	static bool event_cb(const caniot_controller_event_t *ev, void *user_data) noexcept
+	{
+		controller *const self = static_cast<controller *>(user_data);
+		query_awaiter *const aw	= static_cast<query_awaiter *>(ev->user_data);
+
+		/* As the user data of the event is the one of the query, make sure
+		 * it really is an awaiter before dereferencing it */
+		if (ev->context != CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY ||
+		    aw == nullptr || find(&self->m_pending_head, aw) == nullptr) {
+			return self->m_cb != nullptr ? self->m_cb(ev, self->m_user_data)
+						     : true;
+		}
+
+		/* Responses to an awaited broadcast query are passed to the event
+		 * callback, but the query goes on whatever it returns: only a
+		 * terminating event resumes the coroutine */
+		if (!ev->terminated) {
+			if (self->m_cb != nullptr) (void)self->m_cb(ev, self->m_user_data);
+			return true;
+		}
+
+		self->pending_remove(aw);
+
+		aw->m_result.status	= ev->status;
+		aw->m_result.did	= ev->did;
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+		aw->m_result.responders = ev->responders;
+#endif
+		if (ev->response != nullptr) {
+			aw->m_result.response = *ev->response;
+		}
+
+		aw->m_state = query_awaiter::state::ready;
+		self->ready_push(aw);
+
+		return true;
+	}
+
+	struct caniot_controller m_ctrl;
+	int m_init_ret;
+
+	caniot_controller_event_cb_t m_cb;
+	void *m_user_data;
+
+	query_awaiter *m_pending_head = nullptr;
+	uint32_t m_pending_count      = 0u;
+
+	query_awaiter *m_ready_head = nullptr;
+	query_awaiter *m_ready_tail = nullptr;
+};
+
+inline bool query_awaiter::await_suspend(std::coroutine_handle<> waiter) noexcept
+{
+	/* An untracked query would never complete */
+	if (m_timeout == 0u) {
+		m_result.ret = -CANIOT_EINVAL;
+		return false;
+	}
+
+	const int ret = caniot_controller_query(m_ctrl.get(), m_did, &m_frame, m_timeout);
+	if (ret <= 0) {
+		m_result.ret = ret < 0 ? ret : -CANIOT_EINVAL;
+		return false;
+	}
+
+	m_handle = static_cast<caniot_handle_t>(ret);
+	caniot_controller_query_user_data_set(m_ctrl.get(), m_handle, this);
+
+	m_waiter = waiter;
+	m_state	 = state::pending;
+	m_ctrl.pending_add(this);
+
+	return true;
+}
+
+inline query_awaiter::~query_awaiter()
+{
+	if (m_state == state::pending) {
+		m_ctrl.pending_remove(this);
+		caniot_controller_query_cancel(m_ctrl.get(), m_handle, true);
+	} else if (m_state == state::ready) {
+		m_ctrl.ready_remove(this);
+	}
+}
+
+/**
+ * @brief Coroutine started immediately, destroyed with the task object
+ * (cancelling the query it is suspended on, if any).
+ */
+class task
+{
+public:
+	struct promise_type {
+		task get_return_object() noexcept
+		{
+			using handle_t = std::coroutine_handle<promise_type>;
+
+			return task(handle_t::from_promise(*this));
+		}
+
+		std::suspend_never initial_suspend() noexcept
+		{
+			return {};
+		}
+
+		/* keep the frame until the task is destroyed, for done() */
+		std::suspend_always final_suspend() noexcept
+		{
+			return {};
+		}
+
+		void return_void() noexcept
+		{
+		}
+
+		void unhandled_exception() noexcept
+		{
+			std::terminate();
+		}
+	};
+
+	task() noexcept = default;
+
+	task(task &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr))
+	{
+	}
+
+	task &operator=(task &&other) noexcept
+	{
+		if (this != &other) {
+			reset();
+			m_handle = std::exchange(other.m_handle, nullptr);
+		}
+		return *this;
+	}
+
+	task(const task &)	      = delete;
+	task &operator=(const task &) = delete;
+
+	~task()
+	{
+		reset();
+	}
+
+	bool done() const noexcept
+	{
+		return !m_handle || m_handle.done();
+	}
+
+	void reset() noexcept
+	{
+		if (m_handle) {
+			m_handle.destroy();
+			m_handle = nullptr;
+		}
+	}
+
+private:
+	explicit task(std::coroutine_handle<promise_type> handle) noexcept
+		: m_handle(handle)
+	{
+	}
+
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+} // namespace caniot
+
+#endif /* _CANIOT_CONTROLLER_HPP_ */
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CANIOT_CTRL_EVQ_H_
+#define _CANIOT_CTRL_EVQ_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <caniot/caniot.h>
+#include <caniot/controller.h>
+
+#if CONFIG_CANIOT_CTRL_EVQ
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief What to do with an event posted while the queue is full
+ */
+typedef enum {
+	/* Drop the oldest event of the queue to make room */
+	CANIOT_CTRL_EVQ_DROP_OLDEST = 0u,
+
+	/* Drop the event posted */
+	CANIOT_CTRL_EVQ_DROP_NEWEST,
+
+	/* Wait for a worker to make room (the controller thread is stalled) */
+	CANIOT_CTRL_EVQ_BLOCK,
+} caniot_ctrl_evq_policy_t;
+
+struct caniot_ctrl_evq_stats {
+	uint32_t posted;	 /* events accepted in the queue */
+	uint32_t dispatched;	 /* events passed to the callback */
+	uint32_t dropped_oldest; /* events dropped to make room (DROP_OLDEST) */
+	uint32_t dropped_newest; /* events dropped when posted (DROP_NEWEST, closed) */
+	uint32_t blocked;	 /* posts which waited for room (BLOCK) */
+	uint32_t high_watermark; /* maximum number of events queued */
+};
+
+struct caniot_ctrl_evq_item {
+	caniot_controller_event_t ev;
+
+	/* Copy of the response frame, "ev.response" points to it when dispatched */
+	struct caniot_frame response;
+};
+
+/**
+ * @brief Bounded queue of controller events, between the thread processing the
+ * controller and worker threads calling the application callback.
+ *
+ * The controller is initialized with caniot_ctrl_evq_post() as event callback
+ * and the queue as user data, events and response frames are copied, so that
+ * a slow callback does not stall frame reception.
+ *
+ * Note: As the callback is deferred, its return value cannot be passed to the
+ *  controller: broadcast queries are kept until their timeout.
+ *
+ * Note: With more than one worker, events are dispatched concurrently and can
+ *  be handled out of order.
+ */
+struct caniot_ctrl_evq {
+	struct caniot_ctrl_evq_item items[CONFIG_CANIOT_CTRL_EVQ_SIZE];
+	uint32_t head; /* oldest event */
+	uint32_t count;
+
+	caniot_ctrl_evq_policy_t policy;
+	bool closed;
+
+	caniot_controller_event_cb_t cb;
+	void *user_data;
+
+	struct caniot_ctrl_evq_stats stats;
+
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+};
+
+int caniot_ctrl_evq_init(struct caniot_ctrl_evq *evq,
+			 caniot_ctrl_evq_policy_t policy,
+			 caniot_controller_event_cb_t cb,
+			 void *user_data);
+
+void caniot_ctrl_evq_deinit(struct caniot_ctrl_evq *evq);
+
+/**
+ * @brief Controller event callback posting the event to the queue "user_data"
+ *
+ * @return true Always (see struct caniot_ctrl_evq)
+ */
+bool caniot_ctrl_evq_post(const caniot_controller_event_t *ev, void *user_data);
+
+/**
+ * @brief Dispatch the oldest event of the queue to the callback
+ *
+ * @param evq Queue
+ * @param wait Wait for an event if the queue is empty (until it is closed)
+ * @return int 1 if an event was dispatched, 0 if the queue is empty (and
+ * closed if "wait")
+ */
+int caniot_ctrl_evq_dispatch(struct caniot_ctrl_evq *evq, bool wait);
+
+/**
+ * @brief Worker thread function, dispatches events until the queue is closed
+ * and empty.
+ *
+ * @param arg Queue
+ */
+void *caniot_ctrl_evq_worker(void *arg);
+
+/**
+ * @brief Close the queue: events posted from now on are dropped, workers
+ * return once the events queued are dispatched.
+ */
+void caniot_ctrl_evq_close(struct caniot_ctrl_evq *evq);
+
+void caniot_ctrl_evq_stats_get(struct caniot_ctrl_evq *evq,
+			       struct caniot_ctrl_evq_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONFIG_CANIOT_CTRL_EVQ */
+
+#endif /* _CANIOT_CTRL_EVQ_H_ */
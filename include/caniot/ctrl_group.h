@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CANIOT_CTRL_GROUP_H_
+#define _CANIOT_CTRL_GROUP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <caniot/caniot.h>
+#include <caniot/controller.h>
+
+#if CONFIG_CANIOT_CTRL_GROUP
+
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct caniot_ctrl_group;
+
+/**
+ * @brief Callback to handle the events of all controllers of a group
+ *
+ * Called from the thread of the bus the event comes from, so calls for
+ * different buses may be concurrent unless "serialize_events" is set.
+ *
+ * @param group Group
+ * @param bus Index of the bus the event comes from
+ * @param ev Event
+ * @param user_data User data (passed when initializing the group)
+ */
+typedef bool (*caniot_ctrl_group_event_cb_t)(struct caniot_ctrl_group *group,
+					     uint8_t bus,
+					     const caniot_controller_event_t *ev,
+					     void *user_data);
+
+struct caniot_ctrl_group_bus {
+	struct caniot_controller ctrl;
+
+	/* I/O thread running the controller of the bus */
+	pthread_t thread;
+
+	/* Wakes the thread up when a query is submitted or the group stops */
+	pthread_mutex_t wake_lock;
+	pthread_cond_t wake;
+	bool kicked;
+
+	struct caniot_ctrl_group *group;
+	uint8_t index;
+};
+
+/**
+ * @brief Group of controllers, one per CAN bus, each one processed by its own
+ * thread.
+ *
+ * Queries are routed to the bus thread through the controller submission ring
+ * (see caniot_controller_submit()), so buses never contend with each other.
+ */
+struct caniot_ctrl_group {
+	struct caniot_ctrl_group_bus buses[CONFIG_CANIOT_CTRL_GROUP_MAX_BUSES];
+	uint8_t count;
+
+	bool running;
+
+	/* Maximum sleep time between two caniot_controller_process() calls of a
+	 * bus thread, 0 to only yield. A thread sleeps less if a query times out
+	 * or a timer expires before, and wakes up when a query is submitted, so
+	 * this only bounds the latency of received frames. */
+	uint32_t poll_period_us;
+
+	/* Serialize event callback calls of all buses (default: false), at the
+	 * cost of making the buses contend with each other on events. */
+	bool serialize_events;
+
+	caniot_ctrl_group_event_cb_t event_cb;
+	void *user_data;
+
+	/* Serializes event callback calls if "serialize_events" is set */
+	pthread_mutex_t event_lock;
+};
+
+int caniot_ctrl_group_init(struct caniot_ctrl_group *group,
+			   caniot_ctrl_group_event_cb_t cb,
+			   void *user_data);
+
+/**
+ * @brief Add a bus to the group, before the group is started.
+ *
+ * @return int Index of the bus on success, negative value on error
+ */
+int caniot_ctrl_group_add_bus(struct caniot_ctrl_group *group,
+			      const struct caniot_drivers_api *driv);
+
+/**
+ * @brief Start one thread per bus
+ */
+int caniot_ctrl_group_start(struct caniot_ctrl_group *group);
+
+/**
+ * @brief Stop and join bus threads, pending queries are cancelled and
+ * submitted queries not performed yet are completed with -CANIOT_ECANCELED.
+ */
+int caniot_ctrl_group_stop(struct caniot_ctrl_group *group);
+
+/**
+ * @brief Submit a query to device "did" of bus "bus", from any thread.
+ *
+ * @see caniot_controller_submit()
+ */
+int caniot_ctrl_group_submit(struct caniot_ctrl_group *group,
+			     uint8_t bus,
+			     caniot_did_t did,
+			     const struct caniot_frame *frame,
+			     uint32_t timeout,
+			     caniot_controller_submit_cb_t cb,
+			     void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONFIG_CANIOT_CTRL_GROUP */
+
+#endif /* _CANIOT_CTRL_GROUP_H_ */
@@ -11,6 +11,14 @@
 
 #include <caniot/caniot.h>
 
+#if CONFIG_CANIOT_BUSLOAD
+#include <caniot/busload.h>
+#endif
+
+#if CONFIG_CANIOT_TXQ
+#include <caniot/txq.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -139,6 +147,16 @@ struct caniot_device {
 	const struct caniot_drivers_api *driv;
 #endif
 
+#if CONFIG_CANIOT_BUSLOAD
+	/* Bus load meter fed with the frames received and sent (NULL if none) */
+	struct caniot_busload *busload;
+#endif
+
+#if CONFIG_CANIOT_TXQ && CONFIG_CANIOT_DEVICE_DRIVERS_API
+	/* Responses waiting for their delay or for the driver mailbox */
+	struct caniot_txq txq;
+#endif
+
 	struct {
 		uint8_t request_telemetry_ep : 4u; /* Bitmask represent what endpoint(s)
 						      to send telemetry for */
@@ -189,6 +207,10 @@ int caniot_device_handle_rx_frame(struct caniot_device *dev,
 
 caniot_did_t caniot_device_get_id(struct caniot_device *dev);
 
+/**
+ * @brief Time until caniot_device_process() should be called again (ms), for
+ * the periodic telemetry and, with CONFIG_CANIOT_TXQ, the queued responses.
+ */
 uint32_t caniot_device_telemetry_remaining(struct caniot_device *dev);
 
 static inline uint16_t caniot_device_get_mask(void)
@@ -268,6 +290,14 @@ bool caniot_device_triggered_telemetry_ep(struct caniot_device *dev,
 
 bool caniot_device_triggered_telemetry_any(struct caniot_device *dev);
 
+#if CONFIG_CANIOT_BUSLOAD
+/**
+ * @brief Feed "bl" (NULL to detach it) with the frames received and sent by
+ * caniot_device_process(), at the time given by the drivers API.
+ */
+void caniot_device_busload_attach(struct caniot_device *dev, struct caniot_busload *bl);
+#endif
+
 /*____________________________________________________________________________*/
 
 /**
@@ -373,6 +403,12 @@ int caniot_device_verify(struct caniot_device *dev);
 #define CANIOT_ATTR_KEY_CONFIG_CLS1_GPIO_MASK_TELEMETRY_ON_CHANGE                        \
 	CANIOT_ATTR_KEY(2, 0x23, 0) // 0x2230
 
+/* Index of the attribute of a key in its section */
+#define CANIOT_ATTR_KEY_ATTR(key) (((key) >> 4) & 0xFF)
+
+/* Number of attributes of the configuration section, all classes included */
+#define CANIOT_CONFIG_ATTR_COUNT 0x24u
+
 enum caniot_device_section {
 	CANIOT_SECTION_DEVICE_IDENTIFICATION = 0,
 	CANIOT_SECTION_DEVICE_SYSTEM	     = 1,
@@ -421,6 +457,52 @@ typedef bool(caniot_device_attribute_handler_t)(struct caniot_device_attribute *
  */
 int caniot_attr_iterate(caniot_device_attribute_handler_t *handler, void *user_data);
 
+/**
+ * @brief Get the value of a configuration attribute in "config", as it would
+ * be read from a device.
+ *
+ * @return int 0 on success, -CANIOT_EKEY* if the key is not a configuration
+ * attribute
+ */
+int caniot_config_attr_get(const struct caniot_device_config *config,
+			   uint16_t key,
+			   uint32_t *val);
+
+/**
+ * @brief Set the value of a configuration attribute in "config", as it would
+ * be written to a device.
+ *
+ * @return int 0 on success, -CANIOT_EKEY* if the key is not a configuration
+ * attribute
+ */
+int caniot_config_attr_set(struct caniot_device_config *config,
+			   uint16_t key,
+			   uint32_t val);
+
+/**
+ * @brief Get the keys of the writable configuration attributes of a device of
+ * class "cls" whose bytes differ between "from" and "to", using the layout of
+ * the attribute table of devices.
+ *
+ * Attributes sharing the same bytes (e.g. telemetry.delay and
+ * telemetry.delay_min) are reported once.
+ *
+ * @param from Current configuration
+ * @param known Bitmap of the attributes (CANIOT_ATTR_KEY_ATTR()) of "from"
+ * whose value is known, unknown attributes are reported as different
+ * @param to Target configuration
+ * @param cls Device class
+ * @param keys Keys of the attributes which differ
+ * @param max Size of "keys", CANIOT_CONFIG_ATTR_COUNT is always enough
+ * @return int Number of keys on success, -CANIOT_EINVAL if "keys" is too small
+ */
+int caniot_config_diff(const struct caniot_device_config *from,
+		       uint64_t known,
+		       const struct caniot_device_config *to,
+		       uint8_t cls,
+		       uint16_t *keys,
+		       size_t max);
+
 /*____________________________________________________________________________*/
 
 #define CANIOT_CONFIG_DEFAULT_INIT()                                                      \
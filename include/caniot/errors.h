@@ -73,9 +73,11 @@ typedef enum {
 
 	CANIOT_ENOTSUP, /*  NOT SUPPORTED */
 	CANIOT_ENIMPL,	/*  NOT IMPLEMENTED */
+
+	CANIOT_ECANCELED, /*  CANCELLED (controller side) */
 } caniot_error_t;
 
-/* STATIC_ASSERT(CANIOT_ENIMPL < 0x80) */
+/* STATIC_ASSERT(CANIOT_ECANCELED < 0x80) */
 
 #define CANIOT_EBUSY CANIOT_EAGAIN
 
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CANIOT_SOCKETCAN_H_
+#define _CANIOT_SOCKETCAN_H_
+
+#include <stdint.h>
+
+#include <caniot/caniot.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_CANIOT_SOCKETCAN
+
+/* Maximum number of frames moved per recvmmsg()/sendmmsg() call */
+#define CANIOT_SOCKETCAN_BURST_MAX 64u
+
+/* Maximum number of frames waiting for their send delay to elapse */
+#define CANIOT_SOCKETCAN_DELAYED_MAX 8u
+
+/**
+ * @brief SocketCAN (Linux CAN_RAW) backend of the drivers API.
+ *
+ * The socket is non-blocking: recv() returns -CANIOT_EAGAIN when no frame is
+ * available. Frames sent with a delay are kept in the context and sent by the
+ * first call to send/recv functions after the delay elapsed.
+ *
+ * As the drivers API callbacks have no context argument, a drivers API bound to
+ * a context is defined with CANIOT_SOCKETCAN_DEFINE().
+ */
+struct caniot_socketcan {
+	int fd;
+
+	uint8_t delayed_count;
+	struct {
+		struct caniot_frame frame;
+		uint64_t deadline_ms; /* CLOCK_MONOTONIC */
+	} delayed[CANIOT_SOCKETCAN_DELAYED_MAX];
+
+	/* Delayed frames dropped because their send failed (but for a full queue) */
+	uint32_t delayed_dropped;
+};
+
+/**
+ * @brief Open a non-blocking CAN_RAW socket bound to the interface "ifname"
+ *
+ * No frame is received until a filter is installed with
+ * caniot_socketcan_filter_device() or caniot_socketcan_filter_controller().
+ *
+ * @return int 0 on success, -CANIOT_EDRIVER on error
+ */
+int caniot_socketcan_open(struct caniot_socketcan *sc, const char *ifname);
+
+void caniot_socketcan_close(struct caniot_socketcan *sc);
+
+/**
+ * @brief Only receive queries addressed to device "did" (or broadcast ones).
+ */
+int caniot_socketcan_filter_device(struct caniot_socketcan *sc, caniot_did_t did);
+
+/**
+ * @brief Only receive responses (controller side).
+ */
+int caniot_socketcan_filter_controller(struct caniot_socketcan *sc);
+
+int caniot_socketcan_send(struct caniot_socketcan *sc,
+			  const struct caniot_frame *frame,
+			  uint32_t delay_ms);
+
+int caniot_socketcan_recv(struct caniot_socketcan *sc, struct caniot_frame *frame);
+
+/**
+ * @brief Receive up to "max" frames with a single recvmmsg() call
+ *
+ * @return int Number of frames received, -CANIOT_EAGAIN if none
+ */
+int caniot_socketcan_recv_burst(struct caniot_socketcan *sc,
+				struct caniot_frame *frames,
+				size_t max);
+
+/**
+ * @brief Send "count" frames in order, consecutive frames without delay are
+ * sent with a single sendmmsg() call.
+ *
+ * @return int Number of leading frames sent or delayed (the following ones are
+ * not), negative value if none was (e.g. -CANIOT_EAGAIN if the TX queue is full)
+ */
+int caniot_socketcan_send_burst(struct caniot_socketcan *sc,
+				const struct caniot_frame *frames,
+				size_t count,
+				const uint32_t *delays_ms);
+
+/* Context free drivers API functions */
+void caniot_socketcan_entropy(uint8_t *buf, size_t len);
+void caniot_socketcan_get_time(uint32_t *sec, uint16_t *ms);
+
+#if CONFIG_CANIOT_DRIVERS_BURST_SIZE
+#define Z_CANIOT_SOCKETCAN_BURST_API(_name)                                              \
+	static int _name##_recv_burst(struct caniot_frame *frames, size_t max)           \
+	{                                                                                \
+		return caniot_socketcan_recv_burst(&_name, frames, max);                 \
+	}                                                                                \
+	static int _name##_send_burst(                                                   \
+		const struct caniot_frame *frames, size_t count, const uint32_t *delays) \
+	{                                                                                \
+		return caniot_socketcan_send_burst(&_name, frames, count, delays);       \
+	}
+#define Z_CANIOT_SOCKETCAN_BURST_INIT(_name)                                             \
+	.recv_burst = _name##_recv_burst, .send_burst = _name##_send_burst,
+#else
+#define Z_CANIOT_SOCKETCAN_BURST_API(_name)
+#define Z_CANIOT_SOCKETCAN_BURST_INIT(_name)
+#endif
+
+/**
+ * @brief Define a SocketCAN context "_name" and the drivers API "_name##_driv"
+ * using it.
+ */
+#define CANIOT_SOCKETCAN_DEFINE(_name)                                                   \
+	static struct caniot_socketcan _name = {.fd = -1};                               \
+	static int _name##_send(const struct caniot_frame *frame, uint32_t delay_ms)     \
+	{                                                                                \
+		return caniot_socketcan_send(&_name, frame, delay_ms);                   \
+	}                                                                                \
+	static int _name##_recv(struct caniot_frame *frame)                              \
+	{                                                                                \
+		return caniot_socketcan_recv(&_name, frame);                             \
+	}                                                                                \
+	Z_CANIOT_SOCKETCAN_BURST_API(_name)                                              \
+	static const struct caniot_drivers_api _name##_driv = {                          \
+		.entropy  = caniot_socketcan_entropy,                                    \
+		.get_time = caniot_socketcan_get_time,                                   \
+		.set_time = NULL,                                                        \
+		.send	  = _name##_send,                                                \
+		.recv	  = _name##_recv,                                                \
+		Z_CANIOT_SOCKETCAN_BURST_INIT(_name)}
+
+#endif /* CONFIG_CANIOT_SOCKETCAN */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CANIOT_SOCKETCAN_H_ */
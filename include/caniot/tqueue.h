@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CANIOT_TQUEUE_H_
+#define _CANIOT_TQUEUE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <caniot/caniot_config.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*____________________________________________________________________________*/
+
+/* Delta list
+ *
+ * Items are sorted by timeout, each item only holds the delay relative to the
+ * previous one. Insertion, removal and ageing are O(n).
+ */
+
+struct caniot_pendq_time_handle {
+	union {
+		uint32_t timeout; /* Timeout if response is not yet received */
+		uint32_t delay;	  /* Delay the query took when response is received */
+	};			  /* in ms */
+
+	/* next query in the time queue
+	 * @see
+	 * https://github.com/lucasdietrich/AVRTOS/blob/master/src/avrtos/dstruct/tqueue.c
+	 */
+	struct caniot_pendq_time_handle *next;
+};
+
+void caniot_tqueue_queue(struct caniot_pendq_time_handle **root,
+			 struct caniot_pendq_time_handle *item);
+
+void caniot_tqueue_shift(struct caniot_pendq_time_handle **root, uint32_t time_passed_ms);
+
+struct caniot_pendq_time_handle *
+caniot_tqueue_pop_expired(struct caniot_pendq_time_handle **root);
+
+struct caniot_pendq_time_handle *caniot_tqueue_pop(struct caniot_pendq_time_handle **root);
+
+/**
+ * @brief Remove an item from the queue, return true if it was found.
+ */
+bool caniot_tqueue_remove(struct caniot_pendq_time_handle **root,
+			  struct caniot_pendq_time_handle *item);
+
+/*____________________________________________________________________________*/
+
+/* Hierarchical timing wheel
+ *
+ * Each level has 64 slots, a slot of level L covers 64^L ms. Items are hashed
+ * in the slot matching their absolute expiry time and cascaded to the lower
+ * level when the wheel reaches their slot. Insertion and removal are O(1),
+ * ageing is amortised O(1) per expired item (empty slots are skipped using the
+ * occupancy bitmaps).
+ *
+ * Expiry times beyond the range of the last level are parked in its farthest
+ * slot and re-hashed when it is reached.
+ *
+ * Items expiring at the same ms are popped in no particular order.
+ */
+
+#define CANIOT_TWHEEL_SLOT_BITS 6u
+#define CANIOT_TWHEEL_SLOTS	(1u << CANIOT_TWHEEL_SLOT_BITS)
+#define CANIOT_TWHEEL_SLOT_MASK (CANIOT_TWHEEL_SLOTS - 1u)
+#define CANIOT_TWHEEL_LEVELS	CONFIG_CANIOT_CTRL_TWHEEL_LEVELS
+
+struct caniot_twheel_node {
+	struct caniot_twheel_node *next;
+
+	/* Address of the pointer referencing this node,
+	 * NULL if the node is not queued */
+	struct caniot_twheel_node **pprev;
+
+	/* Absolute expiry time, in ms */
+	uint32_t expires;
+};
+
+struct caniot_twheel {
+	/* Current time of the wheel, in ms */
+	uint32_t now;
+
+	/* Occupied slots of each level */
+	uint64_t occupied[CANIOT_TWHEEL_LEVELS];
+
+	struct caniot_twheel_node *slots[CANIOT_TWHEEL_LEVELS][CANIOT_TWHEEL_SLOTS];
+
+	/* Expired items, ordered by expiry time */
+	struct caniot_twheel_node *expired;
+	struct caniot_twheel_node **expired_tail;
+};
+
+void caniot_twheel_init(struct caniot_twheel *wheel);
+
+/**
+ * @brief Queue a node to expire in "timeout" ms.
+ *
+ * A timeout of 0 makes the node immediately available through
+ * caniot_twheel_pop_expired().
+ */
+void caniot_twheel_add(struct caniot_twheel *wheel,
+		       struct caniot_twheel_node *node,
+		       uint32_t timeout);
+
+/**
+ * @brief Remove a node from the wheel (O(1)), return true if it was queued.
+ */
+bool caniot_twheel_remove(struct caniot_twheel *wheel, struct caniot_twheel_node *node);
+
+/**
+ * @brief Move the wheel forward, nodes which expire are moved to the expired list.
+ */
+void caniot_twheel_advance(struct caniot_twheel *wheel, uint32_t time_passed_ms);
+
+struct caniot_twheel_node *caniot_twheel_pop_expired(struct caniot_twheel *wheel);
+
+/**
+ * @brief Pop any queued node (expired or not), NULL if the wheel is empty.
+ */
+struct caniot_twheel_node *caniot_twheel_pop(struct caniot_twheel *wheel);
+
+/**
+ * @brief Get time in ms to the next expiry, (uint32_t)-1 if the wheel is empty.
+ */
+uint32_t caniot_twheel_next_timeout(const struct caniot_twheel *wheel);
+
+static inline bool caniot_twheel_node_queued(const struct caniot_twheel_node *node)
+{
+	return node->pprev != NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CANIOT_TQUEUE_H_ */
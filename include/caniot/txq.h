@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _CANIOT_TXQ_H_
+#define _CANIOT_TXQ_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <caniot/caniot.h>
+#include <caniot/caniot_config.h>
+
+#if CONFIG_CANIOT_TXQ
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Transmit queue ordered as the bus would arbitrate
+ *
+ * Frames are released at their release time (time queued + delay). Among
+ * the released frames, the one with the lowest CAN identifier leaves first,
+ * frames with the same identifier leave in the order they were queued.
+ *
+ * The owner (controller or device) flushes the queue to the driver until it
+ * is empty or the driver returns -CANIOT_EAGAIN (hardware mailbox full), so
+ * that a command is not stuck behind bulk attribute reads of the same node.
+ *
+ * Selection is O(n) on CONFIG_CANIOT_TXQ_SIZE frames. Not thread-safe.
+ */
+
+struct caniot_txq_item {
+	struct caniot_frame frame;
+	uint32_t release_ms; /* time the frame can be sent at */
+	uint16_t can_id;     /* arbitration priority, lower first */
+	uint16_t seq;	     /* order of insertion among same identifiers */
+	uint32_t owner;	     /* owner defined tag (e.g. query handle), 0 if none */
+};
+
+struct caniot_txq_stats {
+	uint32_t queued;	 /* frames queued */
+	uint32_t sent;		 /* frames passed to the driver */
+	uint32_t dropped;	 /* frames the driver failed to send (but EAGAIN) */
+	uint32_t full;		 /* frames rejected because the queue was full */
+	uint32_t mailbox_full;	 /* flushes stopped by -CANIOT_EAGAIN */
+	uint32_t high_watermark; /* maximum number of frames queued */
+};
+
+struct caniot_txq {
+	struct caniot_txq_item items[CONFIG_CANIOT_TXQ_SIZE];
+	uint8_t count;
+	uint16_t seq;
+
+	struct caniot_txq_stats stats;
+};
+
+void caniot_txq_init(struct caniot_txq *txq);
+
+/**
+ * @brief Queue a copy of "frame", to be sent "delay_ms" after "now_ms"
+ *
+ * @param owner Tag of the item, 0 if none
+ * @return int 0 on success, -CANIOT_EAGAIN if the queue is full
+ */
+int caniot_txq_push(struct caniot_txq *txq,
+		    const struct caniot_frame *frame,
+		    uint32_t now_ms,
+		    uint32_t delay_ms,
+		    uint32_t owner);
+
+/**
+ * @brief Frame to send next at "now_ms", without removing it
+ *
+ * @return struct caniot_txq_item* NULL if no frame is released
+ */
+struct caniot_txq_item *caniot_txq_peek(struct caniot_txq *txq, uint32_t now_ms);
+
+/**
+ * @brief Remove an item returned by caniot_txq_peek()
+ */
+void caniot_txq_remove(struct caniot_txq *txq, struct caniot_txq_item *item);
+
+/**
+ * @brief Clear the tag of the items of "owner", e.g. once it is released
+ */
+void caniot_txq_disown(struct caniot_txq *txq, uint32_t owner);
+
+/**
+ * @brief Time until the next frame is released, in ms
+ *
+ * @return uint32_t 0 if a frame is already released, UINT32_MAX (i.e.
+ * CANIOT_TIMEOUT_FOREVER) if the queue is empty
+ */
+uint32_t caniot_txq_next_release(const struct caniot_txq *txq, uint32_t now_ms);
+
+static inline uint8_t caniot_txq_count(const struct caniot_txq *txq)
+{
+	return txq->count;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CONFIG_CANIOT_TXQ */
+
+#endif /* _CANIOT_TXQ_H_ */
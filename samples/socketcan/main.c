@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* A device and a controller exchanging telemetry over SocketCAN.
+ *
+ * Runs without hardware on a virtual CAN interface:
+ *
+ *   sudo modprobe vcan
+ *   sudo ip link add dev vcan0 type vcan
+ *   sudo ip link set up vcan0
+ *   ./build/samples/socketcan/sample_socketcan vcan0
+ *
+ * Frames can be observed with "candump vcan0".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <caniot/caniot.h>
+#include <caniot/caniot_private.h>
+#include <caniot/controller.h>
+#include <caniot/device.h>
+#include <caniot/socketcan.h>
+
+#define DID	CANIOT_DID(CANIOT_DEVICE_CLASS1, CANIOT_DEVICE_SID3)
+#define QUERIES 5u
+
+CANIOT_SOCKETCAN_DEFINE(dev_can);
+CANIOT_SOCKETCAN_DEFINE(ctrl_can);
+
+static struct caniot_device_id id = {.did = DID, .version = 0u, .name = "socketcan"};
+static struct caniot_device_config cfg = CANIOT_CONFIG_DEFAULT_INIT();
+static struct caniot_device dev;
+
+static uint32_t responses;
+
+void __assert(bool statement)
+{
+	if (statement == false) {
+		printf("Assertion failed\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static int telemetry_handler(struct caniot_device *dev,
+			     caniot_endpoint_t ep,
+			     unsigned char *buf,
+			     uint8_t *len)
+{
+	(void)dev;
+
+	buf[0] = ep;
+	buf[1] = responses;
+	*len   = 2u;
+
+	return 0;
+}
+
+static const struct caniot_device_api api =
+	CANIOT_DEVICE_API_FULL_INIT(NULL, telemetry_handler, NULL, NULL, NULL, NULL);
+
+static bool ctrl_event_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	(void)user_data;
+
+	printf("[CTRL EV] did=%u handle=%u ctx=%s status=%s",
+	       ev->did,
+	       ev->handle,
+	       caniot_controller_event_context_to_str(ev->context),
+	       caniot_controller_event_status_to_str(ev->status));
+
+	if (ev->response != NULL) {
+		printf(" len=%u", ev->response->len);
+#if CONFIG_CANIOT_FRAME_TIMESTAMP
+		printf(" ts=%u.%03u",
+		       ev->response->timestamp.sec,
+		       ev->response->timestamp.frac);
+#endif
+		responses++;
+	}
+	printf("\n");
+
+	return true;
+}
+
+/* Answer queries received by the device socket */
+static void device_process(void)
+{
+	struct caniot_frame req, resp;
+
+	while (dev_can_driv.recv(&req) == 0) {
+		caniot_clear_frame(&resp);
+		if (caniot_device_handle_rx_frame(&dev, &req, &resp) == 0) {
+			dev_can_driv.send(&resp, 0u);
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const char *ifname = (argc > 1) ? argv[1] : "vcan0";
+	struct caniot_controller ctrl;
+	struct caniot_frame query;
+
+	if ((caniot_socketcan_open(&dev_can, ifname) < 0) ||
+	    (caniot_socketcan_open(&ctrl_can, ifname) < 0)) {
+		printf("Failed to open %s\n", ifname);
+		return 1;
+	}
+
+	caniot_socketcan_filter_device(&dev_can, DID);
+	caniot_socketcan_filter_controller(&ctrl_can);
+
+	dev.identification = &id;
+	dev.config	   = &cfg;
+	dev.api		   = &api;
+
+	caniot_controller_driv_init(&ctrl, &ctrl_can_driv, ctrl_event_cb, NULL);
+
+	for (uint32_t i = 0u; i < QUERIES; i++) {
+		caniot_build_query_telemetry(&query, CANIOT_ENDPOINT_APP);
+		caniot_controller_query(&ctrl, DID, &query, 500u);
+
+		for (uint32_t ms = 0u; ms < 200u; ms++) {
+			device_process();
+			caniot_controller_process(&ctrl);
+			usleep(1000u);
+		}
+	}
+
+	caniot_socketcan_close(&dev_can);
+	caniot_socketcan_close(&ctrl_can);
+
+	printf("%u/%u responses received\n", responses, QUERIES);
+
+	return (responses == QUERIES) ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <caniot/busload.h>
+#include <caniot/caniot_private.h>
+
+#include <string.h>
+
+/* SOF, identifier, RTR, IDE, r0 and DLC */
+#define HEADER_BITS 19u
+
+/* CRC delimiter, ACK slot and delimiter, EOF and interframe space */
+#define TRAILER_BITS 13u
+
+/* CRC-15 (polynomial 0x4599) of a nibble "x" in the 4 upper bits of the
+ * register */
+static const uint16_t crc15_nibble[16u] = {
+	0x0000, 0x4599, 0x4EAB, 0x0B32, 0x58CF, 0x1D56, 0x1664, 0x53FD,
+	0x7407, 0x319E, 0x3AAC, 0x7F35, 0x2CC8, 0x6951, 0x6263, 0x27FA,
+};
+
+static uint16_t crc15_nib(uint16_t crc, uint8_t nibble)
+{
+	return ((crc << 4u) & 0x7FFFu) ^ crc15_nibble[((crc >> 11u) ^ nibble) & 0xFu];
+}
+
+/* Bits subject to stuffing, MSB first: bit "pos" is bit 63 - (pos % 64) of word
+ * pos / 64 */
+struct stream {
+	uint64_t w[2u];
+	uint32_t len;
+};
+
+static void stream_put(struct stream *s, uint32_t val, uint8_t nbits)
+{
+	const uint32_t pos = s->len;
+
+	if (pos >= 64u) {
+		s->w[1u] |= (uint64_t)val << (128u - pos - nbits);
+	} else if (pos + nbits <= 64u) {
+		s->w[0u] |= (uint64_t)val << (64u - pos - nbits);
+	} else {
+		const uint8_t over = (uint8_t)(pos + nbits - 64u);
+
+		s->w[0u] |= (uint64_t)val >> over;
+		s->w[1u] |= (uint64_t)val << (64u - over);
+	}
+
+	s->len += nbits;
+}
+
+/* 64 bits of the stream starting at "pos" */
+static uint64_t stream_window(const struct stream *s, uint32_t pos)
+{
+	if (pos == 0u) {
+		return s->w[0u];
+	} else if (pos < 64u) {
+		return (s->w[0u] << pos) | (s->w[1u] >> (64u - pos));
+	} else {
+		return s->w[1u] << (pos - 64u);
+	}
+}
+
+/* Count stuff bits a run of bits of the same level at a time.
+ *
+ * A stuff bit is inserted after 5 consecutive bits of the same level (stuff
+ * bits included), its level is the opposite one. */
+static uint32_t stream_stuff_bits(const struct stream *s)
+{
+	uint32_t stuff = 0u;
+	uint32_t pos   = 0u;
+	uint8_t level  = 2u; /* level of the last bit, none yet */
+	uint8_t count  = 0u; /* consecutive bits of this level */
+
+	while (pos < s->len) {
+		const uint64_t win = stream_window(s, pos);
+		const uint8_t bit  = (uint8_t)(win >> 63u);
+		const uint64_t x   = bit ? ~win : win;
+		const uint32_t len = x ? (uint32_t)__builtin_clzll(x) : 64u;
+		const uint32_t run = MIN(len, s->len - pos);
+
+		if (bit != level) count = 0u;
+
+		if (count + run >= 5u) {
+			const uint32_t after = run - (5u - count);
+
+			stuff += 1u + after / 5u;
+
+			if (after % 5u == 0u) {
+				/* ends with a stuff bit */
+				level = !bit;
+				count = 1u;
+			} else {
+				level = bit;
+				count = (uint8_t)(after % 5u);
+			}
+		} else {
+			level = bit;
+			count = (uint8_t)(count + run);
+		}
+
+		pos += run;
+	}
+
+	return stuff;
+}
+
+uint32_t caniot_can_frame_bits(uint16_t std_id, const uint8_t *data, uint8_t len)
+{
+	struct stream s = {.w = {0u, 0u}, .len = 0u};
+	uint16_t crc	= 0u;
+
+	len = MIN(len, 8u);
+
+	/* SOF, identifier, RTR, IDE and r0 are dominant (0) but the identifier */
+	const uint32_t header = ((uint32_t)(std_id & 0x7FFu) << 7u) | len;
+
+	stream_put(&s, header, HEADER_BITS);
+
+	/* leading zero bits leave the CRC null, so the header is fed as 5 nibbles */
+	for (int8_t shift = 16; shift >= 0; shift -= 4) {
+		crc = crc15_nib(crc, (header >> shift) & 0xFu);
+	}
+
+	for (uint8_t i = 0u; i < len; i++) {
+		stream_put(&s, data[i], 8u);
+		crc = crc15_nib(crc, data[i] >> 4u);
+		crc = crc15_nib(crc, data[i] & 0xFu);
+	}
+
+	stream_put(&s, crc, 15u);
+
+	return s.len + stream_stuff_bits(&s) + TRAILER_BITS;
+}
+
+uint32_t caniot_frame_bits(const struct caniot_frame *frame)
+{
+	ASSERT(frame != NULL);
+
+	return caniot_can_frame_bits(
+		caniot_id_to_canid(frame->id), (const uint8_t *)frame->buf, frame->len);
+}
+
+uint64_t caniot_frames_bits(const struct caniot_frame *frames,
+			    size_t count,
+			    uint32_t *bits)
+{
+	ASSERT(frames != NULL);
+
+	uint64_t total = 0u;
+
+	for (size_t i = 0u; i < count; i++) {
+		const struct caniot_frame *const f = &frames[i];
+
+		/* no per-frame argument check, unlike caniot_frame_bits() */
+		const uint32_t b = caniot_can_frame_bits(
+			caniot_id_to_canid(f->id), (const uint8_t *)f->buf, f->len);
+
+		if (bits != NULL) bits[i] = b;
+		total += b;
+	}
+
+	return total;
+}
+
+#if CONFIG_CANIOT_BUSLOAD
+
+#define BUCKET_MS CONFIG_CANIOT_BUSLOAD_BUCKET_MS
+#define BUCKETS	  CONFIG_CANIOT_BUSLOAD_BUCKETS
+
+void caniot_busload_init(struct caniot_busload *bl, uint32_t bitrate, uint32_t now_ms)
+{
+	ASSERT(bl != NULL);
+
+	memset(bl, 0x00u, sizeof(*bl));
+
+	bl->bitrate  = bitrate;
+	bl->head_ms  = now_ms;
+	bl->start_ms = now_ms;
+}
+
+/* Move to the bucket "now_ms" belongs to, clearing the ones skipped */
+static void busload_advance(struct caniot_busload *bl, uint32_t now_ms)
+{
+	const uint32_t elapsed = now_ms - bl->head_ms;
+
+	if (elapsed < BUCKET_MS) return;
+
+	const uint32_t n = elapsed / BUCKET_MS;
+
+	if (n >= BUCKETS) {
+		memset(bl->buckets, 0x00u, sizeof(bl->buckets));
+	} else {
+		for (uint32_t i = 0u; i < n; i++) {
+			bl->head	      = (uint8_t)((bl->head + 1u) % BUCKETS);
+			bl->buckets[bl->head] = 0u;
+		}
+	}
+
+	bl->head_ms += n * BUCKET_MS;
+}
+
+void caniot_busload_add(struct caniot_busload *bl, uint32_t now_ms, uint32_t bits)
+{
+	ASSERT(bl != NULL);
+
+	busload_advance(bl, now_ms);
+
+	bl->buckets[bl->head] += bits;
+	bl->bits += bits;
+	bl->frames++;
+}
+
+void caniot_busload_add_frame(struct caniot_busload *bl,
+			      uint32_t now_ms,
+			      const struct caniot_frame *frame)
+{
+	caniot_busload_add(bl, now_ms, caniot_frame_bits(frame));
+}
+
+uint32_t caniot_busload_window_bits(struct caniot_busload *bl, uint32_t now_ms)
+{
+	ASSERT(bl != NULL);
+
+	uint32_t bits = 0u;
+
+	busload_advance(bl, now_ms);
+
+	for (uint32_t i = 0u; i < BUCKETS; i++) {
+		bits += bl->buckets[i];
+	}
+
+	return bits;
+}
+
+uint32_t caniot_busload_get(struct caniot_busload *bl, uint32_t now_ms)
+{
+	ASSERT(bl != NULL);
+
+	const uint32_t bits = caniot_busload_window_bits(bl, now_ms);
+
+	/* the window does not extend before the initialization */
+	const uint32_t window_ms = MIN((BUCKETS - 1u) * BUCKET_MS + (now_ms - bl->head_ms),
+				       now_ms - bl->start_ms);
+
+	if ((window_ms == 0u) || (bl->bitrate == 0u)) return 0u;
+
+	return (uint32_t)(((uint64_t)bits * 10000000u) /
+			  ((uint64_t)bl->bitrate * window_ms));
+}
+
+#endif /* CONFIG_CANIOT_BUSLOAD */
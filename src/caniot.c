@@ -155,6 +155,9 @@ void caniot_show_deviceid(caniot_did_t did)
 
 void caniot_show_frame(const struct caniot_frame *frame)
 {
+	/* unused if logs are disabled */
+	(void)frame;
+
 	CANIOT_INF(F("%x [ %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx %02hhx ] len "
 		     "= %d"),
 		   caniot_id_to_canid(frame->id),
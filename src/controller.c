@@ -12,10 +12,32 @@
 
 #define __DBG(fmt, ...) CANIOT_DBG("-- " fmt, ##__VA_ARGS__)
 
-#define INVALID_HANDLE ((uint8_t)0x00U)
+#define INVALID_HANDLE ((caniot_handle_t)0x00U)
+
+#if CONFIG_CANIOT_CTRL_HANDLE_GEN
+#define HANDLE_INDEX_BITS 16u
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1u)
+#define HANDLE_GEN_MASK	  0x7FFFu /* handles are returned as positive int */
+#define HANDLE_INDEX(_h)  ((_h) & HANDLE_INDEX_MASK)
+#else
+#define HANDLE_INDEX(_h) (_h)
+#endif
+
+#if CONFIG_CANIOT_CTRL_POOL_EXT
+#define PENDQ_POOL_SIZE(_ctrl) ((_ctrl)->pendingq.pool_size)
+#else
+#define PENDQ_POOL_SIZE(_ctrl) CONFIG_CANIOT_MAX_PENDING_QUERIES
+#endif
 
 static void stop_discovery(struct caniot_controller *ctrl);
+static bool
+is_response_to(const struct caniot_frame *frame, struct caniot_pendq *pq, bool *p_is_error);
+
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+static void submit_ring_drain(struct caniot_controller *ctrl, bool cancel);
+#endif
 
+#if CONFIG_CANIOT_CTRL_PIPELINE_DEPTH <= 1
 static bool is_query_pending_for(struct caniot_controller *ctrl, caniot_did_t did)
 {
 	ASSERT(ctrl != NULL);
@@ -26,6 +48,7 @@ static bool is_query_pending_for(struct caniot_controller *ctrl, caniot_did_t di
 
 	return result;
 }
+#endif
 
 static void
 mark_query_pending_for(struct caniot_controller *ctrl, caniot_did_t did, bool status)
@@ -52,27 +75,6 @@ static void finalize_query_frame(struct caniot_frame *frame, caniot_did_t did)
 	frame->id.sid = CANIOT_DID_SID(did);
 }
 
-static void _pendq_queue(struct pqt **root, struct pqt *item)
-{
-	ASSERT(root != NULL);
-	ASSERT(item != NULL);
-
-	struct pqt **prev_next_p = root;
-	while (*prev_next_p != NULL) {
-		struct pqt *p_current = *prev_next_p;
-
-		if (p_current->delay <= item->delay) {
-			item->delay -= p_current->delay;
-			prev_next_p = &(p_current->next);
-		} else {
-			item->next = p_current;
-			p_current->delay -= item->delay;
-			break;
-		}
-	}
-	*prev_next_p = item;
-}
-
 static void
 pendq_queue(struct caniot_controller *ctrl, struct pendq *pq, uint32_t timeout)
 {
@@ -82,11 +84,15 @@ pendq_queue(struct caniot_controller *ctrl, struct pendq *pq, uint32_t timeout)
 
 	if (pq == NULL) return;
 
+#if CONFIG_CANIOT_CTRL_TIMING_WHEEL
+	caniot_twheel_add(&ctrl->pendingq.timeout_wheel, &pq->tie, timeout);
+#else
 	/* last item doesn't have a "next" item */
 	pq->tie.next	= NULL;
 	pq->tie.timeout = timeout;
 
-	_pendq_queue(&ctrl->pendingq.timeout_queue, &pq->tie);
+	caniot_tqueue_queue(&ctrl->pendingq.timeout_queue, &pq->tie);
+#endif
 
 	__DBG("pendq_queue(ps: %p, timeout: %u)\n", (void *)pq, timeout);
 }
@@ -97,35 +103,27 @@ static void pendq_shift(struct caniot_controller *ctrl, uint32_t time_passed_ms)
 
 	__DBG("pendq_shift(time_passed_ms: %u)\n", time_passed_ms);
 
-	if (time_passed_ms == 0u) return;
-
-	struct pqt **prev_next_p = &ctrl->pendingq.timeout_queue;
-	while (*prev_next_p != NULL) {
-		struct pqt *p_current = *prev_next_p;
-
-		if (p_current->delay <= time_passed_ms) {
-			if (p_current->delay != 0) {
-				time_passed_ms -= p_current->delay;
-				p_current->delay = 0;
-			}
-			prev_next_p = &(p_current->next);
-		} else {
-			p_current->delay -= time_passed_ms;
-			break;
-		}
-	}
+#if CONFIG_CANIOT_CTRL_TIMING_WHEEL
+	caniot_twheel_advance(&ctrl->pendingq.timeout_wheel, time_passed_ms);
+#else
+	caniot_tqueue_shift(&ctrl->pendingq.timeout_queue, time_passed_ms);
+#endif
 }
 
-static struct pendq *pendq_pop_expired(struct pqt **root)
+static struct pendq *pendq_pop_expired(struct caniot_controller *ctrl)
 {
-	ASSERT(root != NULL);
+	ASSERT(ctrl != NULL);
 
 	struct pendq *pq = NULL;
 
-	if ((*root != NULL) && ((*root)->delay == 0)) {
-		struct pqt *item = *root;
-		*root		 = (*root)->next;
+#if CONFIG_CANIOT_CTRL_TIMING_WHEEL
+	struct caniot_twheel_node *item =
+		caniot_twheel_pop_expired(&ctrl->pendingq.timeout_wheel);
+#else
+	struct pqt *item = caniot_tqueue_pop_expired(&ctrl->pendingq.timeout_queue);
+#endif
 
+	if (item != NULL) {
 		pq = CONTAINER_OF(item, struct pendq, tie);
 	}
 
@@ -134,16 +132,19 @@ static struct pendq *pendq_pop_expired(struct pqt **root)
 	return pq;
 }
 
-static struct pendq *pendq_pop(struct pqt **root)
+static struct pendq *pendq_pop(struct caniot_controller *ctrl)
 {
-	ASSERT(root != NULL);
+	ASSERT(ctrl != NULL);
 
 	struct pendq *pq = NULL;
 
-	if (*root != NULL) {
-		struct pqt *item = *root;
-		*root		 = (*root)->next;
+#if CONFIG_CANIOT_CTRL_TIMING_WHEEL
+	struct caniot_twheel_node *item = caniot_twheel_pop(&ctrl->pendingq.timeout_wheel);
+#else
+	struct pqt *item = caniot_tqueue_pop(&ctrl->pendingq.timeout_queue);
+#endif
 
+	if (item != NULL) {
 		pq = CONTAINER_OF(item, struct pendq, tie);
 	}
 
@@ -157,23 +158,16 @@ static void pendq_tqueue_remove(struct caniot_controller *ctrl, struct pendq *pq
 	ASSERT(ctrl != NULL);
 	ASSERT(pq != NULL);
 
-	struct pqt **prev_next_p = &ctrl->pendingq.timeout_queue;
-	while (*prev_next_p != NULL) {
-		struct pqt *p_current = *prev_next_p;
-		if (p_current == &pq->tie) {
-			__DBG("pendq_tqueue_remove(pq: %p) -> removed\n", (void *)pq);
-
-			*prev_next_p = p_current->next;
-			if (p_current->next != NULL) {
-				p_current->next->delay += pq->tie.delay;
-			}
-			pq->tie.next = NULL;
-			return;
-		}
-		prev_next_p = &(p_current->next);
-	}
+#if CONFIG_CANIOT_CTRL_TIMING_WHEEL
+	const bool removed = caniot_twheel_remove(&ctrl->pendingq.timeout_wheel, &pq->tie);
+#else
+	const bool removed = caniot_tqueue_remove(&ctrl->pendingq.timeout_queue, &pq->tie);
+#endif
 
-	__DBG("pendq_tqueue_remove(pq: %p) -> not found\n", (void *)pq);
+	__DBG("pendq_tqueue_remove(pq: %p) -> %s\n",
+	      (void *)pq,
+	      removed ? "removed" : "not found");
+	(void)removed;
 }
 
 static struct pendq *pendq_alloc(struct caniot_controller *ctrl)
@@ -213,45 +207,34 @@ static void pendq_init_queue(struct caniot_controller *ctrl)
 	/* init free list */
 	ctrl->pendingq.free_list = NULL;
 	struct pendq *cur	 = ctrl->pendingq.pool;
-	while (cur < ctrl->pendingq.pool + CONFIG_CANIOT_MAX_PENDING_QUERIES) {
+	while (cur < ctrl->pendingq.pool + PENDQ_POOL_SIZE(ctrl)) {
+#if CONFIG_CANIOT_CTRL_HANDLE_GEN
+		cur->gen = 0u;
+#endif
 		pendq_free(ctrl, cur++);
 	}
 
 	/* init timeout queue */
+#if CONFIG_CANIOT_CTRL_TIMING_WHEEL
+	caniot_twheel_init(&ctrl->pendingq.timeout_wheel);
+#else
 	ctrl->pendingq.timeout_queue = NULL;
+#endif
 }
 
-static struct pendq *pendq_get_by_did(struct caniot_controller *ctrl, caniot_did_t did)
-{
-	ASSERT(ctrl != NULL);
-
-	struct pendq *retpq = NULL;
-
-	struct pqt *tie;
-	for (tie = ctrl->pendingq.timeout_queue; tie != NULL; tie = tie->next) {
-		struct pendq *const pq = CONTAINER_OF(tie, struct pendq, tie);
-		if (CANIOT_DID_EQ(pq->did, did)) {
-			retpq = pq;
-			break;
-		}
-	}
-
-	__DBG("pendq_get_by_did(did: %u) -> pq: %p\n", did, (void *)retpq);
-
-	return retpq;
-}
-
-static struct pendq *pendq_get_by_handle(struct caniot_controller *ctrl, uint8_t handle)
+static struct pendq *pendq_get_by_handle(struct caniot_controller *ctrl,
+					 caniot_handle_t handle)
 {
 	ASSERT(ctrl);
 
-	struct pendq *pq = NULL;
+	struct pendq *pq	    = NULL;
+	const caniot_handle_t index = HANDLE_INDEX(handle);
 
-	if ((handle != INVALID_HANDLE) && (handle <= CONFIG_CANIOT_MAX_PENDING_QUERIES)) {
-		struct pendq *const tmp = &ctrl->pendingq.pool[handle - 1U];
+	if ((index != INVALID_HANDLE) && (index <= PENDQ_POOL_SIZE(ctrl))) {
+		struct pendq *const tmp = &ctrl->pendingq.pool[index - 1U];
 
-		/* if handle is not exactly the same as the index,
-		 * the pq is not allocated */
+		/* if handle is not exactly the same as the one of the slot,
+		 * the pq is not allocated (or is a newer one) */
 		if (tmp->handle == handle) {
 			pq = tmp;
 		}
@@ -262,6 +245,19 @@ static struct pendq *pendq_get_by_handle(struct caniot_controller *ctrl, uint8_t
 	return pq;
 }
 
+static caniot_handle_t pendq_make_handle(struct caniot_controller *ctrl, struct pendq *pq)
+{
+	const caniot_handle_t index = 1U + INDEX_OF(pq, ctrl->pendingq.pool, struct pendq);
+
+#if CONFIG_CANIOT_CTRL_HANDLE_GEN
+	pq->gen = (pq->gen + 1u) & HANDLE_GEN_MASK;
+
+	return ((caniot_handle_t)pq->gen << HANDLE_INDEX_BITS) | index;
+#else
+	return index;
+#endif
+}
+
 static bool pendq_is_broadcast(struct pendq *pq)
 {
 	ASSERT(pq != NULL);
@@ -270,7 +266,7 @@ static bool pendq_is_broadcast(struct pendq *pq)
 }
 
 int caniot_controller_query_user_data_set(struct caniot_controller *ctrl,
-					  uint8_t handle,
+					  caniot_handle_t handle,
 					  void *user_data)
 {
 #if CONFIG_CANIOT_CHECKS
@@ -289,7 +285,7 @@ int caniot_controller_query_user_data_set(struct caniot_controller *ctrl,
 }
 
 void *caniot_controller_query_user_data_get(struct caniot_controller *ctrl,
-					    uint8_t handle)
+					    caniot_handle_t handle)
 {
 #if CONFIG_CANIOT_CHECKS
 	if (!ctrl) return NULL;
@@ -305,19 +301,207 @@ void *caniot_controller_query_user_data_get(struct caniot_controller *ctrl,
 	return user_data;
 }
 
-static struct pendq *peek_pending_query(struct caniot_controller *ctrl, caniot_did_t did)
+/**
+ * @brief Append the query to the queue of the device it is pending on
+ *
+ * @param ctrl Controller instance
+ * @param pq Query to index
+ */
+static void pendq_index_add(struct caniot_controller *ctrl, struct pendq *pq)
 {
 	ASSERT(ctrl != NULL);
+	ASSERT(pq != NULL);
 
-	struct pendq *pq = NULL;
+	struct pendq **prev_next_p = &ctrl->pendingq.index[pq->did];
+	while (*prev_next_p != NULL) {
+		prev_next_p = &(*prev_next_p)->dev_next;
+	}
+	*prev_next_p = pq;
+	pq->dev_next = NULL;
+
+	mark_query_pending_for(ctrl, pq->did, true);
+}
+
+static void pendq_index_remove(struct caniot_controller *ctrl, struct pendq *pq)
+{
+	ASSERT(ctrl != NULL);
+	ASSERT(pq != NULL);
+
+	struct pendq **prev_next_p = &ctrl->pendingq.index[pq->did];
+	while (*prev_next_p != NULL) {
+		if (*prev_next_p == pq) {
+			*prev_next_p = pq->dev_next;
+			break;
+		}
+		prev_next_p = &(*prev_next_p)->dev_next;
+	}
+	pq->dev_next = NULL;
+
+	if (ctrl->pendingq.index[pq->did] == NULL) {
+		mark_query_pending_for(ctrl, pq->did, false);
+	}
+}
+
+/* Tells whether no more query can be registered for the device */
+static bool is_device_busy(struct caniot_controller *ctrl, caniot_did_t did)
+{
+#if CONFIG_CANIOT_CTRL_PIPELINE_DEPTH > 1
+	uint32_t count = 0u;
+	struct pendq *pq;
+
+	for (pq = ctrl->pendingq.index[did]; pq != NULL; pq = pq->dev_next) {
+		count++;
+	}
 
-	if (is_query_pending_for(ctrl, did)) pq = pendq_get_by_did(ctrl, did);
+	return count >= CONFIG_CANIOT_CTRL_PIPELINE_DEPTH;
+#else
+	return is_query_pending_for(ctrl, did);
+#endif
+}
+
+/**
+ * @brief Get the pending query for the given DID the frame is a response to.
+ *
+ * If several queries are pipelined for the device, the oldest matching one is
+ * returned (queries are answered in order).
+ */
+static struct pendq *peek_pending_query(struct caniot_controller *ctrl,
+					caniot_did_t did,
+					const struct caniot_frame *frame)
+{
+	ASSERT(ctrl != NULL);
+	ASSERT(frame != NULL);
+
+	struct pendq *pq;
+
+	for (pq = ctrl->pendingq.index[did]; pq != NULL; pq = pq->dev_next) {
+		if (is_response_to(frame, pq, NULL)) break;
+	}
 
 	__DBG("peek_pending_query(did: %u) -> pq: %p\n", did, (void *)pq);
 
 	return pq;
 }
 
+#if CONFIG_CANIOT_CTRL_COALESCE
+
+/**
+ * @brief Get the pending query an identical query can be coalesced onto.
+ *
+ * Only telemetry and read-attribute queries, which have no side effect on the
+ * device, are coalesced.
+ */
+static struct pendq *pendq_find_coalescable(struct caniot_controller *ctrl,
+					    caniot_did_t did,
+					    const struct caniot_frame *frame)
+{
+	ASSERT(ctrl != NULL);
+	ASSERT(frame != NULL);
+
+	struct pendq *pq;
+
+	/* Queries issued while a response is dispatched are never answered by
+	 * that response */
+	if (ctrl->pendingq.fanout || caniot_is_broadcast(did)) return NULL;
+
+	for (pq = ctrl->pendingq.index[did]; pq != NULL; pq = pq->dev_next) {
+		if (pq->query_type != frame->id.type) continue;
+
+		if ((frame->id.type == CANIOT_FRAME_TYPE_TELEMETRY) &&
+		    (pq->req_endpoint == frame->id.endpoint)) {
+			break;
+		} else if ((frame->id.type == CANIOT_FRAME_TYPE_READ_ATTRIBUTE) &&
+			   (pq->req_attr == frame->attr.key)) {
+			break;
+		}
+	}
+
+	__DBG("pendq_find_coalescable(did: %u) -> pq: %p\n", did, (void *)pq);
+
+	return pq;
+}
+
+static void pendq_coalesce(struct pendq *leader, struct pendq *pq)
+{
+	struct pendq **prev_next_p = &leader->coalesced;
+	while (*prev_next_p != NULL) {
+		prev_next_p = &(*prev_next_p)->coalesced;
+	}
+	*prev_next_p = pq;
+
+	pq->leader = leader;
+}
+
+static void pendq_uncoalesce(struct pendq *pq)
+{
+	struct pendq **prev_next_p = &pq->leader->coalesced;
+	while (*prev_next_p != pq) {
+		prev_next_p = &(*prev_next_p)->coalesced;
+	}
+	*prev_next_p = pq->coalesced;
+
+	pq->leader    = NULL;
+	pq->coalesced = NULL;
+}
+
+/**
+ * @brief Replace the leader "pq" by its first coalesced query in the queue of
+ * the device, the other coalesced queries follow the new leader.
+ */
+static void pendq_promote_coalesced(struct caniot_controller *ctrl, struct pendq *pq)
+{
+	struct pendq *const next = pq->coalesced;
+	struct pendq *cur;
+
+	struct pendq **prev_next_p = &ctrl->pendingq.index[pq->did];
+	while (*prev_next_p != pq) {
+		prev_next_p = &(*prev_next_p)->dev_next;
+	}
+	*prev_next_p   = next;
+	next->dev_next = pq->dev_next;
+	next->leader   = NULL;
+
+	for (cur = next->coalesced; cur != NULL; cur = cur->coalesced) {
+		cur->leader = next;
+	}
+
+	pq->dev_next  = NULL;
+	pq->coalesced = NULL;
+}
+
+#endif
+
+/**
+ * @brief Release a query context, the device is no longer marked as pending
+ * if it was its last query.
+ *
+ * @param ctrl Controller instance
+ * @param pq Pending query to release (no longer in the timeout queue)
+ */
+static void pendq_release(struct caniot_controller *ctrl, struct pendq *pq)
+{
+	ASSERT(ctrl != NULL);
+	ASSERT(pq != NULL);
+
+#if CONFIG_CANIOT_CTRL_COALESCE
+	if (pq->leader != NULL) {
+		pendq_uncoalesce(pq);
+	} else if (pq->coalesced != NULL) {
+		pendq_promote_coalesced(ctrl, pq);
+	} else
+#endif
+	{
+		pendq_index_remove(ctrl, pq);
+	}
+
+#if CONFIG_CANIOT_TXQ && CONFIG_CANIOT_CTRL_DRIVERS_API
+	/* the handle can be given to a new query */
+	caniot_txq_disown(&ctrl->txq, pq->handle);
+#endif
+
+	pendq_free(ctrl, pq);
+}
+
 /**
  * @brief Remove a pending query from the list of tracked queries.
  *
@@ -329,13 +513,108 @@ static void pendq_remove(struct caniot_controller *ctrl, struct pendq *pq)
 	ASSERT(ctrl != NULL);
 	ASSERT(pq != NULL);
 
-	mark_query_pending_for(ctrl, pq->did, false);
 	pendq_tqueue_remove(ctrl, pq);
-	pendq_free(ctrl, pq);
+	pendq_release(ctrl, pq);
+}
+
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+
+#define SUBMIT_RING_MASK (CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE - 1u)
+
+static void submit_ring_init(struct caniot_submit_ring *ring)
+{
+	ring->enqueue_pos = 0u;
+	ring->dequeue_pos = 0u;
+
+	for (uint32_t i = 0u; i < CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE; i++) {
+		ring->cells[i].seq = i;
+	}
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_SCHED
+
+/* Bits credited per ms are bitrate * load_percent / SCHED_RATE_DIV */
+#define SCHED_RATE_DIV 100000u
+
+/* Budget of a job: its query and the response to it */
+#define SCHED_JOB_COST(_job)                                                             \
+	((int32_t)(CANIOT_FRAME_BITS_MAX((_job)->frame.len) + CANIOT_FRAME_BITS_MAX(8u)))
+
+static int32_t sched_capacity(const struct caniot_ctrl_sched *sched)
+{
+	const uint64_t cap = ((uint64_t)sched->bitrate * sched->load_percent *
+			      CONFIG_CANIOT_CTRL_SCHED_BURST_MS) /
+			     SCHED_RATE_DIV;
+
+	/* any job must fit in the budget */
+	return (int32_t)MIN(MAX(cap, 2u * CANIOT_FRAME_BITS_MAX(8u)), INT32_MAX);
+}
+
+static void sched_credit(struct caniot_controller *ctrl)
+{
+	struct caniot_ctrl_sched *const sched = &ctrl->sched;
+	const uint32_t elapsed		      = ctrl->clock_ms - sched->credit_ms;
+	const int32_t cap		      = sched_capacity(sched);
+
+	sched->credit_ms = ctrl->clock_ms;
+
+	const uint64_t acc = (uint64_t)elapsed * sched->bitrate * sched->load_percent +
+			     sched->credit_rem;
+	const int64_t credits = (int64_t)sched->credits + (int64_t)(acc / SCHED_RATE_DIV);
+
+	if (credits >= cap) {
+		sched->credits	  = cap;
+		sched->credit_rem = 0u;
+	} else {
+		sched->credits	  = (int32_t)credits;
+		sched->credit_rem = (uint32_t)(acc % SCHED_RATE_DIV);
+	}
+}
+
+static void sched_charge(struct caniot_controller *ctrl, const struct caniot_frame *frame)
+{
+	struct caniot_ctrl_sched *const sched = &ctrl->sched;
+
+	sched_credit(ctrl);
+
+	/* bounded debt, so that a burst of traffic does not stall jobs for long */
+	sched->credits = MAX(sched->credits - (int32_t)CANIOT_FRAME_BITS_MAX(frame->len),
+			     -sched_capacity(sched));
+}
+
+#define SCHED_CHARGE(_ctrl, _frame) sched_charge(_ctrl, _frame)
+#else
+#define SCHED_CHARGE(_ctrl, _frame)
+#endif
+
+#if CONFIG_CANIOT_BUSLOAD
+static void busload_feed(struct caniot_controller *ctrl, const struct caniot_frame *frame)
+{
+	if (ctrl->busload != NULL) {
+		caniot_busload_add_frame(ctrl->busload, ctrl->clock_ms, frame);
+	}
+}
+
+void caniot_controller_busload_attach(struct caniot_controller *ctrl,
+				      struct caniot_busload *bl)
+{
+	ASSERT(ctrl != NULL);
+
+	ctrl->busload = bl;
 }
 
+#define BUSLOAD_FEED(_ctrl, _frame) busload_feed(_ctrl, _frame)
+#else
+#define BUSLOAD_FEED(_ctrl, _frame)
+#endif
+
 // Initialize ctrl structure
-int caniot_controller_init(struct caniot_controller *ctrl,
+/* "pool" NULL for the pool of the controller */
+static int controller_init(struct caniot_controller *ctrl,
+			   struct pendq *pool,
+			   size_t pool_size,
 			   caniot_controller_event_cb_t cb,
 			   void *user_data)
 {
@@ -351,24 +630,84 @@ int caniot_controller_init(struct caniot_controller *ctrl,
 		goto exit;
 	}
 
+#if CONFIG_CANIOT_CTRL_POOL_EXT
+	/* handles are 1 + index of the query in the pool */
+	if ((pool != NULL) && ((pool_size == 0u) || (pool_size > UINT16_MAX))) {
+		ret = -CANIOT_EINVAL;
+		goto exit;
+	}
+#endif
+
 	memset(ctrl, 0, sizeof(struct caniot_controller));
 
 	ctrl->event_cb	= cb;
 	ctrl->user_data = user_data;
 
+#if CONFIG_CANIOT_CTRL_POOL_EXT
+	if (pool == NULL) {
+		pool	  = ctrl->pendingq.pool_storage;
+		pool_size = CONFIG_CANIOT_MAX_PENDING_QUERIES;
+	}
+
+	ctrl->pendingq.pool	 = pool;
+	ctrl->pendingq.pool_size = (uint16_t)pool_size;
+#else
+	(void)pool;
+	(void)pool_size;
+#endif
+
 	pendq_init_queue(ctrl);
 
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+	submit_ring_init(&ctrl->submit_ring);
+#endif
+
+#if CONFIG_CANIOT_TXQ && CONFIG_CANIOT_CTRL_DRIVERS_API
+	caniot_txq_init(&ctrl->txq);
+	ctrl->txq_blocked = false;
+#endif
+
+#if CONFIG_CANIOT_CTRL_SCHED
+	ctrl->sched.bitrate	 = CONFIG_CANIOT_CTRL_SCHED_BITRATE;
+	ctrl->sched.load_percent = CONFIG_CANIOT_CTRL_SCHED_LOAD_PERCENT;
+	ctrl->sched.credits	 = sched_capacity(&ctrl->sched);
+#endif
+
 exit:
 	return ret;
 }
 
+int caniot_controller_init(struct caniot_controller *ctrl,
+			   caniot_controller_event_cb_t cb,
+			   void *user_data)
+{
+	return controller_init(ctrl, NULL, 0u, cb, user_data);
+}
+
+#if CONFIG_CANIOT_CTRL_POOL_EXT
+int caniot_controller_init_pool(struct caniot_controller *ctrl,
+				struct caniot_pendq *pool,
+				size_t pool_size,
+				caniot_controller_event_cb_t cb,
+				void *user_data)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!pool) return -CANIOT_EINVAL;
+#endif
+
+	return controller_init(ctrl, pool, pool_size, cb, user_data);
+}
+#endif
+
 #if CONFIG_CANIOT_CTRL_DRIVERS_API
-int caniot_controller_driv_init(struct caniot_controller *ctrl,
+static int controller_driv_init(struct caniot_controller *ctrl,
+				struct pendq *pool,
+				size_t pool_size,
 				const struct caniot_drivers_api *driv,
 				caniot_controller_event_cb_t cb,
 				void *user_data)
 {
-	int ret = caniot_controller_init(ctrl, cb, user_data);
+	int ret = controller_init(ctrl, pool, pool_size, cb, user_data);
 	if (ret < 0) {
 		goto exit;
 	}
@@ -382,20 +721,63 @@ int caniot_controller_driv_init(struct caniot_controller *ctrl,
 exit:
 	return ret;
 }
-#else
+
 int caniot_controller_driv_init(struct caniot_controller *ctrl,
 				const struct caniot_drivers_api *driv,
 				caniot_controller_event_cb_t cb,
 				void *user_data)
 {
-	(void)ctrl;
-	(void)driv;
-	(void)cb;
-	(void)user_data;
-
-	return -CANIOT_ENOTSUP;
+	return controller_driv_init(ctrl, NULL, 0u, driv, cb, user_data);
 }
-#endif
+
+#if CONFIG_CANIOT_CTRL_POOL_EXT
+int caniot_controller_driv_init_pool(struct caniot_controller *ctrl,
+				     struct caniot_pendq *pool,
+				     size_t pool_size,
+				     const struct caniot_drivers_api *driv,
+				     caniot_controller_event_cb_t cb,
+				     void *user_data)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!pool) return -CANIOT_EINVAL;
+#endif
+
+	return controller_driv_init(ctrl, pool, pool_size, driv, cb, user_data);
+}
+#endif
+#else
+int caniot_controller_driv_init(struct caniot_controller *ctrl,
+				const struct caniot_drivers_api *driv,
+				caniot_controller_event_cb_t cb,
+				void *user_data)
+{
+	(void)ctrl;
+	(void)driv;
+	(void)cb;
+	(void)user_data;
+
+	return -CANIOT_ENOTSUP;
+}
+
+#if CONFIG_CANIOT_CTRL_POOL_EXT
+int caniot_controller_driv_init_pool(struct caniot_controller *ctrl,
+				     struct caniot_pendq *pool,
+				     size_t pool_size,
+				     const struct caniot_drivers_api *driv,
+				     caniot_controller_event_cb_t cb,
+				     void *user_data)
+{
+	(void)ctrl;
+	(void)pool;
+	(void)pool_size;
+	(void)driv;
+	(void)cb;
+	(void)user_data;
+
+	return -CANIOT_ENOTSUP;
+}
+#endif
+#endif
 
 uint32_t caniot_controller_next_timeout(const struct caniot_controller *ctrl)
 {
@@ -403,6 +785,9 @@ uint32_t caniot_controller_next_timeout(const struct caniot_controller *ctrl)
 	if (!ctrl) return 0xFFFFFFFFu;
 #endif
 
+#if CONFIG_CANIOT_CTRL_TIMING_WHEEL
+	uint32_t next_timeout = caniot_twheel_next_timeout(&ctrl->pendingq.timeout_wheel);
+#else
 	uint32_t next_timeout = (uint32_t)-1;
 
 	struct pqt *next = ctrl->pendingq.timeout_queue;
@@ -410,10 +795,192 @@ uint32_t caniot_controller_next_timeout(const struct caniot_controller *ctrl)
 	if (next != NULL) {
 		next_timeout = next->timeout;
 	}
+#endif
+
+#if CONFIG_CANIOT_CTRL_SCHED
+	next_timeout = MIN(next_timeout, caniot_controller_sched_next_deadline(ctrl));
+#endif
+
+#if CONFIG_CANIOT_TXQ && CONFIG_CANIOT_CTRL_DRIVERS_API
+	/* frames left in the queue wait for the mailbox, poll it on next tick */
+	if (ctrl->txq_blocked) {
+		next_timeout = MIN(next_timeout, 1u);
+	}
+#endif
 
 	return next_timeout;
 }
 
+#if CONFIG_CANIOT_CTRL_METRICS
+
+/* Metrics are only written by the controller thread, between metrics_begin()
+ * and metrics_end(), readers retry if the sequence number changed meanwhile */
+static void metrics_begin(struct caniot_controller *ctrl)
+{
+	__atomic_store_n(&ctrl->metrics.seq, ctrl->metrics.seq + 1u, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void metrics_end(struct caniot_controller *ctrl)
+{
+	__atomic_store_n(&ctrl->metrics.seq, ctrl->metrics.seq + 1u, __ATOMIC_RELEASE);
+}
+
+static void metrics_add(uint32_t *counter)
+{
+	__atomic_store_n(counter, *counter + 1u, __ATOMIC_RELAXED);
+}
+
+static void metrics_inc(struct caniot_controller *ctrl, uint32_t *counter)
+{
+	metrics_begin(ctrl);
+	metrics_add(counter);
+	metrics_end(ctrl);
+}
+
+static uint32_t *metrics_rtt_bucket(struct caniot_controller *ctrl,
+				    caniot_did_t did,
+				    uint32_t rtt_ms)
+{
+	uint32_t bucket = (rtt_ms == 0u) ? 0u : 32u - __builtin_clz(rtt_ms);
+	bucket		= MIN(bucket, CANIOT_CTRL_RTT_BUCKETS - 1u);
+
+	return &ctrl->metrics.data.rtt_hist[did][bucket];
+}
+
+#define METRICS_INC(_ctrl, _counter) metrics_inc(_ctrl, &(_ctrl)->metrics.data._counter)
+
+void caniot_controller_metrics_snapshot(const struct caniot_controller *ctrl,
+					struct caniot_ctrl_metrics *metrics)
+{
+	ASSERT(ctrl != NULL);
+	ASSERT(metrics != NULL);
+
+	const uint32_t *const src = (const uint32_t *)&ctrl->metrics.data;
+	uint32_t *const dst	  = (uint32_t *)metrics;
+	uint32_t seq;
+
+	do {
+		/* wait for the update in progress */
+		do {
+			seq = __atomic_load_n(&ctrl->metrics.seq, __ATOMIC_ACQUIRE);
+		} while (seq & 1u);
+
+		for (size_t i = 0u; i < sizeof(*metrics) / sizeof(uint32_t); i++) {
+			dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+		}
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (__atomic_load_n(&ctrl->metrics.seq, __ATOMIC_RELAXED) != seq);
+}
+
+#else
+#define METRICS_INC(_ctrl, _counter)
+#endif
+
+#if CONFIG_CANIOT_CTRL_DRIVERS_API
+
+static void frame_sent(struct caniot_controller *ctrl, const struct caniot_frame *frame)
+{
+	/* unused if no accounting is enabled */
+	(void)ctrl;
+	(void)frame;
+
+	METRICS_INC(ctrl, sent);
+	SCHED_CHARGE(ctrl, frame);
+	BUSLOAD_FEED(ctrl, frame);
+}
+
+#if CONFIG_CANIOT_TXQ
+/* Make the query whose frame was dropped expire on next process, the query
+ * is not released here as its owner may not have queued it yet */
+static void pendq_send_failed(struct caniot_controller *ctrl, caniot_handle_t handle)
+{
+	struct pendq *const pq = pendq_get_by_handle(ctrl, handle);
+	if (pq == NULL) return;
+
+	pq->send_failed = 1u;
+	pendq_tqueue_remove(ctrl, pq);
+	pendq_queue(ctrl, pq, 0u);
+
+#if CONFIG_CANIOT_CTRL_COALESCE
+	/* coalesced queries wait for the same frame */
+	for (struct pendq *cur = pq->coalesced; cur != NULL; cur = cur->coalesced) {
+		cur->send_failed = 1u;
+		pendq_tqueue_remove(ctrl, cur);
+		pendq_queue(ctrl, cur, 0u);
+	}
+#endif
+}
+
+/* Pass the queued frames to the driver by order of CAN identifier, until the
+ * mailbox is full.
+ *
+ * Returns the error of the item of sequence number "pushed" (-1 if none) if
+ * the driver failed to send it, the queries of the other frames dropped expire
+ * on next process. */
+static int txq_flush(struct caniot_controller *ctrl, int32_t pushed)
+{
+	struct caniot_txq_item *item;
+	int pushed_ret = 0;
+
+	ctrl->txq_blocked = false;
+
+	while ((item = caniot_txq_peek(&ctrl->txq, ctrl->clock_ms)) != NULL) {
+		const int ret = ctrl->driv->send(&item->frame, 0u);
+		if (ret == -CANIOT_EAGAIN) {
+			ctrl->txq.stats.mailbox_full++;
+			ctrl->txq_blocked = true;
+			break;
+		} else if (ret < 0) {
+			CANIOT_ERR(F("txq: failed to send frame: %d\n"), ret);
+			ctrl->txq.stats.dropped++;
+
+			if ((int32_t)item->seq == pushed) {
+				pushed_ret = ret;
+			} else {
+				pendq_send_failed(ctrl, (caniot_handle_t)item->owner);
+			}
+		} else {
+			ctrl->txq.stats.sent++;
+			frame_sent(ctrl, &item->frame);
+		}
+
+		caniot_txq_remove(&ctrl->txq, item);
+	}
+
+	return pushed_ret;
+}
+#endif
+
+/* Send a frame for query "owner" (INVALID_HANDLE if none), or queue it if
+ * CONFIG_CANIOT_TXQ is enabled. The error is returned if the frame fails to be
+ * sent right away, a queued frame failing to be sent later makes its query
+ * expire, as cancelled. */
+static int controller_send(struct caniot_controller *ctrl,
+			   const struct caniot_frame *frame,
+			   caniot_handle_t owner)
+{
+#if CONFIG_CANIOT_TXQ
+	int ret = caniot_txq_push(&ctrl->txq, frame, ctrl->clock_ms, 0u, owner);
+	if (ret == 0) {
+		/* sequence number of the item just pushed */
+		const uint16_t seq = (uint16_t)(ctrl->txq.seq - 1u);
+
+		ret = txq_flush(ctrl, (int32_t)seq);
+	}
+#else
+	(void)owner;
+
+	const int ret = ctrl->driv->send(frame, 0u);
+	if (ret >= 0) frame_sent(ctrl, frame);
+#endif
+
+	return ret;
+}
+
+#endif /* CONFIG_CANIOT_CTRL_DRIVERS_API */
+
 static bool call_user_callback(struct caniot_controller *ctrl,
 			       const caniot_controller_event_t *ev)
 {
@@ -460,6 +1027,8 @@ static void orphan_resp_event(struct caniot_controller *ctrl,
 		.user_data = NULL,
 	};
 
+	METRICS_INC(ctrl, orphan);
+
 	call_user_callback(ctrl, &ev);
 }
 
@@ -475,6 +1044,108 @@ static bool pendq_is_discovery(struct caniot_controller *ctrl, struct pendq *pq)
 #endif
 }
 
+#if CONFIG_CANIOT_CTRL_BULK
+
+static void bulk_attr_done(struct caniot_ctrl_bulk *bulk, uint16_t index, int status)
+{
+	bulk->attrs[index].status = status;
+	if (status != 0) bulk->failed++;
+}
+
+/**
+ * @brief Send queries for the next attributes of a bulk operation, until the
+ * window is full.
+ */
+static void bulk_pump(struct caniot_controller *ctrl, struct caniot_ctrl_bulk *bulk)
+{
+	struct caniot_frame frame;
+	int ret;
+
+	while ((bulk->pending < bulk->window) && (bulk->next < bulk->count)) {
+		const uint16_t index		    = bulk->next;
+		const struct caniot_bulk_attr *attr = &bulk->attrs[index];
+
+		if (bulk->write) {
+			caniot_build_query_write_attribute(&frame, attr->key, attr->val);
+		} else {
+			caniot_build_query_read_attribute(&frame, attr->key);
+		}
+
+		ret = caniot_controller_query(ctrl, bulk->did, &frame, bulk->timeout);
+		if (ret > 0) {
+			struct pendq *const pq =
+				pendq_get_by_handle(ctrl, (caniot_handle_t)ret);
+			ASSERT(pq != NULL);
+
+			pq->bulk       = bulk;
+			pq->bulk_index = index;
+			bulk->pending++;
+		} else if (((ret == -CANIOT_EBUSY) || (ret == -CANIOT_EPQALLOC)) &&
+			   (bulk->pending != 0u)) {
+			/* retried when a query of the operation completes */
+			break;
+		} else {
+			bulk_attr_done(bulk, index, ret < 0 ? ret : -CANIOT_EUNEXPECTED);
+		}
+
+		bulk->next++;
+	}
+}
+
+static void bulk_complete(struct caniot_controller *ctrl, struct caniot_ctrl_bulk *bulk)
+{
+	if ((bulk->pending == 0u) && (bulk->next >= bulk->count)) {
+		bulk->running = false;
+
+		__DBG("bulk_complete(did: %u, count: %u) -> failed: %u\n",
+		      bulk->did,
+		      bulk->count,
+		      bulk->failed);
+
+		bulk->cb(ctrl, bulk, bulk->user_data);
+	}
+}
+
+/**
+ * @brief Handle the event of a query of a bulk operation, instead of the event
+ * callback of the controller.
+ */
+static void bulk_query_done(struct caniot_controller *ctrl,
+			    struct caniot_ctrl_bulk *bulk,
+			    uint16_t index,
+			    const caniot_controller_event_t *ev)
+{
+	ASSERT(bulk->pending != 0u);
+
+	struct caniot_bulk_attr *const attr = &bulk->attrs[index];
+	bulk->pending--;
+
+	switch (ev->status) {
+	case CANIOT_CONTROLLER_EVENT_STATUS_OK:
+		/* value read, or read back after the write */
+		attr->val = ev->response->attr.val;
+		bulk_attr_done(bulk, index, 0);
+		break;
+	case CANIOT_CONTROLLER_EVENT_STATUS_ERROR:
+		bulk_attr_done(bulk,
+			       index,
+			       ev->response->err.code < 0 ? ev->response->err.code
+							  : -CANIOT_EUNEXPECTED);
+		break;
+	case CANIOT_CONTROLLER_EVENT_STATUS_TIMEOUT:
+		bulk_attr_done(bulk, index, -CANIOT_ETIMEOUT);
+		break;
+	default:
+		bulk_attr_done(bulk, index, -CANIOT_ECANCELED);
+		break;
+	}
+
+	bulk_pump(ctrl, bulk);
+	bulk_complete(ctrl, bulk);
+}
+
+#endif
+
 static void
 cancelled_query_event(struct caniot_controller *ctrl, struct pendq *pq, bool suppress)
 {
@@ -490,27 +1161,178 @@ cancelled_query_event(struct caniot_controller *ctrl, struct pendq *pq, bool sup
 		.terminated = 1U,
 		.handle	    = pq->handle,
 
-		.response  = NULL,
+		.response = NULL,
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+		.responders = pq->notified,
+#endif
 		.user_data = pq->user_data,
 	};
 
+#if CONFIG_CANIOT_CTRL_BULK
+	struct caniot_ctrl_bulk *const bulk = pq->bulk;
+	const uint16_t bulk_index	    = pq->bulk_index;
+#endif
+
 	pendq_remove(ctrl, pq);
 
+	METRICS_INC(ctrl, cancelled);
+
 #if CONFIG_CANIOT_CONTROLLER_DISCOVERY
 	if (pendq_is_discovery(ctrl, pq)) stop_discovery(ctrl);
 #endif
 
-	if (!suppress) call_user_callback(ctrl, &ev);
+	if (suppress) return;
+
+#if CONFIG_CANIOT_CTRL_BULK
+	if (bulk != NULL) {
+		bulk_query_done(ctrl, bulk, bulk_index, &ev);
+		return;
+	}
+#endif
+
+	call_user_callback(ctrl, &ev);
+}
+
+#if CONFIG_CANIOT_CTRL_RTT
+
+static void rtt_update(struct caniot_controller *ctrl, caniot_did_t did, uint32_t rtt_ms)
+{
+	struct caniot_ctrl_rtt *const e = &ctrl->rtt[did];
+	const int32_t r			= (int32_t)MIN(rtt_ms, INT32_MAX >> 3);
+
+	if (!e->valid) {
+		e->srtt	  = r << 3;
+		e->rttvar = r << 1;
+		e->valid  = 1u;
+	} else {
+		/* SRTT += (R - SRTT) / 8, RTTVAR += (|R - SRTT| - RTTVAR) / 4 */
+		int32_t delta = r - (e->srtt >> 3);
+		e->srtt += delta;
+		if (delta < 0) delta = -delta;
+		e->rttvar += delta - (e->rttvar >> 2);
+	}
+
+	__DBG("rtt_update(did: %u, rtt: %u) -> srtt: %d rttvar: %d\n",
+	      did,
+	      rtt_ms,
+	      e->srtt >> 3,
+	      e->rttvar >> 2);
+}
+
+uint32_t caniot_controller_rtt_timeout(const struct caniot_controller *ctrl,
+				       caniot_did_t did)
+{
+	ASSERT(ctrl != NULL);
+
+	uint32_t timeout = CONFIG_CANIOT_CTRL_RTT_TIMEOUT_INIT_MS;
+
+	if ((did < CANIOT_DID_MAX_COUNT) && ctrl->rtt[did].valid) {
+		const struct caniot_ctrl_rtt *const e = &ctrl->rtt[did];
+
+		/* SRTT + 4 * RTTVAR */
+		timeout = (uint32_t)(e->srtt >> 3) + (uint32_t)e->rttvar;
+		timeout = MAX(timeout, CONFIG_CANIOT_CTRL_RTT_TIMEOUT_MIN_MS);
+		timeout = MIN(timeout, CONFIG_CANIOT_CTRL_RTT_TIMEOUT_MAX_MS);
+	}
+
+	return timeout;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_RETRY
+
+static uint32_t pendq_retry_backoff(struct caniot_controller *ctrl, struct pendq *pq)
+{
+	uint64_t delay = pq->retry.backoff_ms;
+
+	if (pq->retry.policy.jitter_ms != 0u) {
+		ASSERT(ctrl->driv->entropy != NULL);
+
+		uint32_t rdm;
+		ctrl->driv->entropy((uint8_t *)&rdm, sizeof(rdm));
+
+		delay += rdm % ((uint64_t)pq->retry.policy.jitter_ms + 1u);
+	}
+
+	if (pq->retry.policy.multiplier > 1u) {
+		pq->retry.backoff_ms = MIN((uint64_t)pq->retry.backoff_ms *
+						   pq->retry.policy.multiplier,
+					   CANIOT_TIMEOUT_FOREVER - 1u);
+	}
+
+	return MIN(delay, CANIOT_TIMEOUT_FOREVER - 1u);
+}
+
+/**
+ * @brief Handle the expiry of a query according to its retry policy
+ *
+ * @return true If the query is still pending (waiting for the backoff or sent
+ * again)
+ * @return false If the last attempt timed out
+ */
+static bool pendq_retry(struct caniot_controller *ctrl, struct pendq *pq)
+{
+	ASSERT(ctrl != NULL);
+	ASSERT(pq != NULL);
+
+	if (!pq->retry.backoff) {
+		if (pq->retry.attempts >= pq->retry.policy.max_attempts) return false;
+
+		const uint32_t delay = pendq_retry_backoff(ctrl, pq);
+		if (delay != 0u) {
+			pq->retry.backoff = 1u;
+			pendq_queue(ctrl, pq, delay);
+			return true;
+		}
+	}
+
+	/* backoff elapsed, send the frame again */
+	pq->retry.backoff = 0u;
+	pq->retry.attempts++;
+
+#if CONFIG_CANIOT_CTRL_RTT || CONFIG_CANIOT_CTRL_METRICS
+	/* the response could be to any of the frames sent */
+	pq->rtt_sample = 0u;
+#endif
+
+#if CONFIG_CANIOT_TXQ && CONFIG_CANIOT_CTRL_DRIVERS_API
+	pq->send_failed = 0u;
+#endif
+
+	const int ret = controller_send(ctrl, &pq->retry.frame, pq->handle);
+	if (ret < 0) {
+		CANIOT_ERR(F("retry: failed to send query %u: %d\n"), pq->handle, ret);
+	}
+
+	pendq_queue(ctrl, pq, pq->retry.timeout);
+
+	__DBG("pendq_retry(pq: %p) -> attempt %u\n", (void *)pq, pq->retry.attempts);
+
+	return true;
 }
 
+#endif
+
 static void pendq_call_expired(struct caniot_controller *ctrl)
 {
 	ASSERT(ctrl != NULL);
 
 	struct pendq *pq;
-	struct pqt **const q = &ctrl->pendingq.timeout_queue;
 
-	while ((pq = pendq_pop_expired(q)) != NULL) {
+	while ((pq = pendq_pop_expired(ctrl)) != NULL) {
+#if CONFIG_CANIOT_CTRL_RETRY
+		if (pendq_retry(ctrl, pq) == true) continue;
+#endif
+
+#if CONFIG_CANIOT_TXQ && CONFIG_CANIOT_CTRL_DRIVERS_API
+		/* the frame of the query was dropped */
+		if (pq->send_failed) {
+			cancelled_query_event(ctrl, pq, false);
+			continue;
+		}
+#endif
+
 		const caniot_controller_event_t ev = {
 			.controller = ctrl,
 			.context    = CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY,
@@ -521,24 +1343,41 @@ static void pendq_call_expired(struct caniot_controller *ctrl)
 			.terminated = 1U,
 			.handle	    = pq->handle,
 
-			.response  = NULL,
+			.response = NULL,
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+			.responders = pq->notified,
+#endif
 			.user_data = pq->user_data,
 		};
 
-		mark_query_pending_for(ctrl, pq->did, false);
-		pendq_free(ctrl, pq);
+#if CONFIG_CANIOT_CTRL_BULK
+		struct caniot_ctrl_bulk *const bulk = pq->bulk;
+		const uint16_t bulk_index	    = pq->bulk_index;
+#endif
+
+		pendq_release(ctrl, pq);
+
+		METRICS_INC(ctrl, timeout);
 
 #if CONFIG_CANIOT_CONTROLLER_DISCOVERY
 		if (pendq_is_discovery(ctrl, pq)) stop_discovery(ctrl);
 #endif
 
+#if CONFIG_CANIOT_CTRL_BULK
+		if (bulk != NULL) {
+			bulk_query_done(ctrl, bulk, bulk_index, &ev);
+			continue;
+		}
+#endif
+
 		call_user_callback(ctrl, &ev);
 	}
 }
 
 static struct pendq *pendq_alloc_and_prepare(struct caniot_controller *ctrl,
 					     caniot_did_t did,
-					     struct caniot_frame *frame)
+					     struct caniot_frame *frame,
+					     struct pendq *leader)
 {
 	/* allocate */
 	struct pendq *pq = pendq_alloc(ctrl);
@@ -546,12 +1385,24 @@ static struct pendq *pendq_alloc_and_prepare(struct caniot_controller *ctrl,
 	if (pq != NULL) {
 		/* prepare data */
 		pq->did	       = did;
-		pq->handle     = 1U + INDEX_OF(pq, ctrl->pendingq.pool, struct pendq);
+		pq->handle     = pendq_make_handle(ctrl, pq);
 		pq->query_type = frame->id.type;
 		pq->notified   = 0llu;
 
-#if CONFIG_CANIOT_QUERY_ID
-		pq->query_id = 0u;
+#if CONFIG_CANIOT_CTRL_TIMING_WHEEL
+		pq->tie.pprev = NULL;
+#endif
+
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+		pq->expected = 0llu;
+#endif
+
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+		pq->aggregate = NULL;
+#endif
+
+#if CONFIG_CANIOT_TXQ && CONFIG_CANIOT_CTRL_DRIVERS_API
+		pq->send_failed = 0u;
 #endif
 
 		switch (pq->query_type) {
@@ -566,6 +1417,39 @@ static struct pendq *pendq_alloc_and_prepare(struct caniot_controller *ctrl,
 		default:
 			break;
 		}
+
+#if CONFIG_CANIOT_CTRL_RETRY
+		/* no retry unless set by caniot_controller_query_retry() */
+		pq->retry.attempts	      = 1u;
+		pq->retry.policy.max_attempts = 0u;
+		pq->retry.backoff	      = 0u;
+#endif
+
+#if CONFIG_CANIOT_CTRL_BULK
+		pq->bulk = NULL;
+#endif
+
+#if CONFIG_CANIOT_CTRL_RTT || CONFIG_CANIOT_CTRL_METRICS
+		/* coalesced queries do not send the frame */
+		pq->sent_ms    = ctrl->clock_ms;
+		pq->rtt_sample = leader == NULL;
+#endif
+
+#if CONFIG_CANIOT_CTRL_COALESCE
+		pq->leader    = NULL;
+		pq->coalesced = NULL;
+
+		if (leader != NULL) {
+			/* only the leader is indexed */
+			pendq_coalesce(leader, pq);
+			return pq;
+		}
+#else
+		(void)leader;
+#endif
+
+		/* index the query, whatever its timeout */
+		pendq_index_add(ctrl, pq);
 	}
 
 	return pq;
@@ -584,8 +1468,15 @@ static int query(struct caniot_controller *ctrl,
 	if (!ctrl || !frame) return -CANIOT_EINVAL;
 #endif
 
-	const bool alloc_context = timeout != 0U;
-	struct pendq *pq	 = NULL;
+#if CONFIG_CANIOT_CTRL_RTT
+	if (timeout == CANIOT_TIMEOUT_ADAPTIVE) {
+		timeout = caniot_controller_rtt_timeout(ctrl, did);
+	}
+#endif
+
+	const bool alloc_context = timeout != 0U;
+	struct pendq *pq	 = NULL;
+	struct pendq *leader	 = NULL;
 
 	/* if timeout is defined, we need to allocate a context */
 	if (alloc_context == true) {
@@ -594,14 +1485,23 @@ static int query(struct caniot_controller *ctrl,
 			goto exit;
 		}
 
-		/* another query is already pending for the device */
-		if (is_query_pending_for(ctrl, did) == true) {
+#if CONFIG_CANIOT_CTRL_COALESCE
+		/* the frame is not sent if the same query is already pending */
+		if (driv_send == true) {
+			leader = pendq_find_coalescable(ctrl, did, frame);
+		}
+#endif
+
+		/* too many queries are already pending for the device */
+		if ((leader == NULL) && (is_device_busy(ctrl, did) == true)) {
+			METRICS_INC(ctrl, busy);
 			ret = -CANIOT_EBUSY;
 			goto exit;
 		}
 
-		pq = pendq_alloc_and_prepare(ctrl, did, frame);
+		pq = pendq_alloc_and_prepare(ctrl, did, frame, leader);
 		if (pq == NULL) {
+			METRICS_INC(ctrl, pqalloc);
 			ret = -CANIOT_EPQALLOC;
 			goto exit;
 		}
@@ -611,10 +1511,13 @@ static int query(struct caniot_controller *ctrl,
 	finalize_query_frame(frame, did);
 
 #if CONFIG_CANIOT_CTRL_DRIVERS_API
-	if (driv_send == true) {
+	if ((driv_send == true) && (leader == NULL)) {
 		/* send frame */
-		ret = ctrl->driv->send(frame, 0U);
+		const caniot_handle_t owner = (pq != NULL) ? pq->handle : INVALID_HANDLE;
+
+		ret = controller_send(ctrl, frame, owner);
 		if (ret < 0) {
+			if (pq != NULL) pendq_release(ctrl, pq);
 			goto exit;
 		}
 	}
@@ -626,9 +1529,6 @@ static int query(struct caniot_controller *ctrl,
 			pendq_queue(ctrl, pq, timeout);
 		}
 
-		/* tells that a query is pending for the device */
-		mark_query_pending_for(ctrl, did, true);
-
 		ret = pq->handle;
 	} else {
 		ret = 0;
@@ -666,7 +1566,8 @@ int caniot_controller_query_register(struct caniot_controller *ctrl,
 	return ret;
 }
 
-bool caniot_controller_query_pending(struct caniot_controller *ctrl, uint8_t handle)
+bool caniot_controller_query_pending(struct caniot_controller *ctrl,
+				     caniot_handle_t handle)
 {
 #if CONFIG_CANIOT_CHECKS
 	if (!ctrl) return -CANIOT_EINVAL;
@@ -682,7 +1583,7 @@ bool caniot_controller_query_pending(struct caniot_controller *ctrl, uint8_t han
 }
 
 int caniot_controller_query_cancel(struct caniot_controller *ctrl,
-				   uint8_t handle,
+				   caniot_handle_t handle,
 				   bool suppress)
 {
 	int ret;
@@ -697,10 +1598,8 @@ int caniot_controller_query_cancel(struct caniot_controller *ctrl,
 		goto exit;
 	}
 
-	/* execute user callback if not suppressed */
-	if (suppress == false) {
-		cancelled_query_event(ctrl, pq, suppress);
-	}
+	/* the user callback is only executed if not suppressed */
+	cancelled_query_event(ctrl, pq, suppress);
 
 	ret = 0;
 exit:
@@ -712,6 +1611,63 @@ exit:
 	return ret;
 }
 
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+
+int caniot_controller_query_expect(struct caniot_controller *ctrl,
+				   caniot_handle_t handle,
+				   uint64_t expected)
+{
+	int ret = 0;
+
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl) return -CANIOT_EINVAL;
+#endif
+
+	struct pendq *const pq = pendq_get_by_handle(ctrl, handle);
+	if (pq == NULL) {
+		ret = -CANIOT_ENOHANDLE;
+	} else if (!pendq_is_broadcast(pq)) {
+		ret = -CANIOT_EINVAL;
+	} else {
+		/* only devices can respond */
+		pq->expected = expected & ((1llu << CANIOT_DID_BROADCAST) - 1u);
+	}
+
+	__DBG("caniot_controller_query_expect(handle: %u) -> ret: %d\n", handle, ret);
+
+	return ret;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+
+int caniot_controller_query_aggregate(struct caniot_controller *ctrl,
+				      caniot_handle_t handle,
+				      struct caniot_frame *results)
+{
+	int ret = 0;
+
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl || !results) return -CANIOT_EINVAL;
+#endif
+
+	struct pendq *const pq = pendq_get_by_handle(ctrl, handle);
+	if (pq == NULL) {
+		ret = -CANIOT_ENOHANDLE;
+	} else if (!pendq_is_broadcast(pq)) {
+		ret = -CANIOT_EINVAL;
+	} else {
+		pq->aggregate = results;
+	}
+
+	__DBG("caniot_controller_query_aggregate(handle: %u) -> ret: %d\n", handle, ret);
+
+	return ret;
+}
+
+#endif
+
 static bool
 is_response_to(const struct caniot_frame *frame, struct pendq *pq, bool *p_is_error)
 {
@@ -773,118 +1729,820 @@ static void pendq_handle_device_resp(struct caniot_controller *ctrl,
 		.status	    = is_error ? CANIOT_CONTROLLER_EVENT_STATUS_ERROR
 				       : CANIOT_CONTROLLER_EVENT_STATUS_OK,
 
-		.did = CANIOT_DID(response->id.cls, response->id.sid),
+		.did = CANIOT_DID(response->id.cls, response->id.sid),
+
+		.terminated = true,
+		.handle	    = pq->handle,
+
+		.response  = response,
+		.user_data = pq->user_data,
+	};
+
+#if CONFIG_CANIOT_CTRL_RTT || CONFIG_CANIOT_CTRL_METRICS
+	const uint32_t rtt_ms = ctrl->clock_ms - pq->sent_ms;
+#endif
+
+#if CONFIG_CANIOT_CTRL_RTT
+	if (pq->rtt_sample) rtt_update(ctrl, ev.did, rtt_ms);
+#endif
+
+#if CONFIG_CANIOT_CTRL_METRICS
+	metrics_begin(ctrl);
+	metrics_add(is_error ? &ctrl->metrics.data.error : &ctrl->metrics.data.ok);
+	if (pq->rtt_sample) metrics_add(metrics_rtt_bucket(ctrl, ev.did, rtt_ms));
+	metrics_end(ctrl);
+#endif
+
+#if CONFIG_CANIOT_CTRL_BULK
+	struct caniot_ctrl_bulk *const bulk = pq->bulk;
+	const uint16_t bulk_index	    = pq->bulk_index;
+#endif
+
+	/* Release context before callback call in case the use wants to
+	 * perform operations on a pq which will no longer live
+	 */
+	pendq_remove(ctrl, pq);
+
+#if CONFIG_CANIOT_CTRL_BULK
+	if (bulk != NULL) {
+		bulk_query_done(ctrl, bulk, bulk_index, &ev);
+		return;
+	}
+#endif
+
+	/* Ignore user callback return value in case of a response to a
+	 * non-broadcast query because the pq context has already been
+	 * released */
+	(void)call_user_callback(ctrl, &ev);
+}
+
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+
+/* Release a broadcast query all expected devices responded to, with a
+ * terminating event (without response) */
+static void pendq_complete(struct caniot_controller *ctrl, struct pendq *pq)
+{
+	const caniot_controller_event_t done = {
+		.controller = ctrl,
+		.context    = CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY,
+		.status	    = CANIOT_CONTROLLER_EVENT_STATUS_OK,
+
+		.did = pq->did,
+
+		.terminated = 1U,
+		.handle	    = pq->handle,
+
+		.response = NULL,
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+		.responders = pq->notified,
+#endif
+		.user_data = pq->user_data,
+	};
+
+	pendq_remove(ctrl, pq);
+
+	(void)call_user_callback(ctrl, &done);
+}
+
+#endif
+
+static void pendq_handle_broadcast_resp(struct caniot_controller *ctrl,
+					struct pendq *pq,
+					const struct caniot_frame *response,
+					bool is_error)
+{
+	const caniot_did_t did = CANIOT_DID(response->id.cls, response->id.sid);
+
+	/* Make sure not more than one broadcast response is received
+	 * per device */
+	if (pq->notified & (1llu << did)) {
+		/* Already notified for this device, ignore ... */
+		__DBG("broacast pq, device %u already notified\n", did);
+		return;
+	} else {
+		__DBG("broacast pq, device %u not notified yet\n", did);
+		pq->notified |= (1llu << did);
+	}
+
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+	/* All expected devices responded, no need to wait for the timeout */
+	const bool complete =
+		(pq->expected != 0llu) && ((pq->notified & pq->expected) == pq->expected);
+#else
+	const bool complete = false;
+#endif
+
+	const caniot_controller_event_t ev = {
+		.controller = ctrl,
+		.context    = CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY,
+		.status	    = is_error ? CANIOT_CONTROLLER_EVENT_STATUS_ERROR
+				       : CANIOT_CONTROLLER_EVENT_STATUS_OK,
+
+		.did = did,
+
+		.terminated = complete,
+		.handle	    = pq->handle,
+
+		.response = response,
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+		.responders = complete ? pq->notified : 0llu,
+#endif
+		.user_data = pq->user_data,
+	};
+
+	if (is_error) {
+		METRICS_INC(ctrl, error);
+	} else {
+		METRICS_INC(ctrl, ok);
+	}
+
+	/* If discovery is enabled, call the discovery callback and
+	 * terminate discovery if the callback returns false
+	 */
+	if (pendq_is_discovery(ctrl, pq) == true) {
+#if CONFIG_CANIOT_CONTROLLER_DISCOVERY
+		if (!is_error || ctrl->discovery.params.admit_errors == true) {
+			bool continue_discovery = ctrl->discovery.params.user_callback(
+				ctrl,
+				ev.did,
+				ev.response,
+				ctrl->discovery.params.user_data);
+			if (continue_discovery == false) {
+				stop_discovery(ctrl);
+			}
+		}
+
+		/* If a discovery is running, call the user callback,
+		 * but consider the response as an orphan response, as
+		 * a discovery initiated the query */
+		orphan_resp_event(ctrl, response);
+
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+		/* terminate the query as on timeout, but with status OK */
+		if (complete) {
+			stop_discovery(ctrl);
+			pendq_complete(ctrl, pq);
+		}
+#endif
+#endif
+	} else
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+	if (pq->aggregate != NULL) {
+		pq->aggregate[did] = *response;
+
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+		if (complete) pendq_complete(ctrl, pq);
+#endif
+	} else
+#endif
+	{
+		/* call pq user callback and release pq context if the callback
+		 * returns false or if the query is complete */
+		bool release_pq = (call_user_callback(ctrl, &ev) == false) || complete;
+
+		if (release_pq) {
+			pendq_remove(ctrl, pq);
+		}
+	}
+}
+
+/**
+ * @brief Pass frame to pending query
+ *
+ * @param ctrl
+ * @param pq
+ * @param frame
+ * @return true If frame can actually be handled by the pending query
+ * @return false Otherwise
+ */
+static bool pendq_handle_frame(struct caniot_controller *ctrl,
+			       struct pendq *pq,
+			       const struct caniot_frame *response)
+{
+	ASSERT(pq != NULL);
+	ASSERT(response != NULL);
+
+	bool is_error;
+
+	if (!is_response_to(response, pq, &is_error)) {
+		return false;
+	} else if (pendq_is_broadcast(pq)) {
+		pendq_handle_broadcast_resp(ctrl, pq, response, is_error);
+	} else {
+		pendq_handle_device_resp(ctrl, pq, response, is_error);
+	}
+
+	return true;
+}
+
+#if CONFIG_CANIOT_CTRL_CACHE
+
+#define CACHE_ATTR_MASK	  (CONFIG_CANIOT_CTRL_CACHE_ATTRS - 1u)
+#define CACHE_ATTR_PROBES MIN(4u, CONFIG_CANIOT_CTRL_CACHE_ATTRS)
+
+static uint32_t cache_attr_hash(caniot_did_t did, uint16_t key)
+{
+	return ((uint32_t)key * 0x9E3779B1u ^ did) & CACHE_ATTR_MASK;
+}
+
+static struct caniot_ctrl_cache_attr *
+cache_attr_find(struct caniot_controller *ctrl, caniot_did_t did, uint16_t key)
+{
+	const uint32_t hash = cache_attr_hash(did, key);
+
+	for (uint32_t i = 0u; i < CACHE_ATTR_PROBES; i++) {
+		struct caniot_ctrl_cache_attr *const entry =
+			&ctrl->cache.attrs[(hash + i) & CACHE_ATTR_MASK];
+
+		if (entry->valid && (entry->did == did) && (entry->key == key)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/* Entry to store (did, key) in: the matching one, a free one or the oldest one */
+static struct caniot_ctrl_cache_attr *
+cache_attr_slot(struct caniot_controller *ctrl, caniot_did_t did, uint16_t key)
+{
+	struct caniot_ctrl_cache_attr *oldest = cache_attr_find(ctrl, did, key);
+	const uint32_t hash		      = cache_attr_hash(did, key);
+
+	if (oldest != NULL) return oldest;
+
+	for (uint32_t i = 0u; i < CACHE_ATTR_PROBES; i++) {
+		struct caniot_ctrl_cache_attr *const entry =
+			&ctrl->cache.attrs[(hash + i) & CACHE_ATTR_MASK];
+
+		if (!entry->valid) return entry;
+
+		const uint32_t age = ctrl->clock_ms - entry->time_ms;
+		if ((oldest == NULL) || (age > (ctrl->clock_ms - oldest->time_ms))) {
+			oldest = entry;
+		}
+	}
+
+	return oldest;
+}
+
+/* Store the values carried by any valid (non error) response */
+static void cache_update(struct caniot_controller *ctrl, const struct caniot_frame *frame)
+{
+	const caniot_did_t did = CANIOT_DID(frame->id.cls, frame->id.sid);
+
+	if ((frame->id.query != CANIOT_RESPONSE) || !caniot_deviceid_valid(did) ||
+	    (did == CANIOT_DID_BROADCAST)) {
+		return;
+	}
+
+	if (frame->id.type == CANIOT_FRAME_TYPE_TELEMETRY) {
+		struct caniot_ctrl_cache_telemetry *const entry =
+			&ctrl->cache.telemetry[did][frame->id.endpoint];
+
+		entry->time_ms = ctrl->clock_ms;
+		entry->valid   = 1u;
+		entry->len     = MIN(frame->len, 8u);
+		memcpy(entry->buf, frame->buf, entry->len);
+	} else if ((frame->id.type == CANIOT_FRAME_TYPE_READ_ATTRIBUTE) &&
+		   (frame->len >= 6u)) {
+		struct caniot_ctrl_cache_attr *const entry =
+			cache_attr_slot(ctrl, did, frame->attr.key);
+
+		entry->time_ms = ctrl->clock_ms;
+		entry->val     = frame->attr.val;
+		entry->key     = frame->attr.key;
+		entry->did     = did;
+		entry->valid   = 1u;
+	}
+}
+
+int caniot_controller_cache_lookup(struct caniot_controller *ctrl,
+				   caniot_did_t did,
+				   const struct caniot_frame *query,
+				   uint32_t max_age_ms,
+				   struct caniot_frame *response)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl || !query || !response) return -CANIOT_EINVAL;
+#endif
+
+	if (!caniot_deviceid_valid(did) || (did == CANIOT_DID_BROADCAST)) {
+		return -CANIOT_ENOTSUP;
+	}
+
+	caniot_clear_frame(response);
+	response->id.query = CANIOT_RESPONSE;
+	response->id.cls   = CANIOT_DID_CLS(did);
+	response->id.sid   = CANIOT_DID_SID(did);
+	response->id.type  = query->id.type;
+
+	if (query->id.type == CANIOT_FRAME_TYPE_TELEMETRY) {
+		const struct caniot_ctrl_cache_telemetry *const entry =
+			&ctrl->cache.telemetry[did][query->id.endpoint];
+
+		if (!entry->valid || ((ctrl->clock_ms - entry->time_ms) > max_age_ms)) {
+			return -CANIOT_ENOATTR;
+		}
+
+		response->id.endpoint = query->id.endpoint;
+		response->len	      = entry->len;
+		memcpy(response->buf, entry->buf, entry->len);
+	} else if (query->id.type == CANIOT_FRAME_TYPE_READ_ATTRIBUTE) {
+		const struct caniot_ctrl_cache_attr *const entry =
+			cache_attr_find(ctrl, did, query->attr.key);
+
+		if ((entry == NULL) || ((ctrl->clock_ms - entry->time_ms) > max_age_ms)) {
+			return -CANIOT_ENOATTR;
+		}
+
+		response->len	   = 6u;
+		response->attr.key = entry->key;
+		response->attr.val = entry->val;
+	} else {
+		return -CANIOT_ENOTSUP;
+	}
+
+	return 0;
+}
+
+int caniot_controller_query_cached(struct caniot_controller *ctrl,
+				   caniot_did_t did,
+				   struct caniot_frame *frame,
+				   uint32_t timeout,
+				   uint32_t max_age_ms,
+				   void *user_data)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl || !frame) return -CANIOT_EINVAL;
+#endif
+
+	struct caniot_frame response;
+
+	if (caniot_controller_cache_lookup(ctrl, did, frame, max_age_ms, &response) != 0) {
+		const int ret = caniot_controller_query(ctrl, did, frame, timeout);
+		if (ret > 0) {
+			caniot_controller_query_user_data_set(ctrl, ret, user_data);
+		}
+
+		return ret;
+	}
+
+	const caniot_controller_event_t ev = {
+		.controller = ctrl,
+		.context    = CANIOT_CONTROLLER_EVENT_CONTEXT_CACHE,
+		.status	    = CANIOT_CONTROLLER_EVENT_STATUS_OK,
+		.did	    = did,
+		.terminated = 1u,
+		.handle	    = 0u,
+		.response   = &response,
+		.user_data  = user_data,
+	};
+
+	(void)call_user_callback(ctrl, &ev);
+
+	return 0;
+}
+
+void caniot_controller_cache_invalidate(struct caniot_controller *ctrl, caniot_did_t did)
+{
+	ASSERT(ctrl != NULL);
+
+	for (caniot_did_t d = 0u; d < CANIOT_DID_MAX_COUNT; d++) {
+		if ((did != CANIOT_DID_BROADCAST) && (d != did)) continue;
+
+		for (uint8_t ep = 0u; ep <= CANIOT_ENDPOINT_BOARD_CONTROL; ep++) {
+			ctrl->cache.telemetry[d][ep].valid = 0u;
+		}
+	}
+
+	for (uint32_t i = 0u; i < CONFIG_CANIOT_CTRL_CACHE_ATTRS; i++) {
+		if ((did == CANIOT_DID_BROADCAST) || (ctrl->cache.attrs[i].did == did)) {
+			ctrl->cache.attrs[i].valid = 0u;
+		}
+	}
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_SHADOW
+
+static void shadow_update(struct caniot_controller *ctrl,
+			  const struct caniot_frame *frame)
+{
+	const caniot_did_t did = CANIOT_DID(frame->id.cls, frame->id.sid);
+
+	if ((frame->id.query != CANIOT_RESPONSE) ||
+	    (frame->id.type != CANIOT_FRAME_TYPE_READ_ATTRIBUTE) || (frame->len < 6u) ||
+	    !caniot_deviceid_valid(did) || (did == CANIOT_DID_BROADCAST)) {
+		return;
+	}
+
+	struct caniot_ctrl_shadow *const shadow = ctrl->shadows[did];
+	const uint16_t key			= frame->attr.key;
+
+	if (shadow == NULL) return;
+
+	if (caniot_config_attr_set(&shadow->config, key, frame->attr.val) == 0) {
+		shadow->known |= 1llu << CANIOT_ATTR_KEY_ATTR(key);
+	}
+}
+
+int caniot_controller_shadow_attach(struct caniot_controller *ctrl,
+				    caniot_did_t did,
+				    struct caniot_ctrl_shadow *shadow)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl) return -CANIOT_EINVAL;
+#endif
+
+	if (!caniot_deviceid_valid(did) || (did == CANIOT_DID_BROADCAST)) {
+		return -CANIOT_EINVAL;
+	}
+
+	if ((ctrl->shadows[did] != NULL) && ctrl->shadows[did]->bulk.running) {
+		return -CANIOT_EBUSY;
+	}
+
+	if (shadow != NULL) {
+		shadow->known	     = 0llu;
+		shadow->bulk.running = false;
+	}
+
+	ctrl->shadows[did] = shadow;
+
+	return 0;
+}
+
+int caniot_controller_shadow_sync(struct caniot_controller *ctrl,
+				  caniot_did_t did,
+				  const struct caniot_device_config *config,
+				  uint8_t window,
+				  uint32_t timeout,
+				  caniot_controller_bulk_cb_t cb,
+				  void *user_data)
+{
+	uint16_t keys[CANIOT_CONFIG_ATTR_COUNT];
+	int ret;
+
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl || !config || !cb) return -CANIOT_EINVAL;
+#endif
+
+	if (!caniot_deviceid_valid(did) || (did == CANIOT_DID_BROADCAST)) {
+		return -CANIOT_EINVAL;
+	}
+
+	struct caniot_ctrl_shadow *const shadow = ctrl->shadows[did];
+	if (shadow == NULL) return -CANIOT_EINVAL;
+	if (shadow->bulk.running) return -CANIOT_EBUSY;
+
+	ret = caniot_config_diff(&shadow->config,
+				 shadow->known,
+				 config,
+				 CANIOT_DID_CLS(did),
+				 keys,
+				 ARRAY_SIZE(keys));
+	if (ret <= 0) goto exit;
+
+	for (int i = 0; i < ret; i++) {
+		shadow->attrs[i].key	= keys[i];
+		shadow->attrs[i].status = 0;
+		(void)caniot_config_attr_get(config, keys[i], &shadow->attrs[i].val);
+	}
+
+	shadow->bulk.did       = did;
+	shadow->bulk.write     = true;
+	shadow->bulk.window    = window;
+	shadow->bulk.timeout   = timeout;
+	shadow->bulk.attrs     = shadow->attrs;
+	shadow->bulk.count     = (uint16_t)ret;
+	shadow->bulk.cb	       = cb;
+	shadow->bulk.user_data = user_data;
+
+	const int err = caniot_controller_bulk_start(ctrl, &shadow->bulk);
+	if (err < 0) ret = err;
+
+exit:
+	__DBG("caniot_controller_shadow_sync(did: %u) -> ret: %d\n", did, ret);
+
+	return ret;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_REGISTRY
+
+static void registry_update(struct caniot_controller *ctrl,
+			    const struct caniot_frame *frame)
+{
+	const caniot_did_t did = CANIOT_DID(frame->id.cls, frame->id.sid);
+
+	if (!caniot_deviceid_valid(did) || (did == CANIOT_DID_BROADCAST)) return;
+
+	struct caniot_ctrl_registry_entry *const entry = &ctrl->registry.devices[did];
+
+	entry->last_seen_ms = ctrl->clock_ms;
+	entry->endpoint	    = frame->id.endpoint;
+	entry->type	    = frame->id.type;
+
+	ctrl->registry.present |= 1llu << did;
+}
+
+static bool registry_alive(const struct caniot_controller *ctrl,
+			   caniot_did_t did,
+			   uint32_t max_age_ms)
+{
+	return (max_age_ms == CANIOT_TIMEOUT_FOREVER) ||
+	       ((ctrl->clock_ms - ctrl->registry.devices[did].last_seen_ms) <= max_age_ms);
+}
+
+uint64_t caniot_controller_registry_alive(const struct caniot_controller *ctrl,
+					  uint32_t max_age_ms)
+{
+	ASSERT(ctrl != NULL);
+
+	uint64_t alive = 0llu;
+	uint64_t rem   = ctrl->registry.present;
+
+	while (rem != 0llu) {
+		const caniot_did_t did = (caniot_did_t)__builtin_ctzll(rem);
+		rem &= rem - 1u;
+
+		if (registry_alive(ctrl, did, max_age_ms)) alive |= 1llu << did;
+	}
+
+	return alive;
+}
+
+int caniot_controller_registry_get(const struct caniot_controller *ctrl,
+				   caniot_did_t did,
+				   struct caniot_ctrl_device_info *info)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl || !info) return -CANIOT_EINVAL;
+#endif
+
+	if (!caniot_deviceid_valid(did) || (did == CANIOT_DID_BROADCAST) ||
+	    !(ctrl->registry.present & (1llu << did))) {
+		return -CANIOT_EDEVICE;
+	}
+
+	const struct caniot_ctrl_registry_entry *const entry =
+		&ctrl->registry.devices[did];
+
+	info->did      = did;
+	info->cls      = CANIOT_DID_CLS(did);
+	info->sid      = CANIOT_DID_SID(did);
+	info->age_ms   = ctrl->clock_ms - entry->last_seen_ms;
+	info->endpoint = entry->endpoint;
+	info->type     = entry->type;
+
+	return 0;
+}
+
+int caniot_controller_registry_iterate(struct caniot_controller *ctrl,
+				       uint32_t max_age_ms,
+				       caniot_controller_registry_cb_t cb,
+				       void *user_data)
+{
+	struct caniot_ctrl_device_info info;
+	int count = 0;
+
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl || !cb) return -CANIOT_EINVAL;
+#endif
+
+	uint64_t rem = caniot_controller_registry_alive(ctrl, max_age_ms);
+
+	while (rem != 0llu) {
+		const caniot_did_t did = (caniot_did_t)__builtin_ctzll(rem);
+		rem &= rem - 1u;
+
+		/* the callback may forget devices */
+		if (caniot_controller_registry_get(ctrl, did, &info) != 0) continue;
+
+		count++;
+		if (!cb(ctrl, &info, user_data)) break;
+	}
+
+	return count;
+}
+
+void caniot_controller_registry_forget(struct caniot_controller *ctrl, caniot_did_t did)
+{
+	ASSERT(ctrl != NULL);
+
+	if (did == CANIOT_DID_BROADCAST) {
+		ctrl->registry.present = 0llu;
+	} else if (caniot_deviceid_valid(did)) {
+		ctrl->registry.present &= ~(1llu << did);
+	}
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_SCHED
+
+int caniot_controller_sched_config(struct caniot_controller *ctrl,
+				   uint32_t bitrate,
+				   uint8_t load_percent)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl) return -CANIOT_EINVAL;
+#endif
+
+	if ((bitrate == 0u) || (load_percent == 0u) || (load_percent > 100u)) {
+		return -CANIOT_EINVAL;
+	}
+
+	struct caniot_ctrl_sched *const sched = &ctrl->sched;
+
+	sched_credit(ctrl);
+
+	sched->bitrate	    = bitrate;
+	sched->load_percent = load_percent;
+	sched->credits	    = MIN(sched->credits, sched_capacity(sched));
+
+	return 0;
+}
+
+/* Phase of the n-th job of a period, following the van der Corput sequence
+ * (0, 1/2, 1/4, 3/4, 1/8, ...) so that jobs are evenly spread whatever their
+ * count */
+static uint32_t sched_phase(uint32_t period_ms, uint32_t n)
+{
+	uint64_t num = 0u;
+	uint64_t den = 1u;
+
+	for (; n != 0u; n >>= 1u) {
+		num = (num << 1u) | (n & 1u);
+		den <<= 1u;
+	}
+
+	return (uint32_t)((period_ms * num) / den);
+}
+
+int caniot_controller_sched_add(struct caniot_controller *ctrl,
+				caniot_did_t did,
+				const struct caniot_frame *frame,
+				uint32_t period_ms,
+				uint32_t timeout_ms,
+				uint8_t priority)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl || !frame) return -CANIOT_EINVAL;
+#endif
+
+	if (!caniot_deviceid_valid(did) || (did == CANIOT_DID_BROADCAST) ||
+	    (period_ms == 0u) || (timeout_ms == 0u)) {
+		return -CANIOT_EINVAL;
+	}
+
+	struct caniot_ctrl_sched *const sched = &ctrl->sched;
+	struct caniot_ctrl_sched_job *job     = NULL;
+	uint32_t same_period		      = 0u;
+
+	for (uint32_t i = 0u; i < ARRAY_SIZE(sched->jobs); i++) {
+		if (!sched->jobs[i].active) {
+			if (job == NULL) job = &sched->jobs[i];
+		} else if (sched->jobs[i].period_ms == period_ms) {
+			same_period++;
+		}
+	}
+
+	if (job == NULL) return -CANIOT_EAGAIN;
+
+	job->active	= true;
+	job->did	= did;
+	job->priority	= priority;
+	job->frame	= *frame;
+	job->period_ms	= period_ms;
+	job->timeout_ms = timeout_ms;
+	job->due_ms	= ctrl->clock_ms + sched_phase(period_ms, same_period);
+	job->runs	= 0u;
+	job->missed	= 0u;
+
+	return (int)(job - sched->jobs);
+}
+
+int caniot_controller_sched_remove(struct caniot_controller *ctrl, int job)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl) return -CANIOT_EINVAL;
+#endif
+
+	if ((job < 0) || (job >= (int)ARRAY_SIZE(ctrl->sched.jobs)) ||
+	    !ctrl->sched.jobs[job].active) {
+		return -CANIOT_EINVAL;
+	}
+
+	ctrl->sched.jobs[job].active = false;
 
-		.terminated = true,
-		.handle	    = pq->handle,
+	return 0;
+}
 
-		.response  = response,
-		.user_data = pq->user_data,
-	};
+/* Time in ms until the budget covers "cost" bits */
+static uint32_t sched_credit_wait(const struct caniot_controller *ctrl, int32_t cost)
+{
+	const struct caniot_ctrl_sched *const sched = &ctrl->sched;
+	const uint64_t rate = (uint64_t)sched->bitrate * sched->load_percent;
+	const uint64_t acc =
+		(uint64_t)(ctrl->clock_ms - sched->credit_ms) * rate + sched->credit_rem;
+	const int64_t deficit =
+		(int64_t)cost - sched->credits - (int64_t)(acc / SCHED_RATE_DIV);
 
-	/* Release context before callback call in case the use wants to
-	 * perform operations on a pq which will no longer live
-	 */
-	pendq_remove(ctrl, pq);
+	if (deficit <= 0) return 0u;
 
-	/* Ignore user callback return value in case of a response to a
-	 * non-broadcast query because the pq context has already been
-	 * released */
-	(void)call_user_callback(ctrl, &ev);
+	return (uint32_t)(((uint64_t)deficit * SCHED_RATE_DIV + rate - 1u) / rate);
 }
 
-static void pendq_handle_broadcast_resp(struct caniot_controller *ctrl,
-					struct pendq *pq,
-					const struct caniot_frame *response,
-					bool is_error)
+uint32_t caniot_controller_sched_next_deadline(const struct caniot_controller *ctrl)
 {
-	const caniot_controller_event_t ev = {
-		.controller = ctrl,
-		.context    = CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY,
-		.status	    = is_error ? CANIOT_CONTROLLER_EVENT_STATUS_ERROR
-				       : CANIOT_CONTROLLER_EVENT_STATUS_OK,
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl) return CANIOT_TIMEOUT_FOREVER;
+#endif
 
-		.did = CANIOT_DID(response->id.cls, response->id.sid),
+	uint32_t next = CANIOT_TIMEOUT_FOREVER;
 
-		.terminated = false,
-		.handle	    = pq->handle,
+	for (uint32_t i = 0u; i < ARRAY_SIZE(ctrl->sched.jobs); i++) {
+		const struct caniot_ctrl_sched_job *const job = &ctrl->sched.jobs[i];
+		if (!job->active) continue;
 
-		.response  = response,
-		.user_data = pq->user_data,
-	};
+		const int32_t due	  = (int32_t)(job->due_ms - ctrl->clock_ms);
+		const uint32_t credit = sched_credit_wait(ctrl, SCHED_JOB_COST(job));
 
-	/* Make sure not more than one broadcast response is received
-	 * per device */
-	if (pq->notified & (1U << ev.did)) {
-		/* Already notified for this device, ignore ... */
-		__DBG("broacast pq, device %u already notified\n", ev.did);
-		return;
-	} else {
-		__DBG("broacast pq, device %u not notified yet\n", ev.did);
-		pq->notified |= (1U << ev.did);
+		next = MIN(next, MAX((uint32_t)MAX(due, 0), credit));
 	}
 
-	/* If discovery is enabled, call the discovery callback and
-	 * terminate discovery if the callback returns false
-	 */
-	if (pendq_is_discovery(ctrl, pq) == true) {
-#if CONFIG_CANIOT_CONTROLLER_DISCOVERY
-		if (!is_error || ctrl->discovery.params.admit_errors == true) {
-			bool continue_discovery = ctrl->discovery.params.user_callback(
-				ctrl,
-				ev.did,
-				ev.response,
-				ctrl->discovery.params.user_data);
-			if (continue_discovery == false) {
-				stop_discovery(ctrl);
-			}
-		}
+	return next;
+}
 
-		/* If a discovery is running, call the user callback,
-		 * but consider the response as an orphan response, as
-		 * a discovery initiated the query */
-		orphan_resp_event(ctrl, response);
-#endif
-	} else {
-		/* call pq user callback and release pq context if the callback
-		 * returns false */
-		bool release_pq = call_user_callback(ctrl, &ev) == false;
+/* Due job with the highest priority, the earliest due first */
+static struct caniot_ctrl_sched_job *sched_pick(struct caniot_controller *ctrl)
+{
+	struct caniot_ctrl_sched_job *best = NULL;
 
-		if (release_pq) {
-			pendq_remove(ctrl, pq);
+	for (uint32_t i = 0u; i < ARRAY_SIZE(ctrl->sched.jobs); i++) {
+		struct caniot_ctrl_sched_job *const job = &ctrl->sched.jobs[i];
+
+		if (!job->active) continue;
+		if ((int32_t)(job->due_ms - ctrl->clock_ms) > 0) continue;
+
+		if ((best == NULL) || (job->priority < best->priority) ||
+		    ((job->priority == best->priority) &&
+		     ((int32_t)(job->due_ms - best->due_ms) < 0))) {
+			best = job;
 		}
 	}
+
+	return best;
 }
 
-/**
- * @brief Pass frame to pending query
- *
- * @param ctrl
- * @param pq
- * @param frame
- * @return true If frame can actually be handled by the pending query
- * @return false Otherwise
- */
-static bool pendq_handle_frame(struct caniot_controller *ctrl,
-			       struct pendq *pq,
-			       const struct caniot_frame *response)
+static void sched_run(struct caniot_controller *ctrl)
 {
-	ASSERT(pq != NULL);
-	ASSERT(response != NULL);
+	struct caniot_ctrl_sched *const sched = &ctrl->sched;
+	struct caniot_ctrl_sched_job *job;
 
-	bool is_error;
+	sched_credit(ctrl);
 
-	if (!is_response_to(response, pq, &is_error)) {
-		return false;
-	} else if (pendq_is_broadcast(pq)) {
-		pendq_handle_broadcast_resp(ctrl, pq, response, is_error);
-	} else {
-		pendq_handle_device_resp(ctrl, pq, response, is_error);
-	}
+	/* jobs are sent at most once per call */
+	for (uint32_t i = 0u; i < ARRAY_SIZE(sched->jobs); i++) {
+		job = sched_pick(ctrl);
+		if (job == NULL) break;
 
-	return true;
+		/* lower priority jobs wait too */
+		if (sched->credits < SCHED_JOB_COST(job)) break;
+
+		struct caniot_frame frame = job->frame;
+		const int ret =
+			caniot_controller_query(ctrl, job->did, &frame, job->timeout_ms);
+		if (ret < 0) {
+			job->missed++;
+		} else {
+			job->runs++;
+		}
+
+		/* keep the phase of the job, periods already over are skipped */
+		job->due_ms += job->period_ms;
+
+		const int32_t late = (int32_t)(ctrl->clock_ms - job->due_ms);
+		if (late >= 0) {
+			const uint32_t skipped = (uint32_t)late / job->period_ms + 1u;
+
+			job->missed += skipped;
+			job->due_ms += skipped * job->period_ms;
+		}
+
+		__DBG("sched_run(did: %u) -> ret: %d, credits: %d\n",
+		      job->did,
+		      ret,
+		      sched->credits);
+	}
 }
 
+#endif
+
 static int caniot_controller_handle_rx_frame(struct caniot_controller *ctrl,
 					     const struct caniot_frame *frame)
 {
@@ -897,17 +2555,45 @@ static int caniot_controller_handle_rx_frame(struct caniot_controller *ctrl,
 	bool orphan	       = true;
 	const caniot_did_t did = CANIOT_DID(frame->id.cls, frame->id.sid);
 
+	SCHED_CHARGE(ctrl, frame);
+	BUSLOAD_FEED(ctrl, frame);
+
+#if CONFIG_CANIOT_CTRL_REGISTRY
+	registry_update(ctrl, frame);
+#endif
+
+#if CONFIG_CANIOT_CTRL_CACHE
+	cache_update(ctrl, frame);
+#endif
+
+#if CONFIG_CANIOT_CTRL_SHADOW
+	shadow_update(ctrl, frame);
+#endif
+
 	/* If a query is pending and the frame is the response for it
 	 * Call callback and clear pending query */
 
 	/* Try pass frame to query pending for this DID */
-	pq = peek_pending_query(ctrl, did);
+#if CONFIG_CANIOT_CTRL_COALESCE
+	/* Queries coalesced onto the query take its place in the queue of the device
+	 * one after the other when it is released, pass the frame to all of them */
+	ctrl->pendingq.fanout = true;
+	while ((pq = peek_pending_query(ctrl, did, frame)) != NULL) {
+		const bool last = pq->coalesced == NULL;
+
+		orphan &= !pendq_handle_frame(ctrl, pq, frame);
+		if (last) break;
+	}
+	ctrl->pendingq.fanout = false;
+#else
+	pq = peek_pending_query(ctrl, did, frame);
 	if (pq != NULL) {
 		orphan &= !pendq_handle_frame(ctrl, pq, frame);
 	}
+#endif
 
 	/* Try pass frame to query pending for broadcast */
-	pq = peek_pending_query(ctrl, CANIOT_DID_BROADCAST);
+	pq = peek_pending_query(ctrl, CANIOT_DID_BROADCAST, frame);
 	if (pq != NULL) {
 		orphan &= !pendq_handle_frame(ctrl, pq, frame);
 	}
@@ -920,6 +2606,15 @@ static int caniot_controller_handle_rx_frame(struct caniot_controller *ctrl,
 	return 0;
 }
 
+static void controller_age(struct caniot_controller *ctrl, uint32_t time_passed_ms)
+{
+	/* update timeouts */
+	pendq_shift(ctrl, time_passed_ms);
+
+	/* call callbacks for expired queries */
+	pendq_call_expired(ctrl);
+}
+
 int caniot_controller_rx_frame(struct caniot_controller *ctrl,
 			       uint32_t time_passed_ms,
 			       const struct caniot_frame *frame)
@@ -928,6 +2623,8 @@ int caniot_controller_rx_frame(struct caniot_controller *ctrl,
 	if (!ctrl) return -CANIOT_EINVAL;
 #endif
 
+	ctrl->clock_ms += time_passed_ms;
+
 	if (frame != NULL) {
 		int ret;
 		if ((ret = caniot_controller_handle_rx_frame(ctrl, frame)) < 0) {
@@ -935,11 +2632,7 @@ int caniot_controller_rx_frame(struct caniot_controller *ctrl,
 		}
 	}
 
-	/* update timeouts */
-	pendq_shift(ctrl, time_passed_ms);
-
-	/* call callbacks for expired queries */
-	pendq_call_expired(ctrl);
+	controller_age(ctrl, time_passed_ms);
 
 	__DBG("caniot_controller_rx_frame(time_passed_ms: %u, frame: %p) -> ret: 0\n",
 	      time_passed_ms,
@@ -948,16 +2641,53 @@ int caniot_controller_rx_frame(struct caniot_controller *ctrl,
 	return 0U;
 }
 
+int caniot_controller_rx_frames(struct caniot_controller *ctrl,
+				uint32_t time_passed_ms,
+				const struct caniot_frame *frames,
+				size_t count)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl || (!frames && count)) return -CANIOT_EINVAL;
+#endif
+
+	int handled = 0;
+
+	ctrl->clock_ms += time_passed_ms;
+
+	for (size_t i = 0u; i < count; i++) {
+		/* frames which are not for the controller are skipped */
+		if (!caniot_controller_is_target(&frames[i])) continue;
+
+		if (caniot_controller_handle_rx_frame(ctrl, &frames[i]) == 0) {
+			handled++;
+		}
+	}
+
+	controller_age(ctrl, time_passed_ms);
+
+	__DBG("caniot_controller_rx_frames(time_passed_ms: %u, count: %u) -> ret: %d\n",
+	      time_passed_ms,
+	      (uint32_t)count,
+	      handled);
+
+	return handled;
+}
+
 int caniot_controller_deinit(struct caniot_controller *ctrl)
 {
 #if CONFIG_CANIOT_CHECKS
 	if (!ctrl) return -CANIOT_EINVAL;
 #endif
 
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+	/* Queries submitted but not performed yet are cancelled */
+	submit_ring_drain(ctrl, true);
+#endif
+
 	/* Iterate over all pending queries and cancel them */
 	struct pendq *pq;
 
-	while ((pq = pendq_pop(&ctrl->pendingq.timeout_queue)) != NULL) {
+	while ((pq = pendq_pop(ctrl)) != NULL) {
 		cancelled_query_event(ctrl, pq, true);
 	}
 
@@ -998,6 +2728,214 @@ int caniot_controller_query(struct caniot_controller *ctrl,
 	return ret;
 }
 
+#if CONFIG_CANIOT_CTRL_RETRY
+
+int caniot_controller_query_retry(struct caniot_controller *ctrl,
+				  caniot_did_t did,
+				  struct caniot_frame *frame,
+				  uint32_t timeout,
+				  const struct caniot_retry_policy *policy)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl || !frame || !policy) return -CANIOT_EINVAL;
+#endif
+
+#if CONFIG_CANIOT_CTRL_RTT
+	if (timeout == CANIOT_TIMEOUT_ADAPTIVE) {
+		timeout = caniot_controller_rtt_timeout(ctrl, did);
+	}
+#endif
+
+	if ((timeout == 0u) || (timeout == CANIOT_TIMEOUT_FOREVER) ||
+	    caniot_is_broadcast(did)) {
+		return -CANIOT_EINVAL;
+	}
+
+	const int ret = caniot_controller_query(ctrl, did, frame, timeout);
+	if (ret > 0) {
+		struct pendq *const pq = pendq_get_by_handle(ctrl, (caniot_handle_t)ret);
+		ASSERT(pq != NULL);
+
+		/* frame has been finalized by the query */
+		pq->retry.frame	     = *frame;
+		pq->retry.policy     = *policy;
+		pq->retry.timeout    = timeout;
+		pq->retry.backoff_ms = policy->backoff_ms;
+	}
+
+	__DBG("caniot_controller_query_retry(did: %u, frame: %p, timeout: %u, attempts: "
+	      "%u) -> ret (handle): %d\n",
+	      did,
+	      (void *)frame,
+	      timeout,
+	      policy->max_attempts,
+	      ret);
+
+	return ret;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_BULK
+
+int caniot_controller_bulk_start(struct caniot_controller *ctrl,
+				 struct caniot_ctrl_bulk *bulk)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl || !bulk || !bulk->cb) return -CANIOT_EINVAL;
+	if (!bulk->attrs && bulk->count) return -CANIOT_EINVAL;
+#endif
+
+	if ((bulk->window == 0u) || (bulk->timeout == 0u) ||
+	    (bulk->timeout == CANIOT_TIMEOUT_FOREVER) ||
+	    !caniot_deviceid_valid(bulk->did) || caniot_is_broadcast(bulk->did)) {
+		return -CANIOT_EINVAL;
+	}
+
+	if (bulk->running) return -CANIOT_EBUSY;
+
+	bulk->next    = 0u;
+	bulk->pending = 0u;
+	bulk->failed  = 0u;
+	bulk->running = true;
+
+	__DBG("caniot_controller_bulk_start(did: %u, count: %u, window: %u, write: %u)\n",
+	      bulk->did,
+	      bulk->count,
+	      bulk->window,
+	      (uint32_t)bulk->write);
+
+	bulk_pump(ctrl, bulk);
+	bulk_complete(ctrl, bulk);
+
+	return 0;
+}
+
+int caniot_controller_bulk_cancel(struct caniot_controller *ctrl,
+				  struct caniot_ctrl_bulk *bulk)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl || !bulk) return -CANIOT_EINVAL;
+#endif
+
+	if (!bulk->running) return -CANIOT_ENOHANDLE;
+
+	/* attributes not queried yet */
+	while (bulk->next < bulk->count) {
+		bulk_attr_done(bulk, bulk->next++, -CANIOT_ECANCELED);
+	}
+
+	/* The callback is called with the last cancelled query, and may start
+	 * the operation again: only cancel the queries pending so far */
+	uint16_t pending = bulk->pending;
+	if (pending == 0u) bulk_complete(ctrl, bulk);
+
+	for (struct pendq *pq = ctrl->pendingq.pool;
+	     (pending != 0u) && (pq < ctrl->pendingq.pool + PENDQ_POOL_SIZE(ctrl));
+	     pq++) {
+		if ((pq->handle != INVALID_HANDLE) && (pq->bulk == bulk)) {
+			pending--;
+			cancelled_query_event(ctrl, pq, false);
+		}
+	}
+
+	return 0;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+
+int caniot_controller_submit(struct caniot_controller *ctrl,
+			     caniot_did_t did,
+			     const struct caniot_frame *frame,
+			     uint32_t timeout,
+			     caniot_controller_submit_cb_t cb,
+			     void *user_data)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!ctrl || !frame) return -CANIOT_EINVAL;
+#endif
+
+	struct caniot_submit_ring *const ring = &ctrl->submit_ring;
+	uint32_t pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+	uint32_t seq;
+
+	/* Reserve the cell at "pos" */
+	for (;;) {
+		seq = __atomic_load_n(&ring->cells[pos & SUBMIT_RING_MASK].seq,
+				      __ATOMIC_ACQUIRE);
+
+		const int32_t diff = (int32_t)(seq - pos);
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&ring->enqueue_pos,
+							&pos,
+							pos + 1u,
+							true,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (diff < 0) {
+			/* the controller thread did not release this cell yet */
+			return -CANIOT_EAGAIN;
+		} else {
+			pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+		}
+	}
+
+	struct caniot_submit_req *const req = &ring->cells[pos & SUBMIT_RING_MASK].req;
+
+	req->did       = did;
+	req->timeout   = timeout;
+	req->frame     = *frame;
+	req->cb	       = cb;
+	req->user_data = user_data;
+
+	/* Publish the cell */
+	__atomic_store_n(
+		&ring->cells[pos & SUBMIT_RING_MASK].seq, pos + 1u, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/* Perform submitted queries, at most one ring worth so that producers
+ * cannot keep the controller thread busy. If "cancel", the queries are not
+ * performed but completed with -CANIOT_ECANCELED, until the ring is empty. */
+static void submit_ring_drain(struct caniot_controller *ctrl, bool cancel)
+{
+	struct caniot_submit_ring *const ring = &ctrl->submit_ring;
+
+	for (uint32_t n = 0u; cancel || (n < CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE); n++) {
+		const uint32_t pos	       = ring->dequeue_pos;
+		const uint32_t index	       = pos & SUBMIT_RING_MASK;
+		uint32_t *const seq	       = &ring->cells[index].seq;
+		struct caniot_submit_req *req = &ring->cells[index].req;
+
+		if (__atomic_load_n(seq, __ATOMIC_ACQUIRE) != pos + 1u) break;
+
+		int ret = -CANIOT_ECANCELED;
+		if (!cancel) {
+			ret = caniot_controller_query(
+				ctrl, req->did, &req->frame, req->timeout);
+		}
+		if (ret > 0) {
+			caniot_controller_query_user_data_set(ctrl, ret, req->user_data);
+		}
+
+		if (req->cb != NULL) {
+			req->cb(ctrl, ret, req->user_data);
+		}
+
+		/* Release the cell for the next lap */
+		ring->dequeue_pos = pos + 1u;
+		__atomic_store_n(
+			seq, pos + CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE, __ATOMIC_RELEASE);
+	}
+}
+
+#endif
+
 static uint32_t process_get_diff_ms(struct caniot_controller *ctrl)
 {
 	ASSERT(ctrl != NULL);
@@ -1023,6 +2961,53 @@ int caniot_controller_process(struct caniot_controller *ctrl)
 	ASSERT(ctrl->driv->recv != NULL);
 
 	int ret;
+	int err = 0;
+
+	const uint32_t time_passed_ms = process_get_diff_ms(ctrl);
+
+	ctrl->clock_ms += time_passed_ms;
+
+#if CONFIG_CANIOT_TXQ
+	/* frames left by a full mailbox */
+	txq_flush(ctrl, -1);
+#endif
+
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+	submit_ring_drain(ctrl, false);
+#endif
+
+#if CONFIG_CANIOT_DRIVERS_BURST_SIZE
+	if (ctrl->driv->recv_burst != NULL) {
+		struct caniot_frame frames[CONFIG_CANIOT_DRIVERS_BURST_SIZE];
+
+		do {
+			ret = ctrl->driv->recv_burst(frames, ARRAY_SIZE(frames));
+			if (ret == -CANIOT_EAGAIN) {
+				break;
+			} else if (ret < 0) {
+				err = ret;
+				break;
+			}
+
+			/* frames which are not for the controller are skipped, an
+			 * error does not drop the rest of the burst */
+			for (int i = 0; i < ret; i++) {
+				const struct caniot_frame *const rx = &frames[i];
+
+				if (!caniot_controller_is_target(rx)) continue;
+
+				const int hret =
+					caniot_controller_handle_rx_frame(ctrl, rx);
+				if ((hret < 0) && (err == 0)) err = hret;
+			}
+
+			/* a partial burst means there is no more frame to read */
+		} while ((ret == (int)ARRAY_SIZE(frames)) && (err == 0));
+
+		goto age;
+	}
+#endif
+
 	struct caniot_frame frame;
 
 	while (true) {
@@ -1038,13 +3023,16 @@ int caniot_controller_process(struct caniot_controller *ctrl)
 		}
 	}
 
-	/* update timeouts */
-	pendq_shift(ctrl, process_get_diff_ms(ctrl));
+#if CONFIG_CANIOT_DRIVERS_BURST_SIZE
+age:
+#endif
+	controller_age(ctrl, time_passed_ms);
 
-	/* call callbacks for expired queries */
-	pendq_call_expired(ctrl);
+#if CONFIG_CANIOT_CTRL_SCHED
+	sched_run(ctrl);
+#endif
 
-	return 0;
+	return err;
 }
 
 #endif
@@ -1093,6 +3081,9 @@ int caniot_controller_discovery_start(struct caniot_controller *ctrl,
 			ctrl, CANIOT_DID_BROADCAST, &frame, params->timeout);
 		if (ret >= 0) {
 			ctrl->discovery.handle = ret;
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+			caniot_controller_query_expect(ctrl, ret, params->expected);
+#endif
 		} else {
 			stop_discovery(ctrl);
 			return ret;
@@ -1166,6 +3157,8 @@ const char *caniot_controller_event_context_to_str(caniot_controller_event_conte
 		return "orphan";
 	case CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY:
 		return "query";
+	case CANIOT_CONTROLLER_EVENT_CONTEXT_CACHE:
+		return "cache";
 	default:
 		return "<unknown>";
 	}
@@ -1190,6 +3183,10 @@ const char *caniot_controller_event_status_to_str(caniot_controller_event_status
 bool caniot_controller_dbg_event_cb_stub(const caniot_controller_event_t *ev,
 					 void *user_data)
 {
+	/* unused if logs are disabled */
+	(void)ev;
+	(void)user_data;
+
 	CANIOT_INF(
 		"cb stub ev: %p user: %p did: %u handle: %u ctx: %s (%u) status: %s (%u) "
 		"response: %p terminated: %u (ev pq: user: %p)\n",
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <caniot/caniot_private.h>
+#include <caniot/ctrl_evq.h>
+
+#if CONFIG_CANIOT_CTRL_EVQ
+
+#include <string.h>
+
+#define EVQ_SIZE CONFIG_CANIOT_CTRL_EVQ_SIZE
+
+int caniot_ctrl_evq_init(struct caniot_ctrl_evq *evq,
+			 caniot_ctrl_evq_policy_t policy,
+			 caniot_controller_event_cb_t cb,
+			 void *user_data)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!evq || !cb) return -CANIOT_EINVAL;
+	if (policy > CANIOT_CTRL_EVQ_BLOCK) return -CANIOT_EINVAL;
+#endif
+
+	evq->head      = 0u;
+	evq->count     = 0u;
+	evq->policy    = policy;
+	evq->closed    = false;
+	evq->cb	       = cb;
+	evq->user_data = user_data;
+	memset(&evq->stats, 0x00u, sizeof(evq->stats));
+
+	if (pthread_mutex_init(&evq->lock, NULL) != 0) {
+		return -CANIOT_EDRIVER;
+	}
+
+	if (pthread_cond_init(&evq->not_empty, NULL) != 0) {
+		pthread_mutex_destroy(&evq->lock);
+		return -CANIOT_EDRIVER;
+	}
+
+	if (pthread_cond_init(&evq->not_full, NULL) != 0) {
+		pthread_cond_destroy(&evq->not_empty);
+		pthread_mutex_destroy(&evq->lock);
+		return -CANIOT_EDRIVER;
+	}
+
+	return 0;
+}
+
+void caniot_ctrl_evq_deinit(struct caniot_ctrl_evq *evq)
+{
+	pthread_cond_destroy(&evq->not_full);
+	pthread_cond_destroy(&evq->not_empty);
+	pthread_mutex_destroy(&evq->lock);
+}
+
+bool caniot_ctrl_evq_post(const caniot_controller_event_t *ev, void *user_data)
+{
+	struct caniot_ctrl_evq *const evq = user_data;
+
+	pthread_mutex_lock(&evq->lock);
+
+	if (evq->count == EVQ_SIZE && !evq->closed) {
+		switch (evq->policy) {
+		case CANIOT_CTRL_EVQ_DROP_OLDEST:
+			evq->head = (evq->head + 1u) % EVQ_SIZE;
+			evq->count--;
+			evq->stats.dropped_oldest++;
+			break;
+		case CANIOT_CTRL_EVQ_BLOCK:
+			evq->stats.blocked++;
+			while (evq->count == EVQ_SIZE && !evq->closed) {
+				pthread_cond_wait(&evq->not_full, &evq->lock);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (evq->count == EVQ_SIZE || evq->closed) {
+		evq->stats.dropped_newest++;
+		pthread_mutex_unlock(&evq->lock);
+		return true;
+	}
+
+	struct caniot_ctrl_evq_item *const item =
+		&evq->items[(evq->head + evq->count) % EVQ_SIZE];
+
+	item->ev = *ev;
+	if (ev->response) {
+		item->response = *ev->response;
+	}
+
+	evq->count++;
+	evq->stats.posted++;
+	if (evq->count > evq->stats.high_watermark) {
+		evq->stats.high_watermark = evq->count;
+	}
+
+	pthread_cond_signal(&evq->not_empty);
+	pthread_mutex_unlock(&evq->lock);
+
+	return true;
+}
+
+int caniot_ctrl_evq_dispatch(struct caniot_ctrl_evq *evq, bool wait)
+{
+	struct caniot_ctrl_evq_item item;
+
+	pthread_mutex_lock(&evq->lock);
+
+	while (wait && evq->count == 0u && !evq->closed) {
+		pthread_cond_wait(&evq->not_empty, &evq->lock);
+	}
+
+	if (evq->count == 0u) {
+		pthread_mutex_unlock(&evq->lock);
+		return 0;
+	}
+
+	item	  = evq->items[evq->head];
+	evq->head = (evq->head + 1u) % EVQ_SIZE;
+	evq->count--;
+	evq->stats.dispatched++;
+
+	pthread_cond_signal(&evq->not_full);
+	pthread_mutex_unlock(&evq->lock);
+
+	/* the callback is called without the lock held, so that events can be
+	 * posted meanwhile */
+	if (item.ev.response) {
+		item.ev.response = &item.response;
+	}
+
+	evq->cb(&item.ev, evq->user_data);
+
+	return 1;
+}
+
+void *caniot_ctrl_evq_worker(void *arg)
+{
+	struct caniot_ctrl_evq *const evq = arg;
+
+	while (caniot_ctrl_evq_dispatch(evq, true) == 1) {
+	}
+
+	return NULL;
+}
+
+void caniot_ctrl_evq_close(struct caniot_ctrl_evq *evq)
+{
+	pthread_mutex_lock(&evq->lock);
+	evq->closed = true;
+	pthread_cond_broadcast(&evq->not_empty);
+	pthread_cond_broadcast(&evq->not_full);
+	pthread_mutex_unlock(&evq->lock);
+}
+
+void caniot_ctrl_evq_stats_get(struct caniot_ctrl_evq *evq,
+			       struct caniot_ctrl_evq_stats *stats)
+{
+	pthread_mutex_lock(&evq->lock);
+	*stats = evq->stats;
+	pthread_mutex_unlock(&evq->lock);
+}
+
+#endif /* CONFIG_CANIOT_CTRL_EVQ */
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <caniot/caniot_private.h>
+#include <caniot/ctrl_group.h>
+
+#if CONFIG_CANIOT_CTRL_GROUP
+
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+static bool bus_event_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	struct caniot_ctrl_group_bus *const bus = user_data;
+	struct caniot_ctrl_group *const group	= bus->group;
+
+	if (!group->serialize_events) {
+		return group->event_cb(group, bus->index, ev, group->user_data);
+	}
+
+	pthread_mutex_lock(&group->event_lock);
+	const bool ret = group->event_cb(group, bus->index, ev, group->user_data);
+	pthread_mutex_unlock(&group->event_lock);
+
+	return ret;
+}
+
+/* Wake the thread of a bus up before its sleep time elapses */
+static void bus_kick(struct caniot_ctrl_group_bus *bus)
+{
+	pthread_mutex_lock(&bus->wake_lock);
+	bus->kicked = true;
+	pthread_cond_signal(&bus->wake);
+	pthread_mutex_unlock(&bus->wake_lock);
+}
+
+/* Sleep until the next controller timeout, at most the poll period (frames
+ * received are not signaled), or until the bus is kicked */
+static void bus_sleep(struct caniot_ctrl_group_bus *bus)
+{
+	uint32_t sleep_us	  = bus->group->poll_period_us;
+	const uint32_t timeout_ms = caniot_controller_next_timeout(&bus->ctrl);
+
+	if (timeout_ms < sleep_us / 1000u) {
+		sleep_us = timeout_ms * 1000u;
+	}
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ts.tv_sec += sleep_us / 1000000u;
+	ts.tv_nsec += (long)(sleep_us % 1000000u) * 1000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&bus->wake_lock);
+	while (!bus->kicked) {
+		if (pthread_cond_timedwait(&bus->wake, &bus->wake_lock, &ts) ==
+		    ETIMEDOUT) {
+			break;
+		}
+	}
+	bus->kicked = false;
+	pthread_mutex_unlock(&bus->wake_lock);
+}
+
+static void *bus_thread(void *arg)
+{
+	struct caniot_ctrl_group_bus *const bus = arg;
+	struct caniot_ctrl_group *const group	= bus->group;
+
+	while (__atomic_load_n(&group->running, __ATOMIC_ACQUIRE)) {
+		const int ret = caniot_controller_process(&bus->ctrl);
+		if (ret < 0) {
+			CANIOT_ERR(F("group: bus %u process failed: %d\n"),
+				   bus->index,
+				   ret);
+		}
+
+		if (group->poll_period_us != 0u) {
+			bus_sleep(bus);
+		} else {
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+int caniot_ctrl_group_init(struct caniot_ctrl_group *group,
+			   caniot_ctrl_group_event_cb_t cb,
+			   void *user_data)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!group || !cb) return -CANIOT_EINVAL;
+#endif
+
+	group->count	      = 0u;
+	group->running	      = false;
+	group->poll_period_us	= 1000u;
+	group->serialize_events = false;
+	group->event_cb		= cb;
+	group->user_data	= user_data;
+
+	if (pthread_mutex_init(&group->event_lock, NULL) != 0) {
+		return -CANIOT_EDRIVER;
+	}
+
+	return 0;
+}
+
+int caniot_ctrl_group_add_bus(struct caniot_ctrl_group *group,
+			      const struct caniot_drivers_api *driv)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!group || !driv) return -CANIOT_EINVAL;
+#endif
+
+	if (group->running) return -CANIOT_EBUSY;
+	if (group->count >= CONFIG_CANIOT_CTRL_GROUP_MAX_BUSES) return -CANIOT_EINVAL;
+
+	struct caniot_ctrl_group_bus *const bus = &group->buses[group->count];
+
+	bus->group  = group;
+	bus->index  = group->count;
+	bus->kicked = false;
+
+	pthread_condattr_t attr;
+	if (pthread_condattr_init(&attr) != 0) return -CANIOT_EDRIVER;
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	const int cond_ret = pthread_cond_init(&bus->wake, &attr);
+	pthread_condattr_destroy(&attr);
+	if (cond_ret != 0) return -CANIOT_EDRIVER;
+
+	if (pthread_mutex_init(&bus->wake_lock, NULL) != 0) {
+		pthread_cond_destroy(&bus->wake);
+		return -CANIOT_EDRIVER;
+	}
+
+	const int ret = caniot_controller_driv_init(&bus->ctrl, driv, bus_event_cb, bus);
+	if (ret < 0) {
+		pthread_mutex_destroy(&bus->wake_lock);
+		pthread_cond_destroy(&bus->wake);
+		return ret;
+	}
+
+	return group->count++;
+}
+
+int caniot_ctrl_group_start(struct caniot_ctrl_group *group)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!group) return -CANIOT_EINVAL;
+#endif
+
+	if (group->running) return -CANIOT_EBUSY;
+
+	__atomic_store_n(&group->running, true, __ATOMIC_RELEASE);
+
+	for (uint8_t i = 0u; i < group->count; i++) {
+		struct caniot_ctrl_group_bus *const bus = &group->buses[i];
+
+		if (pthread_create(&bus->thread, NULL, bus_thread, bus) != 0) {
+			/* stop threads already started */
+			__atomic_store_n(&group->running, false, __ATOMIC_RELEASE);
+			while (i-- > 0u) {
+				pthread_join(group->buses[i].thread, NULL);
+			}
+
+			return -CANIOT_EDRIVER;
+		}
+	}
+
+	return 0;
+}
+
+int caniot_ctrl_group_stop(struct caniot_ctrl_group *group)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!group) return -CANIOT_EINVAL;
+#endif
+
+	if (!group->running) return 0;
+
+	__atomic_store_n(&group->running, false, __ATOMIC_RELEASE);
+
+	for (uint8_t i = 0u; i < group->count; i++) {
+		bus_kick(&group->buses[i]);
+	}
+
+	for (uint8_t i = 0u; i < group->count; i++) {
+		pthread_join(group->buses[i].thread, NULL);
+		caniot_controller_deinit(&group->buses[i].ctrl);
+	}
+
+	return 0;
+}
+
+int caniot_ctrl_group_submit(struct caniot_ctrl_group *group,
+			     uint8_t bus,
+			     caniot_did_t did,
+			     const struct caniot_frame *frame,
+			     uint32_t timeout,
+			     caniot_controller_submit_cb_t cb,
+			     void *user_data)
+{
+#if CONFIG_CANIOT_CHECKS
+	if (!group) return -CANIOT_EINVAL;
+#endif
+
+	if (bus >= group->count) return -CANIOT_EINVAL;
+
+	const int ret = caniot_controller_submit(
+		&group->buses[bus].ctrl, did, frame, timeout, cb, user_data);
+	if (ret == 0) {
+		bus_kick(&group->buses[bus]);
+	}
+
+	return ret;
+}
+
+#endif /* CONFIG_CANIOT_CTRL_GROUP */
@@ -1105,11 +1105,15 @@ uint32_t caniot_device_telemetry_remaining(struct caniot_device *dev)
 {
 	ASSERT(dev != NULL);
 
+	/* default 1 second */
+	uint32_t remaining = 1000u;
+
+	uint32_t sec;
+	uint16_t msec;
+	dev->driv->get_time(&sec, &msec);
+	const uint32_t now_ms = sec * 1000 + msec;
+
 	if (prepare_config_read(dev) == 0) {
-		uint32_t sec;
-		uint16_t msec;
-		dev->driv->get_time(&sec, &msec);
-		const uint32_t now_ms = sec * 1000 + msec;
 		const uint32_t ellapsed_ms = now_ms - dev->system._last_telemetry_ms;
 		CANIOT_DBG(F("now: %u _last_telemetry_ms: %u since last: %u < period: %u ? (* ms)\n"),
 			   (FMT_UINT_CAST)now_ms,
@@ -1118,14 +1122,18 @@ uint32_t caniot_device_telemetry_remaining(struct caniot_device *dev)
 			   (FMT_UINT_CAST)dev->config->telemetry.period);
 
 		if (dev->config->telemetry.period <= ellapsed_ms) {
-			return 0;
+			remaining = 0;
 		} else {
-			return dev->config->telemetry.period - ellapsed_ms;
+			remaining = dev->config->telemetry.period - ellapsed_ms;
 		}
 	}
 
-	/* default 1 second */
-	return 1000u;
+#if CONFIG_CANIOT_TXQ
+	/* a queued response may be due first */
+	remaining = MIN(remaining, caniot_txq_next_release(&dev->txq, now_ms));
+#endif
+
+	return remaining;
 }
 
 static uint32_t get_response_delay(struct caniot_device *dev, bool random)
@@ -1201,6 +1209,205 @@ static inline void telemetry_trig_clear_ep(struct caniot_device *dev,
 	dev->flags.request_telemetry_ep &= ~(1u << ep);
 }
 
+#if CONFIG_CANIOT_BUSLOAD
+void caniot_device_busload_attach(struct caniot_device *dev, struct caniot_busload *bl)
+{
+	ASSERT(dev != NULL);
+
+	dev->busload = bl;
+}
+
+static void busload_feed(struct caniot_device *dev,
+			 const struct caniot_frame *frame,
+			 uint32_t now_ms)
+{
+	if (dev->busload != NULL) {
+		caniot_busload_add_frame(dev->busload, now_ms, frame);
+	}
+}
+
+#define BUSLOAD_FEED(_dev, _frame, _now_ms) busload_feed(_dev, _frame, _now_ms)
+#else
+#define BUSLOAD_FEED(_dev, _frame, _now_ms)
+#endif
+
+/* Update the device state after the frame "resp" has been sent */
+static void response_sent(struct caniot_device *dev,
+			  struct caniot_frame *resp,
+			  uint32_t now_ms)
+{
+	dev->system.sent.total++;
+
+	/* if we sent a telemetry frame */
+	if (is_telemetry_response(resp) == true) {
+
+		telemetry_trig_clear_ep(dev, resp->id.endpoint);
+
+		/* If the endpoint is the one configured for periodic telemetry,
+		 * update the last telemetry timestamp.
+		 */
+		if (resp->id.endpoint == dev->config->flags.telemetry_endpoint) {
+			dev->system._last_telemetry_ms = now_ms;
+			dev->system.last_telemetry     = dev->system.time;
+		}
+	}
+}
+
+#if CONFIG_CANIOT_TXQ
+/* Pass the released responses to the driver by order of CAN identifier, until
+ * the mailbox is full */
+static void txq_flush(struct caniot_device *dev, uint32_t now_ms)
+{
+	struct caniot_txq_item *item;
+
+	while ((item = caniot_txq_peek(&dev->txq, now_ms)) != NULL) {
+		const int ret = dev->driv->send(&item->frame, 0u);
+		if (ret == -CANIOT_EAGAIN) {
+			dev->txq.stats.mailbox_full++;
+			break;
+		} else if (ret != 0) {
+			CANIOT_ERR(F("txq: failed to send frame: %d\n"), ret);
+			dev->txq.stats.dropped++;
+		} else {
+			dev->txq.stats.sent++;
+			BUSLOAD_FEED(dev, &item->frame, now_ms);
+		}
+
+		caniot_txq_remove(&dev->txq, item);
+	}
+}
+
+#define TXQ_FLUSH(_dev, _now_ms) txq_flush(_dev, _now_ms)
+#else
+#define TXQ_FLUSH(_dev, _now_ms)
+#endif
+
+/* Send a response after "delay_ms", or queue it if CONFIG_CANIOT_TXQ is enabled
+ * (the queue is then flushed with TXQ_FLUSH()).
+ *
+ * A queued response is considered sent, so that a pending telemetry is not
+ * queued again on next call to caniot_device_process(). */
+static int device_send(struct caniot_device *dev,
+		       struct caniot_frame *resp,
+		       uint32_t delay_ms,
+		       uint32_t now_ms)
+{
+#if CONFIG_CANIOT_TXQ
+	const int ret = caniot_txq_push(&dev->txq, resp, now_ms, delay_ms, 0u);
+#else
+	const int ret = dev->driv->send(resp, delay_ms);
+	if (ret == 0) {
+		BUSLOAD_FEED(dev, resp, now_ms);
+	}
+#endif
+
+	if (ret == 0) {
+		response_sent(dev, resp, now_ms);
+	}
+
+	return ret;
+}
+
+#if CONFIG_CANIOT_DRIVERS_BURST_SIZE
+/**
+ * @brief Handle a burst of received frames and send all responses at once.
+ *
+ * send_burst() is used if available, otherwise responses are sent one by one.
+ * Responses send_burst() did not take are sent one by one as well. A response
+ * which cannot be sent is dropped, the following ones are still sent.
+ *
+ * @param received Set if any frame was received
+ * @return int -CANIOT_EAGAIN if no frame was received, 0 on success, negative
+ * value on error (e.g. -CANIOT_EAGAIN if a response could not be sent): the
+ * error of the first response dropped
+ */
+static int process_burst(struct caniot_device *dev, uint32_t now_ms, bool *received)
+{
+	struct caniot_frame reqs[CONFIG_CANIOT_DRIVERS_BURST_SIZE];
+	struct caniot_frame resps[CONFIG_CANIOT_DRIVERS_BURST_SIZE];
+	uint32_t delays[CONFIG_CANIOT_DRIVERS_BURST_SIZE];
+	int count = 0;
+	int ret;
+
+	*received = false;
+
+	ret = dev->driv->recv_burst(reqs, ARRAY_SIZE(reqs));
+	if (ret == 0) {
+		return -CANIOT_EAGAIN;
+	} else if (ret < 0) {
+		return ret;
+	}
+
+	*received = true;
+
+	for (int i = 0; i < ret; i++) {
+		BUSLOAD_FEED(dev, &reqs[i], now_ms);
+
+#if CONFIG_CANIOT_DEBUG
+		if (!caniot_device_is_target(caniot_device_get_id(dev), &reqs[i])) {
+			dev->system.received.ignored++;
+			CANIOT_ERR(F("Unexpected frame id received\n"));
+		}
+#endif
+
+		caniot_clear_frame(&resps[count]);
+		if (caniot_device_handle_rx_frame(dev, &reqs[i], &resps[count]) != 0) {
+			prepare_config_read(dev);
+
+			/* if "error frame" are not enabled */
+			if (dev->config->flags.error_response == 0u) {
+				continue;
+			}
+		}
+
+		/* broadcast request requires a randomly delayed response */
+		delays[count++] = get_response_delay(
+			dev, caniot_is_broadcast(caniot_frame_get_did(&reqs[i])));
+	}
+
+#if CONFIG_CANIOT_TXQ
+	/* responses are queued, so that they are ordered with the pending ones */
+	const bool burst = false;
+#else
+	const bool burst = dev->driv->send_burst != NULL;
+#endif
+
+	int sent = 0;
+
+	if (burst && (count != 0)) {
+		/* on error, all responses are sent one by one */
+		sent = dev->driv->send_burst(resps, count, delays);
+		sent = MAX(sent, 0);
+		for (int i = 0; i < sent; i++) {
+			BUSLOAD_FEED(dev, &resps[i], now_ms);
+			response_sent(dev, &resps[i], now_ms);
+		}
+	}
+
+	/* responses left by send_burst() (if any) */
+	int dropped = 0;
+
+	ret = 0;
+	for (int i = sent; i < count; i++) {
+		const int err = device_send(dev, &resps[i], delays[i], now_ms);
+		if (err != 0) {
+			if (ret == 0) ret = err;
+			dropped++;
+		}
+	}
+	TXQ_FLUSH(dev, now_ms);
+
+	if (dropped != 0) {
+		CANIOT_ERR(F("%u/%u responses dropped: %d\n"),
+			   (FMT_UINT_CAST)dropped,
+			   (FMT_UINT_CAST)count,
+			   ret);
+	}
+
+	return ret;
+}
+#endif
+
 int caniot_device_process(struct caniot_device *dev)
 {
 	ASSERT(dev != NULL);
@@ -1208,9 +1415,11 @@ int caniot_device_process(struct caniot_device *dev)
 	int ret;
 	struct caniot_frame req, resp;
 
-	/* get current time (ms precision) */
+	/* get current time (ms precision), "system" is packed */
+	uint32_t sec;
 	uint16_t msec;
-	dev->driv->get_time(&dev->system.time, &msec);
+	dev->driv->get_time(&sec, &msec);
+	dev->system.time   = sec;
 	dev->system.uptime = dev->system.time - dev->system.start_time;
 
 	/* check if we need to send telemetry (calculated in seconds) */
@@ -1232,15 +1441,31 @@ int caniot_device_process(struct caniot_device *dev)
 		CANIOT_DBG(F("Requesting telemetry\n"));
 	}
 
+	/* responses whose delay elapsed */
+	TXQ_FLUSH(dev, now_ms);
+
 	/* received any incoming frame */
 	caniot_clear_frame(&req);
+#if CONFIG_CANIOT_DRIVERS_BURST_SIZE
+	if (dev->driv->recv_burst != NULL) {
+		/* pending telemetry is only sent if no frame is received */
+		bool received;
+		ret = process_burst(dev, now_ms, &received);
+		if (received || (ret != -CANIOT_EAGAIN)) goto exit;
+	} else {
+		ret = dev->driv->recv(&req);
+	}
+#else
 	ret = dev->driv->recv(&req);
+#endif
 
 	/* response delay is not random by default */
 	bool random_delay = false;
 
 	/* if we received a frame */
 	if (ret == 0) {
+		BUSLOAD_FEED(dev, &req, now_ms);
+
 #if CONFIG_CANIOT_DEBUG
 		if (!caniot_device_is_target(caniot_device_get_id(dev), &req)) {
 			dev->system.received.ignored++;
@@ -1287,24 +1512,8 @@ int caniot_device_process(struct caniot_device *dev)
 	}
 
 	/* send response or error frame if configured */
-	ret = dev->driv->send(&resp, get_response_delay(dev, random_delay));
-	if (ret == 0) {
-		dev->system.sent.total++;
-
-		/* if we sent a telemetry frame */
-		if (is_telemetry_response(&resp) == true) {
-
-			telemetry_trig_clear_ep(dev, resp.id.endpoint);
-
-			/* If the endpoint is the one configured for periodic telemetry,
-			 * update the last telemetry timestamp.
-			 */
-			if (resp.id.endpoint == dev->config->flags.telemetry_endpoint) {
-				dev->system._last_telemetry_ms = now_ms;
-				dev->system.last_telemetry     = dev->system.time;
-			}
-		}
-	}
+	ret = device_send(dev, &resp, get_response_delay(dev, random_delay), now_ms);
+	TXQ_FLUSH(dev, now_ms);
 
 exit:
 	return ret;
@@ -1318,7 +1527,13 @@ void caniot_app_init(struct caniot_device *dev)
 
 	memset(&dev->system, 0x00U, sizeof(dev->system));
 
-	dev->driv->get_time(&dev->system.start_time, NULL);
+	uint32_t start_time;
+	dev->driv->get_time(&start_time, NULL);
+	dev->system.start_time = start_time;
+
+#if CONFIG_CANIOT_TXQ
+	caniot_txq_init(&dev->txq);
+#endif
 
 	dev->flags.initialized = 1u;
 }
@@ -1351,6 +1566,8 @@ static void attribute_copy_name_from_key(struct caniot_device_attribute *attr,
 		strncpy(attr->name, attribute->name, CANIOT_ATTR_NAME_MAX_LEN);
 		return;
 	}
+#else
+	(void)key;
 #endif
 	memset(attr->name, 0x00u, CANIOT_ATTR_NAME_MAX_LEN);
 }
@@ -1415,6 +1632,135 @@ exit:
 	return count;
 }
 
+_Static_assert(ARRAY_SIZE(config_attr) == CANIOT_CONFIG_ATTR_COUNT,
+	       "CANIOT_CONFIG_ATTR_COUNT mismatch");
+_Static_assert(CANIOT_CONFIG_ATTR_COUNT <= 64u, "Config attributes known bitmap");
+
+static int config_attr_resolve(uint16_t key, struct attr_ref *ref)
+{
+	const int ret = attr_resolve(key, ref);
+	if (ret != 0) {
+		return ret;
+	}
+
+	if (ref->section != ATTR_CONFIG) {
+		return -CANIOT_EKEYSECTION;
+	}
+
+	return 0;
+}
+
+int caniot_config_attr_get(const struct caniot_device_config *config,
+			   uint16_t key,
+			   uint32_t *val)
+{
+	struct attr_ref ref;
+
+	if (!config || !val) {
+		return -CANIOT_EINVAL;
+	}
+
+	const int ret = config_attr_resolve(key, &ref);
+	if (ret == 0) {
+		*val = 0u;
+		memcpy(val, (const uint8_t *)config + ref.offset, ref.size);
+	}
+
+	return ret;
+}
+
+int caniot_config_attr_set(struct caniot_device_config *config,
+			   uint16_t key,
+			   uint32_t val)
+{
+	struct attr_ref ref;
+
+	if (!config) {
+		return -CANIOT_EINVAL;
+	}
+
+	const int ret = config_attr_resolve(key, &ref);
+	if (ret == 0) {
+		memcpy((uint8_t *)config + ref.offset, &val, ref.size);
+	}
+
+	return ret;
+}
+
+static bool config_attr_for_class(const struct attribute *attr, uint8_t cls)
+{
+	const enum attr_option option = attr_get_option(attr);
+
+	return (option & WRITABLE) &&
+	       ((option & ATTR_CLASS_ALL) ||
+		(((option >> ATTR_OPTION_CLASS_POS) & ATTR_OPTION_CLASS_MSK) == cls));
+}
+
+static bool config_attr_same_bytes(const struct attribute *a, const struct attribute *b)
+{
+	return (attr_get_offset(a) == attr_get_offset(b)) &&
+	       (attr_get_size(a) == attr_get_size(b));
+}
+
+int caniot_config_diff(const struct caniot_device_config *from,
+		       uint64_t known,
+		       const struct caniot_device_config *to,
+		       uint8_t cls,
+		       uint16_t *keys,
+		       size_t max)
+{
+	if (!from || !to || !keys) {
+		return -CANIOT_EINVAL;
+	}
+
+	const struct attr_section *section = &attr_sections[ATTR_CONFIG];
+	const struct attribute *array	   = attr_get_section_array(section);
+	int count			   = 0;
+
+	for (uint8_t ai = 0u; ai < CANIOT_CONFIG_ATTR_COUNT; ai++) {
+		const struct attribute *attr = &array[ai];
+		bool alias		     = false;
+		bool attr_known		     = (known >> ai) & 1u;
+
+		if (!config_attr_for_class(attr, cls)) continue;
+
+		/* Attributes sharing the same bytes are reported with the first one,
+		 * whose value is known if any of them is */
+		for (uint8_t i = 0u; i < CANIOT_CONFIG_ATTR_COUNT; i++) {
+			if ((i == ai) || !config_attr_for_class(&array[i], cls) ||
+			    !config_attr_same_bytes(&array[i], attr)) {
+				continue;
+			}
+
+			if (i < ai) {
+				alias = true;
+				break;
+			}
+
+			attr_known |= (known >> i) & 1u;
+		}
+
+		if (alias) continue;
+
+		const uint8_t offset = attr_get_offset(attr);
+		const uint8_t size   = MIN(attr_get_size(attr), 4u);
+
+		if (attr_known && (memcmp((const uint8_t *)from + offset,
+					  (const uint8_t *)to + offset,
+					  size) == 0)) {
+			continue;
+		}
+
+		if ((size_t)count >= max) {
+			return -CANIOT_EINVAL;
+		}
+
+		keys[count++] = ATTR_KEY(ATTR_CONFIG, ai, 0u);
+	}
+
+	return count;
+}
+
 bool caniot_device_targeted(caniot_did_t did, bool ext, bool rtr, uint32_t id)
 {
 	bool targeted = false;
@@ -0,0 +1,392 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define _GNU_SOURCE /* recvmmsg(), sendmmsg() */
+
+#include <caniot/caniot_private.h>
+#include <caniot/controller.h>
+#include <caniot/device.h>
+#include <caniot/socketcan.h>
+
+#if CONFIG_CANIOT_SOCKETCAN
+
+#include <errno.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <string.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+/* Only standard data frames are CANIOT frames */
+#define SFF_FILTER_MASK (CAN_EFF_FLAG | CAN_RTR_FLAG)
+
+static uint64_t monotonic_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000u + ts.tv_nsec / 1000000u;
+}
+
+static void frame_to_can(const struct caniot_frame *frame, struct can_frame *cf)
+{
+	memset(cf, 0x00u, sizeof(*cf));
+
+	cf->can_id  = caniot_id_to_canid(frame->id);
+	cf->can_dlc = MIN(frame->len, 8u);
+	memcpy(cf->data, frame->buf, cf->can_dlc);
+}
+
+static void can_to_frame(const struct can_frame *cf, struct caniot_frame *frame)
+{
+	caniot_clear_frame(frame);
+
+	frame->id  = caniot_canid_to_id(cf->can_id & CAN_SFF_MASK);
+	frame->len = MIN(cf->can_dlc, 8u);
+	memcpy(frame->buf, cf->data, frame->len);
+}
+
+#if CONFIG_CANIOT_FRAME_TIMESTAMP
+static void msg_to_timestamp(struct msghdr *msg, struct caniot_frame *frame)
+{
+	struct cmsghdr *cmsg;
+
+	for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SO_TIMESTAMP)) {
+			struct timeval tv;
+			memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+
+			frame->timestamp.sec  = tv.tv_sec;
+			frame->timestamp.frac = tv.tv_usec / 1000u;
+		}
+	}
+}
+#endif
+
+static int set_filters(struct caniot_socketcan *sc,
+		       const struct can_filter *filters,
+		       size_t count)
+{
+	if (setsockopt(sc->fd,
+		       SOL_CAN_RAW,
+		       CAN_RAW_FILTER,
+		       filters,
+		       count * sizeof(struct can_filter)) < 0) {
+		CANIOT_ERR(F("socketcan: CAN_RAW_FILTER failed: %d\n"), errno);
+		return -CANIOT_EDRIVER;
+	}
+
+	return 0;
+}
+
+int caniot_socketcan_open(struct caniot_socketcan *sc, const char *ifname)
+{
+	ASSERT(sc != NULL);
+	ASSERT(ifname != NULL);
+
+	struct sockaddr_can addr = {.can_family = AF_CAN};
+
+	sc->delayed_count   = 0u;
+	sc->delayed_dropped = 0u;
+	sc->fd		    = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW);
+	if (sc->fd < 0) {
+		CANIOT_ERR(F("socketcan: socket() failed: %d\n"), errno);
+		return -CANIOT_EDRIVER;
+	}
+
+	addr.can_ifindex = if_nametoindex(ifname);
+	if (addr.can_ifindex == 0) {
+		CANIOT_ERR(F("socketcan: unknown interface %s\n"), ifname);
+		goto error;
+	}
+
+	/* Receive nothing until a filter is installed */
+	if (setsockopt(sc->fd, SOL_CAN_RAW, CAN_RAW_FILTER, NULL, 0) < 0) goto error;
+
+#if CONFIG_CANIOT_FRAME_TIMESTAMP
+	const int one = 1;
+	if (setsockopt(sc->fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one)) < 0) goto error;
+#endif
+
+	if (bind(sc->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		CANIOT_ERR(F("socketcan: bind(%s) failed: %d\n"), ifname, errno);
+		goto error;
+	}
+
+	return 0;
+
+error:
+	close(sc->fd);
+	sc->fd = -1;
+
+	return -CANIOT_EDRIVER;
+}
+
+void caniot_socketcan_close(struct caniot_socketcan *sc)
+{
+	ASSERT(sc != NULL);
+
+	if (sc->fd >= 0) {
+		close(sc->fd);
+		sc->fd = -1;
+	}
+}
+
+int caniot_socketcan_filter_device(struct caniot_socketcan *sc, caniot_did_t did)
+{
+	ASSERT(sc != NULL);
+
+	const canid_t mask		= caniot_device_get_mask() | SFF_FILTER_MASK;
+	const struct can_filter filters[] = {
+		{.can_id = caniot_device_get_filter(did), .can_mask = mask},
+		{.can_id = caniot_device_get_filter_broadcast(did), .can_mask = mask},
+	};
+
+	return set_filters(sc, filters, ARRAY_SIZE(filters));
+}
+
+int caniot_socketcan_filter_controller(struct caniot_socketcan *sc)
+{
+	ASSERT(sc != NULL);
+
+	const struct can_filter filter = {
+		.can_id	  = caniot_controller_get_filter(),
+		.can_mask = caniot_controller_get_mask() | SFF_FILTER_MASK,
+	};
+
+	return set_filters(sc, &filter, 1u);
+}
+
+static int send_now(struct caniot_socketcan *sc, const struct caniot_frame *frame)
+{
+	struct can_frame cf;
+
+	frame_to_can(frame, &cf);
+
+	if (write(sc->fd, &cf, sizeof(cf)) != sizeof(cf)) {
+		return ((errno == EAGAIN) || (errno == ENOBUFS)) ? -CANIOT_EAGAIN
+								 : -CANIOT_EDRIVER;
+	}
+
+	return 0;
+}
+
+static int send_delayed(struct caniot_socketcan *sc,
+			const struct caniot_frame *frame,
+			uint32_t delay_ms)
+{
+	if (sc->delayed_count >= CANIOT_SOCKETCAN_DELAYED_MAX) return -CANIOT_EAGAIN;
+
+	sc->delayed[sc->delayed_count].frame	   = *frame;
+	sc->delayed[sc->delayed_count].deadline_ms = monotonic_ms() + delay_ms;
+	sc->delayed_count++;
+
+	return 0;
+}
+
+/* Send frames whose delay elapsed, the ones which cannot be sent because the
+ * queue is full are kept */
+static void flush_delayed(struct caniot_socketcan *sc)
+{
+	if (sc->delayed_count == 0u) return;
+
+	const uint64_t now = monotonic_ms();
+	uint8_t kept	   = 0u;
+
+	for (uint8_t i = 0u; i < sc->delayed_count; i++) {
+		int ret = -CANIOT_EAGAIN;
+
+		if (sc->delayed[i].deadline_ms <= now) {
+			ret = send_now(sc, &sc->delayed[i].frame);
+		}
+
+		if (ret == -CANIOT_EAGAIN) {
+			sc->delayed[kept++] = sc->delayed[i];
+		} else if (ret < 0) {
+			sc->delayed_dropped++;
+			CANIOT_ERR(F("socketcan: delayed frame dropped: %d\n"), ret);
+		}
+	}
+
+	sc->delayed_count = kept;
+}
+
+int caniot_socketcan_send(struct caniot_socketcan *sc,
+			  const struct caniot_frame *frame,
+			  uint32_t delay_ms)
+{
+	ASSERT(sc != NULL);
+	ASSERT(frame != NULL);
+
+	flush_delayed(sc);
+
+	if (delay_ms != 0u) {
+		return send_delayed(sc, frame, delay_ms);
+	}
+
+	return send_now(sc, frame);
+}
+
+int caniot_socketcan_recv(struct caniot_socketcan *sc, struct caniot_frame *frame)
+{
+	ASSERT(sc != NULL);
+	ASSERT(frame != NULL);
+
+	int ret = caniot_socketcan_recv_burst(sc, frame, 1u);
+
+	return (ret == 1) ? 0 : ret;
+}
+
+int caniot_socketcan_recv_burst(struct caniot_socketcan *sc,
+				struct caniot_frame *frames,
+				size_t max)
+{
+	ASSERT(sc != NULL);
+	ASSERT(frames != NULL);
+
+	struct can_frame cfs[CANIOT_SOCKETCAN_BURST_MAX];
+	struct iovec iovs[CANIOT_SOCKETCAN_BURST_MAX];
+	struct mmsghdr msgs[CANIOT_SOCKETCAN_BURST_MAX];
+#if CONFIG_CANIOT_FRAME_TIMESTAMP
+	char ctrl[CANIOT_SOCKETCAN_BURST_MAX][CMSG_SPACE(sizeof(struct timeval))];
+#endif
+
+	flush_delayed(sc);
+
+	max = MIN(max, CANIOT_SOCKETCAN_BURST_MAX);
+
+	memset(msgs, 0x00u, max * sizeof(struct mmsghdr));
+	for (size_t i = 0u; i < max; i++) {
+		iovs[i].iov_base	    = &cfs[i];
+		iovs[i].iov_len		    = sizeof(struct can_frame);
+		msgs[i].msg_hdr.msg_iov	    = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen  = 1u;
+#if CONFIG_CANIOT_FRAME_TIMESTAMP
+		msgs[i].msg_hdr.msg_control    = ctrl[i];
+		msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i]);
+#endif
+	}
+
+	const int ret = recvmmsg(sc->fd, msgs, max, MSG_DONTWAIT, NULL);
+	if (ret < 0) {
+		return (errno == EAGAIN) ? -CANIOT_EAGAIN : -CANIOT_EDRIVER;
+	}
+
+	int count = 0;
+	for (int i = 0; i < ret; i++) {
+		/* Filters already drop other frames, but drop incomplete reads */
+		if (msgs[i].msg_len != sizeof(struct can_frame)) continue;
+
+		can_to_frame(&cfs[i], &frames[count]);
+#if CONFIG_CANIOT_FRAME_TIMESTAMP
+		msg_to_timestamp(&msgs[i].msg_hdr, &frames[count]);
+#endif
+		count++;
+	}
+
+	return (count != 0) ? count : -CANIOT_EAGAIN;
+}
+
+/* Send the "count" frames of "msgs" at once, return the number of frames sent */
+static int send_now_burst(struct caniot_socketcan *sc, struct mmsghdr *msgs, size_t count)
+{
+	if (count == 0u) return 0;
+
+	const int ret = sendmmsg(sc->fd, msgs, count, MSG_DONTWAIT);
+	if (ret < 0) {
+		return (errno == EAGAIN) || (errno == ENOBUFS) ? -CANIOT_EAGAIN
+							       : -CANIOT_EDRIVER;
+	}
+
+	return ret;
+}
+
+int caniot_socketcan_send_burst(struct caniot_socketcan *sc,
+				const struct caniot_frame *frames,
+				size_t count,
+				const uint32_t *delays_ms)
+{
+	ASSERT(sc != NULL);
+	ASSERT(frames != NULL);
+
+	struct can_frame cfs[CANIOT_SOCKETCAN_BURST_MAX];
+	struct iovec iovs[CANIOT_SOCKETCAN_BURST_MAX];
+	struct mmsghdr msgs[CANIOT_SOCKETCAN_BURST_MAX];
+	size_t accepted = 0u; /* leading frames sent or delayed */
+	size_t now	= 0u; /* frames to send at once, following the accepted ones */
+	int ret		= 0;
+
+	flush_delayed(sc);
+
+	count = MIN(count, CANIOT_SOCKETCAN_BURST_MAX);
+
+	/* Frames are accepted in order: a delayed frame is only queued once the
+	 * frames before it are sent, and nothing is accepted after a frame which
+	 * could not be, so that the caller can send the others again */
+	for (size_t i = 0u; i <= count; i++) {
+		const bool delayed =
+			(i < count) && (delays_ms != NULL) && (delays_ms[i] != 0u);
+
+		if ((i < count) && !delayed) {
+			frame_to_can(&frames[i], &cfs[now]);
+			memset(&msgs[now], 0x00u, sizeof(msgs[now]));
+			iovs[now].iov_base	     = &cfs[now];
+			iovs[now].iov_len	     = sizeof(struct can_frame);
+			msgs[now].msg_hdr.msg_iov    = &iovs[now];
+			msgs[now].msg_hdr.msg_iovlen = 1u;
+			now++;
+			continue;
+		}
+
+		ret = send_now_burst(sc, msgs, now);
+		if (ret < 0) break;
+
+		accepted += (size_t)ret;
+		if ((size_t)ret < now) {
+			/* The TX queue is full */
+			ret = -CANIOT_EAGAIN;
+			break;
+		}
+		now = 0u;
+
+		if (delayed) {
+			ret = send_delayed(sc, &frames[i], delays_ms[i]);
+			if (ret < 0) break;
+
+			accepted++;
+		}
+	}
+
+	return ((accepted != 0u) || (ret >= 0)) ? (int)accepted : ret;
+}
+
+void caniot_socketcan_entropy(uint8_t *buf, size_t len)
+{
+	while (len != 0u) {
+		const ssize_t ret = getrandom(buf, len, 0);
+		if (ret > 0) {
+			buf += ret;
+			len -= ret;
+		}
+	}
+}
+
+void caniot_socketcan_get_time(uint32_t *sec, uint16_t *ms)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+
+	if (sec != NULL) *sec = ts.tv_sec;
+	if (ms != NULL) *ms = ts.tv_nsec / 1000000u;
+}
+
+#endif /* CONFIG_CANIOT_SOCKETCAN */
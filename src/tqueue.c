@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <caniot/caniot_private.h>
+#include <caniot/tqueue.h>
+
+#define pqt caniot_pendq_time_handle
+
+void caniot_tqueue_queue(struct pqt **root, struct pqt *item)
+{
+	ASSERT(root != NULL);
+	ASSERT(item != NULL);
+
+	struct pqt **prev_next_p = root;
+	while (*prev_next_p != NULL) {
+		struct pqt *p_current = *prev_next_p;
+
+		if (p_current->delay <= item->delay) {
+			item->delay -= p_current->delay;
+			prev_next_p = &(p_current->next);
+		} else {
+			item->next = p_current;
+			p_current->delay -= item->delay;
+			break;
+		}
+	}
+	*prev_next_p = item;
+}
+
+void caniot_tqueue_shift(struct pqt **root, uint32_t time_passed_ms)
+{
+	ASSERT(root != NULL);
+
+	if (time_passed_ms == 0u) return;
+
+	struct pqt **prev_next_p = root;
+	while (*prev_next_p != NULL) {
+		struct pqt *p_current = *prev_next_p;
+
+		if (p_current->delay <= time_passed_ms) {
+			if (p_current->delay != 0) {
+				time_passed_ms -= p_current->delay;
+				p_current->delay = 0;
+			}
+			prev_next_p = &(p_current->next);
+		} else {
+			p_current->delay -= time_passed_ms;
+			break;
+		}
+	}
+}
+
+struct pqt *caniot_tqueue_pop_expired(struct pqt **root)
+{
+	ASSERT(root != NULL);
+
+	struct pqt *item = NULL;
+
+	if ((*root != NULL) && ((*root)->delay == 0)) {
+		item  = *root;
+		*root = (*root)->next;
+	}
+
+	return item;
+}
+
+struct pqt *caniot_tqueue_pop(struct pqt **root)
+{
+	ASSERT(root != NULL);
+
+	struct pqt *item = NULL;
+
+	if (*root != NULL) {
+		item  = *root;
+		*root = (*root)->next;
+	}
+
+	return item;
+}
+
+bool caniot_tqueue_remove(struct pqt **root, struct pqt *item)
+{
+	ASSERT(root != NULL);
+	ASSERT(item != NULL);
+
+	struct pqt **prev_next_p = root;
+	while (*prev_next_p != NULL) {
+		struct pqt *p_current = *prev_next_p;
+		if (p_current == item) {
+			*prev_next_p = p_current->next;
+			if (p_current->next != NULL) {
+				p_current->next->delay += item->delay;
+			}
+			item->next = NULL;
+			return true;
+		}
+		prev_next_p = &(p_current->next);
+	}
+
+	return false;
+}
+
+/*____________________________________________________________________________*/
+
+#if (CANIOT_TWHEEL_LEVELS < 1) || (CANIOT_TWHEEL_LEVELS > 5)
+#error "CONFIG_CANIOT_CTRL_TWHEEL_LEVELS must be in range [1, 5]"
+#endif
+
+#define twn caniot_twheel_node
+
+static inline uint32_t level_shift(uint32_t level)
+{
+	return level * CANIOT_TWHEEL_SLOT_BITS;
+}
+
+/* Distance (in slots) from slot "index" to the next occupied slot, "index"
+ * itself being the farthest one (64). "occupied" must not be 0. */
+static inline uint32_t next_slot_distance(uint64_t occupied, uint32_t index)
+{
+	const uint32_t s   = (index + 1u) & CANIOT_TWHEEL_SLOT_MASK;
+	const uint64_t rot = s ? ((occupied >> s) | (occupied << (CANIOT_TWHEEL_SLOTS - s)))
+			       : occupied;
+
+	return 1u + (uint32_t)__builtin_ctzll(rot);
+}
+
+static void twheel_link(struct twn **head, struct twn *node)
+{
+	node->next = *head;
+	if (*head != NULL) {
+		(*head)->pprev = &node->next;
+	}
+	*head	    = node;
+	node->pprev = head;
+}
+
+static void twheel_unlink(struct caniot_twheel *wheel, struct twn *node)
+{
+	*node->pprev = node->next;
+	if (node->next != NULL) {
+		node->next->pprev = node->pprev;
+	} else if (wheel->expired_tail == &node->next) {
+		wheel->expired_tail = node->pprev;
+	}
+
+	/* If the node was the last one of its slot, mark the slot as free */
+	const uintptr_t first = (uintptr_t)&wheel->slots[0][0];
+	const uintptr_t last  = (uintptr_t)&wheel->slots[CANIOT_TWHEEL_LEVELS - 1u]
+						     [CANIOT_TWHEEL_SLOTS - 1u];
+	const uintptr_t pprev = (uintptr_t)node->pprev;
+	if ((pprev >= first) && (pprev <= last) && (*node->pprev == NULL)) {
+		const uint32_t index = (pprev - first) / sizeof(struct twn *);
+
+		wheel->occupied[index / CANIOT_TWHEEL_SLOTS] &=
+			~(1llu << (index % CANIOT_TWHEEL_SLOTS));
+	}
+
+	node->next  = NULL;
+	node->pprev = NULL;
+}
+
+static void twheel_expire(struct caniot_twheel *wheel, struct twn *node)
+{
+	node->next	     = NULL;
+	node->pprev	     = wheel->expired_tail;
+	*wheel->expired_tail = node;
+	wheel->expired_tail  = &node->next;
+}
+
+/* Place the node in the slot matching its expiry time */
+static void twheel_hash(struct caniot_twheel *wheel, struct twn *node)
+{
+	const uint32_t delta = node->expires - wheel->now;
+
+	if (delta == 0u) {
+		twheel_expire(wheel, node);
+		return;
+	}
+
+	uint32_t level = (31u - (uint32_t)__builtin_clz(delta)) / CANIOT_TWHEEL_SLOT_BITS;
+	uint32_t slot;
+
+	if (level < CANIOT_TWHEEL_LEVELS) {
+		slot = (node->expires >> level_shift(level)) & CANIOT_TWHEEL_SLOT_MASK;
+	} else {
+		/* Out of range, park the node in the farthest slot of the last level */
+		level = CANIOT_TWHEEL_LEVELS - 1u;
+		slot  = (wheel->now >> level_shift(level)) & CANIOT_TWHEEL_SLOT_MASK;
+	}
+
+	twheel_link(&wheel->slots[level][slot], node);
+	wheel->occupied[level] |= 1llu << slot;
+}
+
+/* Re-hash all nodes of a slot relatively to the current time */
+static void twheel_cascade(struct caniot_twheel *wheel, uint32_t level, uint32_t slot)
+{
+	struct twn *node = wheel->slots[level][slot];
+
+	wheel->slots[level][slot] = NULL;
+	wheel->occupied[level] &= ~(1llu << slot);
+
+	while (node != NULL) {
+		struct twn *const next = node->next;
+		twheel_hash(wheel, node);
+		node = next;
+	}
+}
+
+void caniot_twheel_init(struct caniot_twheel *wheel)
+{
+	ASSERT(wheel != NULL);
+
+	memset(wheel, 0x00u, sizeof(*wheel));
+
+	wheel->expired_tail = &wheel->expired;
+}
+
+void caniot_twheel_add(struct caniot_twheel *wheel, struct twn *node, uint32_t timeout)
+{
+	ASSERT(wheel != NULL);
+	ASSERT(node != NULL);
+
+	node->expires = wheel->now + timeout;
+
+	twheel_hash(wheel, node);
+}
+
+bool caniot_twheel_remove(struct caniot_twheel *wheel, struct twn *node)
+{
+	ASSERT(wheel != NULL);
+	ASSERT(node != NULL);
+
+	if (!caniot_twheel_node_queued(node)) return false;
+
+	twheel_unlink(wheel, node);
+
+	return true;
+}
+
+void caniot_twheel_advance(struct caniot_twheel *wheel, uint32_t time_passed_ms)
+{
+	ASSERT(wheel != NULL);
+
+	uint32_t level;
+
+	while (time_passed_ms != 0u) {
+		/* Jump to the next slot to be processed, whatever its level */
+		uint32_t step = time_passed_ms;
+		for (level = 0u; level < CANIOT_TWHEEL_LEVELS; level++) {
+			if (wheel->occupied[level] == 0u) continue;
+
+			const uint32_t shift = level_shift(level);
+			const uint32_t index = (wheel->now >> shift) & CANIOT_TWHEEL_SLOT_MASK;
+			const uint32_t dist  = next_slot_distance(wheel->occupied[level], index);
+			const uint32_t start = ((wheel->now >> shift) + dist) << shift;
+
+			step = MIN(step, start - wheel->now);
+		}
+
+		wheel->now += step;
+		time_passed_ms -= step;
+
+		/* Cascade upper levels slots reached */
+		for (level = 1u; level < CANIOT_TWHEEL_LEVELS; level++) {
+			const uint32_t shift = level_shift(level);
+
+			if ((wheel->now & ((1u << shift) - 1u)) != 0u) break;
+
+			twheel_cascade(
+				wheel, level, (wheel->now >> shift) & CANIOT_TWHEEL_SLOT_MASK);
+		}
+
+		/* Expire current slot */
+		twheel_cascade(wheel, 0u, wheel->now & CANIOT_TWHEEL_SLOT_MASK);
+	}
+}
+
+struct twn *caniot_twheel_pop_expired(struct caniot_twheel *wheel)
+{
+	ASSERT(wheel != NULL);
+
+	struct twn *node = wheel->expired;
+
+	if (node != NULL) {
+		twheel_unlink(wheel, node);
+	}
+
+	return node;
+}
+
+struct twn *caniot_twheel_pop(struct caniot_twheel *wheel)
+{
+	ASSERT(wheel != NULL);
+
+	struct twn *node = wheel->expired;
+
+	for (uint32_t level = 0u; (node == NULL) && (level < CANIOT_TWHEEL_LEVELS);
+	     level++) {
+		if (wheel->occupied[level] != 0u) {
+			const uint32_t slot = __builtin_ctzll(wheel->occupied[level]);
+			node		    = wheel->slots[level][slot];
+		}
+	}
+
+	if (node != NULL) {
+		twheel_unlink(wheel, node);
+	}
+
+	return node;
+}
+
+uint32_t caniot_twheel_next_timeout(const struct caniot_twheel *wheel)
+{
+	ASSERT(wheel != NULL);
+
+	uint32_t next_timeout = (uint32_t)-1;
+
+	if (wheel->expired != NULL) return 0u;
+
+	/* The earliest node of each level is in its next occupied slot */
+	for (uint32_t level = 0u; level < CANIOT_TWHEEL_LEVELS; level++) {
+		if (wheel->occupied[level] == 0u) continue;
+
+		const uint32_t index =
+			(wheel->now >> level_shift(level)) & CANIOT_TWHEEL_SLOT_MASK;
+		const uint32_t slot =
+			(index + next_slot_distance(wheel->occupied[level], index)) &
+			CANIOT_TWHEEL_SLOT_MASK;
+
+		const struct twn *node;
+		for (node = wheel->slots[level][slot]; node != NULL; node = node->next) {
+			next_timeout = MIN(next_timeout, node->expires - wheel->now);
+		}
+	}
+
+	return next_timeout;
+}
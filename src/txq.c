@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <caniot/caniot_private.h>
+#include <caniot/txq.h>
+
+#if CONFIG_CANIOT_TXQ
+
+#include <string.h>
+
+/* Whether "a" leaves before "b", both being released */
+static bool txq_before(const struct caniot_txq_item *a, const struct caniot_txq_item *b)
+{
+	if (a->can_id != b->can_id) return a->can_id < b->can_id;
+
+	return (int16_t)(a->seq - b->seq) < 0;
+}
+
+static bool txq_released(const struct caniot_txq_item *item, uint32_t now_ms)
+{
+	return (int32_t)(now_ms - item->release_ms) >= 0;
+}
+
+void caniot_txq_init(struct caniot_txq *txq)
+{
+	ASSERT(txq != NULL);
+
+	txq->count = 0u;
+	txq->seq   = 0u;
+	memset(&txq->stats, 0x00u, sizeof(txq->stats));
+}
+
+int caniot_txq_push(struct caniot_txq *txq,
+		    const struct caniot_frame *frame,
+		    uint32_t now_ms,
+		    uint32_t delay_ms,
+		    uint32_t owner)
+{
+	ASSERT(txq != NULL);
+	ASSERT(frame != NULL);
+
+	if (txq->count >= CONFIG_CANIOT_TXQ_SIZE) {
+		txq->stats.full++;
+		return -CANIOT_EAGAIN;
+	}
+
+	struct caniot_txq_item *const item = &txq->items[txq->count++];
+
+	item->frame	 = *frame;
+	item->release_ms = now_ms + delay_ms;
+	item->can_id	 = caniot_id_to_canid(frame->id);
+	item->seq	 = txq->seq++;
+	item->owner	 = owner;
+
+	txq->stats.queued++;
+	if (txq->count > txq->stats.high_watermark) {
+		txq->stats.high_watermark = txq->count;
+	}
+
+	return 0;
+}
+
+struct caniot_txq_item *caniot_txq_peek(struct caniot_txq *txq, uint32_t now_ms)
+{
+	ASSERT(txq != NULL);
+
+	struct caniot_txq_item *next = NULL;
+
+	for (uint8_t i = 0u; i < txq->count; i++) {
+		struct caniot_txq_item *const item = &txq->items[i];
+
+		if (!txq_released(item, now_ms)) continue;
+
+		if ((next == NULL) || txq_before(item, next)) {
+			next = item;
+		}
+	}
+
+	return next;
+}
+
+void caniot_txq_remove(struct caniot_txq *txq, struct caniot_txq_item *item)
+{
+	ASSERT(txq != NULL);
+	ASSERT((item >= txq->items) && (item < &txq->items[txq->count]));
+
+	/* order is given by the items, not by their position */
+	*item = txq->items[--txq->count];
+}
+
+void caniot_txq_disown(struct caniot_txq *txq, uint32_t owner)
+{
+	ASSERT(txq != NULL);
+
+	for (uint8_t i = 0u; i < txq->count; i++) {
+		if (txq->items[i].owner == owner) {
+			txq->items[i].owner = 0u;
+		}
+	}
+}
+
+uint32_t caniot_txq_next_release(const struct caniot_txq *txq, uint32_t now_ms)
+{
+	ASSERT(txq != NULL);
+
+	uint32_t next = UINT32_MAX;
+
+	for (uint8_t i = 0u; i < txq->count; i++) {
+		const struct caniot_txq_item *const item = &txq->items[i];
+
+		if (txq_released(item, now_ms)) return 0u;
+
+		next = MIN(next, item->release_ms - now_ms);
+	}
+
+	return next;
+}
+
+#endif /* CONFIG_CANIOT_TXQ */
@@ -4,16 +4,28 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
 
+#include <caniot/busload.h>
 #include <caniot/caniot_private.h>
 #include <caniot/controller.h>
+#include <caniot/ctrl_evq.h>
+#include <caniot/ctrl_group.h>
 #include <caniot/device.h>
+#include <caniot/socketcan.h>
+#include <caniot/txq.h>
+
+#if CONFIG_CANIOT_SOCKETCAN
+#include <linux/can.h>
+#include <sys/socket.h>
+#endif
 
 #define SEED 0
 
@@ -277,7 +289,7 @@ struct z_func_ctrl_test_ctx {
 	struct caniot_frame req;
 	struct caniot_frame resp;
 	const caniot_did_t did;
-	uint8_t handle;
+	caniot_handle_t handle;
 	bool success;
 	bool terminated;
 
@@ -344,7 +356,7 @@ bool z_func_ctrl1(void)
 	CHECK_0(caniot_controller_rx_frame(&x.ctrl, 1000U, NULL));
 	CHECK(caniot_controller_query_pending(&x.ctrl, x.handle) == false);
 	CHECK(x.ctrl.pendingq.pending_devices_bf == 0U);
-	CHECK(x.ctrl.pendingq.timeout_queue == NULL);
+	CHECK(caniot_controller_next_timeout(&x.ctrl) == CANIOT_TIMEOUT_FOREVER);
 	CHECK(caniot_controller_dbg_free_pendq(&x.ctrl) ==
 	      CONFIG_CANIOT_MAX_PENDING_QUERIES);
 
@@ -379,7 +391,7 @@ bool z_func_ctrl2(void)
 	CHECK_0(caniot_controller_rx_frame(&x.ctrl, 1000U, &x.resp));
 	CHECK(caniot_controller_query_pending(&x.ctrl, x.handle) == false);
 	CHECK(x.ctrl.pendingq.pending_devices_bf == 0U);
-	CHECK(x.ctrl.pendingq.timeout_queue == NULL);
+	CHECK(caniot_controller_next_timeout(&x.ctrl) == CANIOT_TIMEOUT_FOREVER);
 	CHECK(caniot_controller_dbg_free_pendq(&x.ctrl) ==
 	      CONFIG_CANIOT_MAX_PENDING_QUERIES);
 
@@ -417,7 +429,7 @@ bool z_func_ctrl3(void)
 	CHECK_0(caniot_controller_rx_frame(&x.ctrl, 1000U, &x.resp));
 	CHECK(caniot_controller_query_pending(&x.ctrl, x.handle) == false);
 	CHECK(x.ctrl.pendingq.pending_devices_bf == 0U);
-	CHECK(x.ctrl.pendingq.timeout_queue == NULL);
+	CHECK(caniot_controller_next_timeout(&x.ctrl) == CANIOT_TIMEOUT_FOREVER);
 	CHECK(caniot_controller_dbg_free_pendq(&x.ctrl) ==
 	      CONFIG_CANIOT_MAX_PENDING_QUERIES);
 
@@ -450,7 +462,7 @@ bool z_func_ctrl4(void)
 	CHECK(caniot_controller_query_pending(&x.ctrl, x.handle) == false);
 	CHECK_0(caniot_controller_rx_frame(&x.ctrl, 1000U, NULL));
 	CHECK(x.ctrl.pendingq.pending_devices_bf == 0U);
-	CHECK(x.ctrl.pendingq.timeout_queue == NULL);
+	CHECK(caniot_controller_next_timeout(&x.ctrl) == CANIOT_TIMEOUT_FOREVER);
 	CHECK(caniot_controller_dbg_free_pendq(&x.ctrl) ==
 	      CONFIG_CANIOT_MAX_PENDING_QUERIES);
 
@@ -486,13 +498,2590 @@ bool z_func_dev0(void)
 	CHECK_0(caniot_controller_rx_frame(&x.ctrl, 1000U, &x.resp));
 	CHECK(caniot_controller_query_pending(&x.ctrl, x.handle) == false);
 	CHECK(x.ctrl.pendingq.pending_devices_bf == 0U);
-	CHECK(x.ctrl.pendingq.timeout_queue == NULL);
+	CHECK(caniot_controller_next_timeout(&x.ctrl) == CANIOT_TIMEOUT_FOREVER);
 	CHECK(caniot_controller_dbg_free_pendq(&x.ctrl) ==
 	      CONFIG_CANIOT_MAX_PENDING_QUERIES);
 
 	return x.success == true;
 }
 
+/* Drivers stubs: nothing to receive, sent frames are counted. Only built
+ * with the features whose tests use them. */
+#define STUB_SEND_USED                                                                   \
+	(CONFIG_CANIOT_CTRL_CACHE || CONFIG_CANIOT_CTRL_COALESCE ||                      \
+	 CONFIG_CANIOT_CTRL_RETRY || CONFIG_CANIOT_CTRL_RTT ||                           \
+	 CONFIG_CANIOT_CTRL_METRICS || CONFIG_CANIOT_BUSLOAD ||                          \
+	 CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE ||                                          \
+	 (CONFIG_CANIOT_CTRL_BCAST_EXPECT && CONFIG_CANIOT_CONTROLLER_DISCOVERY))
+
+#define STUB_DRIVERS_USED                                                                \
+	(STUB_SEND_USED || CONFIG_CANIOT_DRIVERS_BURST_SIZE ||                           \
+	 CONFIG_CANIOT_CTRL_BULK || CONFIG_CANIOT_CTRL_SCHED || CONFIG_CANIOT_TXQ ||     \
+	 CONFIG_CANIOT_CTRL_GROUP)
+
+#if STUB_DRIVERS_USED
+
+static void stub_get_time(uint32_t *sec, uint16_t *ms)
+{
+	*sec = 0u;
+	if (ms != NULL) *ms = 0u;
+}
+
+static int stub_recv(struct caniot_frame *frame)
+{
+	(void)frame;
+
+	return -CANIOT_EAGAIN;
+}
+
+#endif
+
+#if STUB_SEND_USED
+
+static uint32_t stub_sent;
+
+static int stub_send(const struct caniot_frame *frame, uint32_t delay_ms)
+{
+	(void)frame;
+	(void)delay_ms;
+
+	stub_sent++;
+
+	return 0;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+
+struct z_func_ctrl_broadcast_ctx {
+	uint32_t count;
+	uint32_t terminated;
+};
+
+static bool z_func_ctrl_broadcast_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	struct z_func_ctrl_broadcast_ctx *x = user_data;
+
+	x->count++;
+	x->terminated += ev->terminated;
+
+	return true;
+}
+
+/* Check a broadcast query completes once all expected devices responded */
+bool z_func_ctrl_broadcast_expect(void)
+{
+	struct caniot_controller ctrl;
+	struct z_func_ctrl_broadcast_ctx x = {0};
+	struct caniot_frame req, resp;
+	int h;
+
+	/* DIDs 30 and 62 share the same bit of a 32-bit bitfield */
+	const caniot_did_t did1 = CANIOT_DID(CANIOT_DEVICE_CLASS6, CANIOT_DEVICE_SID7);
+	const caniot_did_t did2 = CANIOT_DID(CANIOT_DEVICE_CLASS6, CANIOT_DEVICE_SID3);
+	const caniot_did_t did3 = CANIOT_DID(CANIOT_DEVICE_CLASS0, CANIOT_DEVICE_SID1);
+
+	CHECK_0(caniot_controller_init(&ctrl, z_func_ctrl_broadcast_cb, &x));
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	h = caniot_controller_query_register(&ctrl, CANIOT_DID_BROADCAST, &req, 1000u);
+	CHECK_STRICTLY_POSITIVE(h);
+	CHECK_0(caniot_controller_query_expect(&ctrl, h, (1llu << did1) | (1llu << did2)));
+
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+
+	/* unexpected device, then the first expected one twice */
+	resp.id.cls = CANIOT_DID_CLS(did3);
+	resp.id.sid = CANIOT_DID_SID(did3);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, &resp));
+	resp.id.cls = CANIOT_DID_CLS(did1);
+	resp.id.sid = CANIOT_DID_SID(did1);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, &resp));
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, &resp));
+	CHECK(x.count == 2u);
+	CHECK(x.terminated == 0u);
+	CHECK(caniot_controller_query_pending(&ctrl, h) == true);
+
+	/* last expected device, long before the timeout */
+	resp.id.cls = CANIOT_DID_CLS(did2);
+	resp.id.sid = CANIOT_DID_SID(did2);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, &resp));
+	CHECK(x.count == 3u);
+	CHECK(x.terminated == 1u);
+	CHECK(caniot_controller_query_pending(&ctrl, h) == false);
+
+	/* no timeout event */
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1000u, NULL));
+	CHECK(x.count == 3u);
+
+	/* only broadcast queries can expect devices */
+	h = caniot_controller_query_register(&ctrl, did1, &req, 1000u);
+	CHECK_STRICTLY_POSITIVE(h);
+	CHECK(caniot_controller_query_expect(&ctrl, h, 1llu << did1) == -CANIOT_EINVAL);
+
+	const int free = caniot_controller_dbg_free_pendq(&ctrl);
+	CHECK(free == CONFIG_CANIOT_MAX_PENDING_QUERIES - 1);
+
+	return true;
+}
+
+#if CONFIG_CANIOT_CONTROLLER_DISCOVERY && CONFIG_CANIOT_CTRL_DRIVERS_API
+
+struct z_func_ctrl_discovery_ctx {
+	uint32_t orphans;
+	uint32_t terminated;
+	caniot_controller_event_t last;
+};
+
+static bool z_func_ctrl_discovery_ev_cb(const caniot_controller_event_t *ev,
+					void *user_data)
+{
+	struct z_func_ctrl_discovery_ctx *x = user_data;
+
+	if (ev->context == CANIOT_CONTROLLER_EVENT_CONTEXT_ORPHAN) {
+		x->orphans++;
+	} else if (ev->terminated) {
+		x->terminated++;
+		x->last = *ev;
+	}
+
+	return true;
+}
+
+static bool z_func_ctrl_discovery_cb(struct caniot_controller *ctrl,
+				     caniot_did_t did,
+				     const struct caniot_frame *frame,
+				     void *user_data)
+{
+	(void)ctrl;
+	(void)did;
+	(void)frame;
+
+	(*(uint32_t *)user_data)++;
+
+	return true;
+}
+
+/* Check an active discovery expecting devices terminates its query with an
+ * event once all of them responded */
+bool z_func_ctrl_discovery_expect(void)
+{
+	struct caniot_controller ctrl;
+	struct z_func_ctrl_discovery_ctx x = {0};
+	uint32_t discovered		   = 0u;
+	struct caniot_frame resp;
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = stub_send,
+		.recv	  = stub_recv,
+	};
+	const struct caniot_discovery_params params = {
+		.mode	       = CANIOT_DISCOVERY_MODE_ACTIVE,
+		.type	       = CANIOT_DISCOVERY_TYPE_TELEMETRY,
+		.timeout       = 1000u,
+		.expected      = (1llu << 5u) | (1llu << 9u),
+		.user_callback = z_func_ctrl_discovery_cb,
+		.user_data     = &discovered,
+		.data.endpoint = CANIOT_ENDPOINT_APP,
+	};
+
+	CHECK_0(caniot_controller_driv_init(
+		&ctrl, &driv, z_func_ctrl_discovery_ev_cb, &x));
+
+	/* the handle of the discovery query is returned */
+	const int h = caniot_controller_discovery_start(&ctrl, &params);
+	CHECK_STRICTLY_POSITIVE(h);
+
+	caniot_build_query_telemetry(&resp, CANIOT_ENDPOINT_APP);
+	resp.id.query = CANIOT_RESPONSE;
+
+	resp.id.cls = CANIOT_DID_CLS(5u);
+	resp.id.sid = CANIOT_DID_SID(5u);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, &resp));
+	CHECK(x.terminated == 0u);
+	CHECK(caniot_controller_discovery_running(&ctrl));
+
+	resp.id.cls = CANIOT_DID_CLS(9u);
+	resp.id.sid = CANIOT_DID_SID(9u);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, &resp));
+	CHECK(discovered == 2u);
+	CHECK(x.orphans == 2u);
+	CHECK(x.terminated == 1u);
+	CHECK(x.last.context == CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY);
+	CHECK(x.last.status == CANIOT_CONTROLLER_EVENT_STATUS_OK);
+	CHECK(x.last.handle == (caniot_handle_t)h);
+	CHECK(x.last.response == NULL);
+	CHECK(!caniot_controller_discovery_running(&ctrl));
+	CHECK(caniot_controller_query_pending(&ctrl, (caniot_handle_t)h) == false);
+
+	/* no timeout event */
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1000u, NULL));
+	CHECK(x.terminated == 1u);
+
+	return true;
+}
+
+#endif
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+
+struct z_func_ctrl_aggregate_ctx {
+	uint32_t count;
+	caniot_controller_event_status_t status;
+	uint64_t responders;
+};
+
+static bool z_func_ctrl_aggregate_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	struct z_func_ctrl_aggregate_ctx *x = user_data;
+
+	TEST_ASSERT(ev->terminated == 1u);
+	TEST_ASSERT(ev->response == NULL);
+
+	x->count++;
+	x->status     = ev->status;
+	x->responders = ev->responders;
+
+	return true;
+}
+
+/* Check responses to an aggregated broadcast query are reported at once */
+bool z_func_ctrl_aggregate(void)
+{
+	struct caniot_controller ctrl;
+	struct z_func_ctrl_aggregate_ctx x = {0};
+	struct caniot_frame results[CANIOT_DID_MAX_COUNT];
+	struct caniot_frame req, resp;
+	uint64_t responded = 0u;
+	int h;
+
+	CHECK_0(caniot_controller_init(&ctrl, z_func_ctrl_aggregate_cb, &x));
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+	resp.len      = 1u;
+
+	/* all devices but one respond, the query terminates on timeout */
+	h = caniot_controller_query_register(&ctrl, CANIOT_DID_BROADCAST, &req, 100u);
+	CHECK_STRICTLY_POSITIVE(h);
+	CHECK_0(caniot_controller_query_aggregate(&ctrl, h, results));
+
+	for (caniot_did_t did = 1u; did < CANIOT_DID_MAX_COUNT; did++) {
+		resp.id.cls = CANIOT_DID_CLS(did);
+		resp.id.sid = CANIOT_DID_SID(did);
+		resp.buf[0] = did;
+		CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, &resp));
+		responded |= 1llu << did;
+	}
+	CHECK(x.count == 0u);
+
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 100u, NULL));
+	CHECK(x.count == 1u);
+	CHECK(x.status == CANIOT_CONTROLLER_EVENT_STATUS_TIMEOUT);
+	CHECK(x.responders == responded);
+	for (caniot_did_t did = 1u; did < CANIOT_DID_MAX_COUNT; did++) {
+		CHECK(results[did].buf[0] == did);
+		CHECK(CANIOT_DID(results[did].id.cls, results[did].id.sid) == did);
+	}
+
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+	/* all expected devices respond */
+	h = caniot_controller_query_register(&ctrl, CANIOT_DID_BROADCAST, &req, 100u);
+	CHECK_STRICTLY_POSITIVE(h);
+	CHECK_0(caniot_controller_query_aggregate(&ctrl, h, results));
+	CHECK_0(caniot_controller_query_expect(&ctrl, h, 0x3llu << 60u));
+
+	resp.id.cls = CANIOT_DID_CLS(60u);
+	resp.id.sid = CANIOT_DID_SID(60u);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, &resp));
+	resp.id.cls = CANIOT_DID_CLS(61u);
+	resp.id.sid = CANIOT_DID_SID(61u);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, &resp));
+
+	CHECK(x.count == 2u);
+	CHECK(x.status == CANIOT_CONTROLLER_EVENT_STATUS_OK);
+	CHECK(x.responders == (0x3llu << 60u));
+	CHECK(caniot_controller_query_pending(&ctrl, h) == false);
+#endif
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_PIPELINE_DEPTH > 1
+
+struct z_func_ctrl_pipeline_ctx {
+	caniot_handle_t handles[CONFIG_CANIOT_CTRL_PIPELINE_DEPTH];
+	uint32_t count;
+};
+
+static bool z_func_ctrl_pipeline_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	struct z_func_ctrl_pipeline_ctx *x = user_data;
+
+	TEST_ASSERT(ev->context == CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY);
+	TEST_ASSERT(ev->status == CANIOT_CONTROLLER_EVENT_STATUS_OK);
+	TEST_ASSERT(x->count < ARRAY_SIZE(x->handles));
+
+	x->handles[x->count++] = ev->handle;
+
+	return true;
+}
+
+/* Check several queries can be pending for the same device, and that responses
+ * are matched by attribute key first, then in the order queries were sent */
+bool z_func_ctrl_pipeline(void)
+{
+	struct caniot_controller ctrl;
+	struct z_func_ctrl_pipeline_ctx x = {.count = 0u};
+	struct caniot_frame req, resp;
+	int h1, h2, h3;
+	const caniot_did_t did = gen_rdm_did(false);
+
+	CHECK_0(caniot_controller_init(&ctrl, z_func_ctrl_pipeline_cb, &x));
+
+	caniot_build_query_read_attribute(&req, 0x1010u);
+	CHECK_STRICTLY_POSITIVE(h1 = caniot_controller_query_register(&ctrl, did, &req, 1000u));
+	CHECK_STRICTLY_POSITIVE(h2 = caniot_controller_query_register(&ctrl, did, &req, 1000u));
+	caniot_build_query_read_attribute(&req, 0x1020u);
+	CHECK_STRICTLY_POSITIVE(h3 = caniot_controller_query_register(&ctrl, did, &req, 500u));
+	CHECK(caniot_controller_query_register(&ctrl, did, &req, 1000u) == -CANIOT_EBUSY);
+
+	/* Answer to the last query first */
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+	resp.attr.key = 0x1020u;
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+	resp.attr.key = 0x1010u;
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+	CHECK(ctrl.pendingq.pending_devices_bf != 0u);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+
+	CHECK(x.count == 3u);
+	CHECK((int)x.handles[0] == h3);
+	CHECK((int)x.handles[1] == h1);
+	CHECK((int)x.handles[2] == h2);
+	CHECK(ctrl.pendingq.pending_devices_bf == 0u);
+	const int free = caniot_controller_dbg_free_pendq(&ctrl);
+	CHECK(free == CONFIG_CANIOT_MAX_PENDING_QUERIES);
+
+	return true;
+}
+
+#endif
+
+static bool z_func_ctrl_forever_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	int *handle = user_data;
+
+	TEST_ASSERT(ev->context == CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY);
+	TEST_ASSERT(ev->status == CANIOT_CONTROLLER_EVENT_STATUS_OK);
+
+	*handle = ev->handle;
+
+	return true;
+}
+
+/* Check a query without timeout is matched by its response */
+bool z_func_ctrl_forever(void)
+{
+	struct caniot_controller ctrl;
+	struct caniot_frame req, resp;
+	int handle = 0, h;
+	const caniot_did_t did = gen_rdm_did(false);
+
+	CHECK_0(caniot_controller_init(&ctrl, z_func_ctrl_forever_cb, &handle));
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	CHECK_STRICTLY_POSITIVE(
+		h = caniot_controller_query_register(&ctrl, did, &req, CANIOT_TIMEOUT_FOREVER));
+	CHECK(ctrl.pendingq.pending_devices_bf == (1llu << did));
+
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 100000u, NULL));
+	CHECK(handle == 0);
+
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+	resp.id.cls   = CANIOT_DID_CLS(did);
+	resp.id.sid   = CANIOT_DID_SID(did);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+
+	CHECK(handle == h);
+	CHECK(ctrl.pendingq.pending_devices_bf == 0u);
+	const int free = caniot_controller_dbg_free_pendq(&ctrl);
+	CHECK(free == CONFIG_CANIOT_MAX_PENDING_QUERIES);
+
+	return true;
+}
+
+struct z_func_ctrl_rx_frames_ctx {
+	caniot_controller_event_status_t status[2u];
+	caniot_handle_t handles[2u];
+	uint32_t count;
+};
+
+static bool z_func_ctrl_rx_frames_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	struct z_func_ctrl_rx_frames_ctx *x = user_data;
+
+	TEST_ASSERT(x->count < ARRAY_SIZE(x->handles));
+
+	x->status[x->count]    = ev->status;
+	x->handles[x->count++] = ev->handle;
+
+	return true;
+}
+
+/* Check a burst of frames is dispatched before the queue is aged */
+bool z_func_ctrl_rx_frames(void)
+{
+	struct caniot_controller ctrl;
+	struct z_func_ctrl_rx_frames_ctx x = {.count = 0u};
+	struct caniot_frame req, frames[2u];
+	int h1, h2;
+	const caniot_did_t did1 = CANIOT_DID(CANIOT_DEVICE_CLASS1, CANIOT_DEVICE_SID2);
+	const caniot_did_t did2 = CANIOT_DID(CANIOT_DEVICE_CLASS3, CANIOT_DEVICE_SID5);
+
+	CHECK_0(caniot_controller_init(&ctrl, z_func_ctrl_rx_frames_cb, &x));
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_BOARD_CONTROL);
+	CHECK_STRICTLY_POSITIVE(h1 = caniot_controller_query_register(&ctrl, did1, &req, 50u));
+	CHECK_STRICTLY_POSITIVE(h2 = caniot_controller_query_register(&ctrl, did2, &req, 50u));
+
+	/* A query frame (skipped) and the response to the first query */
+	frames[0]	    = req;
+	frames[1]	    = req;
+	frames[1].id.query = CANIOT_RESPONSE;
+	frames[1].id.cls   = CANIOT_DID_CLS(did1);
+	frames[1].id.sid   = CANIOT_DID_SID(did1);
+
+	CHECK(caniot_controller_rx_frames(&ctrl, 100u, frames, 2u) == 1);
+
+	CHECK(x.count == 2u);
+	CHECK((int)x.handles[0] == h1);
+	CHECK(x.status[0] == CANIOT_CONTROLLER_EVENT_STATUS_OK);
+	CHECK((int)x.handles[1] == h2);
+	CHECK(x.status[1] == CANIOT_CONTROLLER_EVENT_STATUS_TIMEOUT);
+	const int free = caniot_controller_dbg_free_pendq(&ctrl);
+	CHECK(free == CONFIG_CANIOT_MAX_PENDING_QUERIES);
+
+	CHECK(caniot_controller_rx_frames(&ctrl, 10u, NULL, 0u) == 0);
+
+	return true;
+}
+
+#if CONFIG_CANIOT_DRIVERS_BURST_SIZE
+
+#define BURST_TEST_FRAMES (2u * CONFIG_CANIOT_DRIVERS_BURST_SIZE + 3u)
+
+static uint32_t burst_test_received;
+static uint32_t burst_test_calls;
+
+static int burst_test_recv_burst(struct caniot_frame *frames, size_t max)
+{
+	const uint32_t count = MIN(max, BURST_TEST_FRAMES - burst_test_received);
+
+	burst_test_calls++;
+
+	/* every third frame is a query of another controller */
+	for (uint32_t i = 0u; i < count; i++) {
+		caniot_build_query_telemetry(&frames[i], CANIOT_ENDPOINT_APP);
+		if ((burst_test_received + i) % 3u != 0u) {
+			frames[i].id.query = CANIOT_RESPONSE;
+		}
+	}
+	burst_test_received += count;
+
+	return count;
+}
+
+static bool z_func_ctrl_recv_burst_cb(const caniot_controller_event_t *ev,
+				      void *user_data)
+{
+	TEST_ASSERT(ev->context == CANIOT_CONTROLLER_EVENT_CONTEXT_ORPHAN);
+
+	(*(uint32_t *)user_data)++;
+
+	return true;
+}
+
+/* Check caniot_controller_process() drains the driver by bursts, skipping the
+ * frames which are not for the controller */
+bool z_func_ctrl_recv_burst(void)
+{
+	struct caniot_controller ctrl;
+	uint32_t events = 0u;
+	const struct caniot_drivers_api driv = {
+		.get_time   = stub_get_time,
+		.recv	    = stub_recv,
+		.recv_burst = burst_test_recv_burst,
+	};
+
+	burst_test_received = 0u;
+	burst_test_calls    = 0u;
+
+	CHECK_0(caniot_controller_driv_init(&ctrl, &driv, z_func_ctrl_recv_burst_cb, &events));
+	CHECK_0(caniot_controller_process(&ctrl));
+
+	CHECK(events == BURST_TEST_FRAMES - (BURST_TEST_FRAMES + 2u) / 3u);
+	CHECK(burst_test_calls == 3u);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_CACHE
+
+struct z_func_ctrl_cache_ctx {
+	caniot_controller_event_context_t context;
+	struct caniot_frame response;
+	void *query_user_data;
+	uint32_t count;
+};
+
+static bool z_func_ctrl_cache_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	struct z_func_ctrl_cache_ctx *x = user_data;
+
+	x->context	   = ev->context;
+	x->query_user_data = ev->user_data;
+	if (ev->response != NULL) x->response = *ev->response;
+	x->count++;
+
+	return true;
+}
+
+/* Check responses are cached, and that cached values are returned (without
+ * sending a query) only if they are young enough */
+bool z_func_ctrl_cache(void)
+{
+	struct caniot_controller ctrl;
+	struct z_func_ctrl_cache_ctx x = {.count = 0u};
+	struct caniot_frame req, resp;
+	const caniot_did_t did		     = gen_rdm_did(false);
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = stub_send,
+		.recv	  = stub_recv,
+	};
+
+	CHECK_0(caniot_controller_driv_init(&ctrl, &driv, z_func_ctrl_cache_cb, &x));
+
+	/* Orphan telemetry response */
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+	resp.id.cls   = CANIOT_DID_CLS(did);
+	resp.id.sid   = CANIOT_DID_SID(did);
+	resp.len      = 3u;
+	resp.buf[0]   = 1u;
+	resp.buf[1]   = 2u;
+	resp.buf[2]   = 3u;
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 50u, NULL));
+	CHECK(x.context == CANIOT_CONTROLLER_EVENT_CONTEXT_ORPHAN);
+
+	stub_sent = 0u;
+	x.count	  = 0u;
+
+	/* Young enough: completed from the cache */
+	CHECK_0(caniot_controller_query_cached(&ctrl, did, &req, 1000u, 100u, &resp));
+	CHECK(stub_sent == 0u);
+	CHECK(x.count == 1u);
+	CHECK(x.context == CANIOT_CONTROLLER_EVENT_CONTEXT_CACHE);
+	CHECK(x.query_user_data == &resp);
+	CHECK(x.response.len == 3u);
+	CHECK(memcmp(x.response.buf, resp.buf, 3u) == 0);
+	CHECK(CANIOT_DID(x.response.id.cls, x.response.id.sid) == did);
+
+	/* Too old: the query is sent */
+	const int handle =
+		caniot_controller_query_cached(&ctrl, did, &req, 1000u, 20u, &x);
+	CHECK_STRICTLY_POSITIVE(handle);
+	CHECK(stub_sent == 1u);
+	CHECK(x.count == 1u);
+	CHECK(caniot_controller_query_user_data_get(&ctrl, handle) == &x);
+
+	/* Orphan read-attribute response */
+	caniot_build_query_read_attribute(&req, 0x1010u);
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+	resp.id.cls   = CANIOT_DID_CLS(did);
+	resp.id.sid   = CANIOT_DID_SID(did);
+	resp.len      = 6u;
+	resp.attr.val = 42u;
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+
+	CHECK_0(caniot_controller_cache_lookup(&ctrl, did, &req, 100u, &resp));
+	CHECK(resp.attr.key == 0x1010u);
+	CHECK(resp.attr.val == 42u);
+
+	caniot_build_query_read_attribute(&req, 0x1020u);
+	CHECK(caniot_controller_cache_lookup(&ctrl, did, &req, 100u, &resp) ==
+	      -CANIOT_ENOATTR);
+
+	caniot_build_query_write_attribute(&req, 0x1010u, 0u);
+	CHECK(caniot_controller_cache_lookup(&ctrl, did, &req, 100u, &resp) ==
+	      -CANIOT_ENOTSUP);
+
+	caniot_controller_cache_invalidate(&ctrl, did);
+	caniot_build_query_read_attribute(&req, 0x1010u);
+	CHECK(caniot_controller_cache_lookup(&ctrl, did, &req, 100u, &resp) ==
+	      -CANIOT_ENOATTR);
+
+	caniot_controller_deinit(&ctrl);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_COALESCE
+
+struct z_func_ctrl_coalesce_ctx {
+	caniot_controller_event_status_t status[4u];
+	caniot_handle_t handles[4u];
+	void *user_data[4u];
+	uint32_t count;
+};
+
+static bool z_func_ctrl_coalesce_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	struct z_func_ctrl_coalesce_ctx *x = user_data;
+
+	TEST_ASSERT(ev->context == CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY);
+	TEST_ASSERT(x->count < ARRAY_SIZE(x->handles));
+
+	x->status[x->count]    = ev->status;
+	x->user_data[x->count] = ev->user_data;
+	x->handles[x->count++] = ev->handle;
+
+	return true;
+}
+
+/* Check identical queries share a single frame and are all completed by its
+ * response, even if the query which sent the frame is cancelled or timed out */
+bool z_func_ctrl_coalesce(void)
+{
+	struct caniot_controller ctrl;
+	struct z_func_ctrl_coalesce_ctx x = {.count = 0u};
+	struct caniot_frame req, resp;
+	int h1, h2, h3, h4;
+	const caniot_did_t did		     = gen_rdm_did(false);
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = stub_send,
+		.recv	  = stub_recv,
+	};
+
+	CHECK_0(caniot_controller_driv_init(&ctrl, &driv, z_func_ctrl_coalesce_cb, &x));
+	stub_sent = 0u;
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	CHECK_STRICTLY_POSITIVE(h1 = caniot_controller_query(&ctrl, did, &req, 100u));
+	CHECK_STRICTLY_POSITIVE(h2 = caniot_controller_query(&ctrl, did, &req, 200u));
+	CHECK_STRICTLY_POSITIVE(h3 = caniot_controller_query(&ctrl, did, &req, 200u));
+	CHECK(stub_sent == 1u);
+	CHECK_0(caniot_controller_query_user_data_set(&ctrl, h2, &h2));
+
+	/* A different query is sent */
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_BOARD_CONTROL);
+	CHECK_STRICTLY_POSITIVE(h4 = caniot_controller_query(&ctrl, did, &req, 200u));
+	CHECK(stub_sent == 2u);
+	CHECK(caniot_controller_dbg_free_pendq(&ctrl) == 0);
+
+	/* The query which sent the frame times out, the others keep waiting */
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 150u, NULL));
+	CHECK(x.count == 1u);
+	CHECK((int)x.handles[0] == h1);
+	CHECK(x.status[0] == CANIOT_CONTROLLER_EVENT_STATUS_TIMEOUT);
+	CHECK(caniot_controller_query_pending(&ctrl, h2));
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+	resp.id.cls   = CANIOT_DID_CLS(did);
+	resp.id.sid   = CANIOT_DID_SID(did);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+
+	CHECK(x.count == 3u);
+	CHECK((int)x.handles[1] == h2);
+	CHECK(x.user_data[1] == &h2);
+	CHECK(x.status[1] == CANIOT_CONTROLLER_EVENT_STATUS_OK);
+	CHECK((int)x.handles[2] == h3);
+	CHECK(x.status[2] == CANIOT_CONTROLLER_EVENT_STATUS_OK);
+	CHECK(caniot_controller_query_pending(&ctrl, h4));
+	CHECK_0(caniot_controller_query_cancel(&ctrl, h4, false));
+
+	/* Cancelling the query which sent the frame */
+	x.count = 0u;
+	CHECK_STRICTLY_POSITIVE(h1 = caniot_controller_query(&ctrl, did, &req, 100u));
+	CHECK_STRICTLY_POSITIVE(h2 = caniot_controller_query(&ctrl, did, &req, 100u));
+	CHECK(stub_sent == 3u);
+	CHECK_0(caniot_controller_query_cancel(&ctrl, h1, false));
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+
+	CHECK(x.count == 2u);
+	CHECK((int)x.handles[0] == h1);
+	CHECK(x.status[0] == CANIOT_CONTROLLER_EVENT_STATUS_CANCELLED);
+	CHECK((int)x.handles[1] == h2);
+	CHECK(x.status[1] == CANIOT_CONTROLLER_EVENT_STATUS_OK);
+
+	CHECK(ctrl.pendingq.pending_devices_bf == 0u);
+	const int free = caniot_controller_dbg_free_pendq(&ctrl);
+	CHECK(free == CONFIG_CANIOT_MAX_PENDING_QUERIES);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_RETRY
+
+/* Check a query is sent again after each timeout and backoff, and that
+ * TIMEOUT is only reported after the last attempt */
+bool z_func_ctrl_retry(void)
+{
+	struct caniot_controller ctrl;
+	struct z_func_ctrl_rx_frames_ctx x = {.count = 0u};
+	struct caniot_frame req, resp;
+	int h;
+	const caniot_did_t did		     = gen_rdm_did(false);
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = stub_send,
+		.recv	  = stub_recv,
+	};
+	const struct caniot_retry_policy policy = {
+		.max_attempts = 3u,
+		.multiplier   = 2u,
+		.backoff_ms   = 50u,
+		.jitter_ms    = 0u,
+	};
+
+	CHECK_0(caniot_controller_driv_init(&ctrl, &driv, z_func_ctrl_rx_frames_cb, &x));
+	stub_sent = 0u;
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	h = caniot_controller_query_retry(&ctrl, did, &req, 0u, &policy);
+	CHECK(h == -CANIOT_EINVAL);
+	h = caniot_controller_query_retry(&ctrl, did, &req, 100u, &policy);
+	CHECK_STRICTLY_POSITIVE(h);
+	CHECK(stub_sent == 1u);
+
+	/* first timeout, then backoff of 50 ms */
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 100u, NULL));
+	CHECK(stub_sent == 1u);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 50u, NULL));
+	CHECK(stub_sent == 2u);
+
+	/* second timeout, then backoff of 100 ms */
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 100u, NULL));
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 99u, NULL));
+	CHECK(stub_sent == 2u);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, NULL));
+	CHECK(stub_sent == 3u);
+	CHECK(x.count == 0u);
+
+	/* last attempt */
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 100u, NULL));
+	CHECK(stub_sent == 3u);
+	CHECK(x.count == 1u);
+	CHECK((int)x.handles[0] == h);
+	CHECK(x.status[0] == CANIOT_CONTROLLER_EVENT_STATUS_TIMEOUT);
+
+	/* A response received during the backoff completes the query */
+	x.count = 0u;
+	h = caniot_controller_query_retry(&ctrl, did, &req, 100u, &policy);
+	CHECK_STRICTLY_POSITIVE(h);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 120u, NULL));
+
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+	CHECK(x.count == 1u);
+	CHECK((int)x.handles[0] == h);
+	CHECK(x.status[0] == CANIOT_CONTROLLER_EVENT_STATUS_OK);
+	CHECK(stub_sent == 4u);
+	const int free = caniot_controller_dbg_free_pendq(&ctrl);
+	CHECK(free == CONFIG_CANIOT_MAX_PENDING_QUERIES);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_RTT
+
+/* Check adaptive timeouts follow the round-trip times measured */
+bool z_func_ctrl_rtt(void)
+{
+	struct caniot_controller ctrl;
+	struct z_func_ctrl_rx_frames_ctx x = {.count = 0u};
+	struct caniot_frame req, resp;
+	int h;
+	const caniot_did_t did		     = gen_rdm_did(false);
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = stub_send,
+		.recv	  = stub_recv,
+	};
+
+	CHECK_0(caniot_controller_driv_init(&ctrl, &driv, z_func_ctrl_rx_frames_cb, &x));
+	CHECK(caniot_controller_rtt_timeout(&ctrl, did) ==
+	      CONFIG_CANIOT_CTRL_RTT_TIMEOUT_INIT_MS);
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+	resp.id.cls   = CANIOT_DID_CLS(did);
+	resp.id.sid   = CANIOT_DID_SID(did);
+
+	/* First sample: SRTT = 40, RTTVAR = 20 */
+	h = caniot_controller_query(&ctrl, did, &req, CANIOT_TIMEOUT_ADAPTIVE);
+	CHECK_STRICTLY_POSITIVE(h);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 40u, &resp));
+	CHECK(caniot_controller_rtt_timeout(&ctrl, did) == 40u + 4u * 20u);
+
+	/* Same round-trip time: RTTVAR decreases to 15 */
+	h = caniot_controller_query(&ctrl, did, &req, CANIOT_TIMEOUT_ADAPTIVE);
+	CHECK_STRICTLY_POSITIVE(h);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 40u, &resp));
+	CHECK(caniot_controller_rtt_timeout(&ctrl, did) == 40u + 4u * 15u);
+	CHECK(x.count == 2u);
+
+	/* The adaptive timeout is applied to the next query */
+	x.count = 0u;
+	h	= caniot_controller_query(&ctrl, did, &req, CANIOT_TIMEOUT_ADAPTIVE);
+	CHECK_STRICTLY_POSITIVE(h);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 99u, NULL));
+	CHECK(x.count == 0u);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, NULL));
+	CHECK(x.count == 1u);
+	CHECK(x.status[0] == CANIOT_CONTROLLER_EVENT_STATUS_TIMEOUT);
+
+	/* Timed out queries are not measured */
+	CHECK(caniot_controller_rtt_timeout(&ctrl, did) == 40u + 4u * 15u);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_METRICS
+
+#define METRICS_TEST_QUERIES 1000u
+
+struct metrics_test_reader {
+	const struct caniot_controller *ctrl;
+	caniot_did_t did;
+	bool stop;
+	bool consistent;
+	uint32_t snapshots;
+};
+
+/* A response and its round-trip time are counted at once, a snapshot never
+ * sees one without the other */
+static void *metrics_test_reader_thread(void *arg)
+{
+	struct metrics_test_reader *r = arg;
+	struct caniot_ctrl_metrics m;
+
+	while (!__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE)) {
+		caniot_controller_metrics_snapshot(r->ctrl, &m);
+
+		uint32_t samples = 0u;
+		for (uint32_t b = 0u; b < CANIOT_CTRL_RTT_BUCKETS; b++) {
+			samples += m.rtt_hist[r->did][b];
+		}
+
+		/* at most one query is waiting for its response */
+		if ((samples != m.ok) || ((m.sent - m.ok - m.timeout) > 1u)) {
+			r->consistent = false;
+		}
+		__atomic_add_fetch(&r->snapshots, 1u, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+/* Check queries are counted per outcome, and that snapshots taken from another
+ * thread are consistent */
+bool z_func_ctrl_metrics(void)
+{
+	struct caniot_controller ctrl;
+	struct caniot_ctrl_metrics m;
+	struct caniot_frame req, resp;
+	pthread_t thread;
+	const caniot_did_t did		     = gen_rdm_did(false);
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = stub_send,
+		.recv	  = stub_recv,
+	};
+	struct metrics_test_reader reader = {
+		.ctrl	    = &ctrl,
+		.did	    = did,
+		.stop	    = false,
+		.consistent = true,
+		.snapshots  = 0u,
+	};
+
+	CHECK_0(caniot_controller_driv_init(
+		&ctrl, &driv, caniot_controller_dbg_event_cb_stub, NULL));
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+	resp.id.cls   = CANIOT_DID_CLS(did);
+	resp.id.sid   = CANIOT_DID_SID(did);
+
+	/* 1 ms and 5 ms round-trip times, then a timeout and an orphan */
+	CHECK_STRICTLY_POSITIVE(caniot_controller_query(&ctrl, did, &req, 100u));
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, &resp));
+	CHECK_STRICTLY_POSITIVE(caniot_controller_query(&ctrl, did, &req, 100u));
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 5u, &resp));
+	CHECK_STRICTLY_POSITIVE(caniot_controller_query(&ctrl, did, &req, 100u));
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 100u, NULL));
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 0u, &resp));
+
+	caniot_controller_metrics_snapshot(&ctrl, &m);
+	CHECK(m.sent == 3u);
+	CHECK(m.ok == 2u);
+	CHECK(m.timeout == 1u);
+	CHECK(m.orphan == 1u);
+	CHECK(m.rtt_hist[did][1u] == 1u);
+	CHECK(m.rtt_hist[did][3u] == 1u);
+
+	CHECK_0(pthread_create(&thread, NULL, metrics_test_reader_thread, &reader));
+
+	for (uint32_t i = 0u; i < METRICS_TEST_QUERIES; i++) {
+		CHECK_STRICTLY_POSITIVE(caniot_controller_query(&ctrl, did, &req, 100u));
+		CHECK_0(caniot_controller_rx_frame(&ctrl, i % 64u, &resp));
+	}
+
+	/* let the reader take at least one snapshot */
+	while (__atomic_load_n(&reader.snapshots, __ATOMIC_RELAXED) == 0u) {
+		usleep(100u);
+	}
+	__atomic_store_n(&reader.stop, true, __ATOMIC_RELEASE);
+	CHECK_0(pthread_join(thread, NULL));
+
+	CHECK(reader.consistent);
+	caniot_controller_metrics_snapshot(&ctrl, &m);
+	CHECK(m.ok == 2u + METRICS_TEST_QUERIES);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_POOL_EXT && CONFIG_CANIOT_CTRL_COALESCE
+
+#define POOL_TEST_SIZE 300u
+
+static struct caniot_pendq pool_test_pool[POOL_TEST_SIZE];
+
+static bool z_func_ctrl_pool_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	TEST_ASSERT(ev->context == CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY);
+
+	(*(uint32_t *)user_data)++;
+
+	return true;
+}
+
+/* Check more than 255 queries can be pending with a caller-provided pool */
+bool z_func_ctrl_pool(void)
+{
+	struct caniot_controller ctrl;
+	struct caniot_frame req, resp;
+	uint32_t events			     = 0u;
+	int h				     = 0;
+	const caniot_did_t did		     = gen_rdm_did(false);
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = stub_send,
+		.recv	  = stub_recv,
+	};
+
+	struct caniot_pendq *const pool = pool_test_pool;
+
+	CHECK(caniot_controller_driv_init_pool(
+		      &ctrl, pool, 0u, &driv, z_func_ctrl_pool_cb, &events) ==
+	      -CANIOT_EINVAL);
+	CHECK(caniot_controller_driv_init_pool(
+		      &ctrl, pool, 65536u, &driv, z_func_ctrl_pool_cb, &events) ==
+	      -CANIOT_EINVAL);
+	CHECK_0(caniot_controller_driv_init_pool(
+		&ctrl, pool, POOL_TEST_SIZE, &driv, z_func_ctrl_pool_cb, &events));
+	CHECK(caniot_controller_dbg_free_pendq(&ctrl) == POOL_TEST_SIZE);
+
+	/* identical queries, coalesced so that the device is never busy */
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	for (uint32_t i = 0u; i < POOL_TEST_SIZE; i++) {
+		h = caniot_controller_query(&ctrl, did, &req, 100u);
+		CHECK_STRICTLY_POSITIVE(h);
+	}
+	CHECK(caniot_controller_query(&ctrl, did, &req, 100u) == -CANIOT_EPQALLOC);
+
+	/* last query allocated, in the first slot of the pool */
+	CHECK(caniot_controller_query_pending(&ctrl, h));
+	CHECK_0(caniot_controller_query_cancel(&ctrl, h, false));
+	CHECK(events == 1u);
+
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+	CHECK(events == POOL_TEST_SIZE);
+	CHECK(caniot_controller_dbg_free_pendq(&ctrl) == POOL_TEST_SIZE);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_HANDLE_GEN
+
+/* Check the handle of a completed query is rejected once its slot is reused */
+bool z_func_ctrl_handle_gen(void)
+{
+	struct caniot_controller ctrl;
+	struct caniot_frame req, resp;
+	int h1, h2;
+	const caniot_did_t did = gen_rdm_did(false);
+
+	CHECK_0(caniot_controller_init(&ctrl, caniot_controller_dbg_event_cb_stub, NULL));
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	h1 = caniot_controller_query_register(&ctrl, did, &req, 100u);
+	CHECK_STRICTLY_POSITIVE(h1);
+	CHECK_0(caniot_controller_query_user_data_set(&ctrl, h1, &h1));
+
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+
+	/* same slot, new generation */
+	h2 = caniot_controller_query_register(&ctrl, did, &req, 100u);
+	CHECK_STRICTLY_POSITIVE(h2);
+	CHECK(h2 != h1);
+	CHECK_0(caniot_controller_query_user_data_set(&ctrl, h2, &h2));
+
+	CHECK(caniot_controller_query_pending(&ctrl, h1) == false);
+	CHECK(caniot_controller_query_user_data_get(&ctrl, h1) == NULL);
+	CHECK(caniot_controller_query_user_data_set(&ctrl, h1, NULL) == -CANIOT_EINVAL);
+	CHECK(caniot_controller_query_cancel(&ctrl, h1, false) == -CANIOT_ENOHANDLE);
+
+	CHECK(caniot_controller_query_pending(&ctrl, h2) == true);
+	CHECK(caniot_controller_query_user_data_get(&ctrl, h2) == &h2);
+	CHECK_0(caniot_controller_query_cancel(&ctrl, h2, false));
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_BULK
+
+#define BULK_TEST_KEYS 8u
+
+/* Frames sent by the controller, answered by the test */
+static struct caniot_frame bulk_test_sent[64u];
+static uint32_t bulk_test_sent_count;
+
+static int bulk_test_send(const struct caniot_frame *frame, uint32_t delay_ms)
+{
+	(void)delay_ms;
+
+	if (bulk_test_sent_count >= ARRAY_SIZE(bulk_test_sent)) return -CANIOT_EDRIVER;
+	bulk_test_sent[bulk_test_sent_count++] = *frame;
+
+	return 0;
+}
+
+static void bulk_test_cb(struct caniot_controller *ctrl,
+			 struct caniot_ctrl_bulk *bulk,
+			 void *user_data)
+{
+	(void)ctrl;
+	(void)bulk;
+
+	(*(uint32_t *)user_data)++;
+}
+
+/* Check attributes are read with the window of queries, and completed once */
+bool z_func_ctrl_bulk(void)
+{
+	struct caniot_controller ctrl;
+	struct caniot_bulk_attr attrs[BULK_TEST_KEYS];
+	struct caniot_frame resp;
+	uint32_t completed = 0u;
+	const caniot_did_t did		     = gen_rdm_did(false);
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = bulk_test_send,
+		.recv	  = stub_recv,
+	};
+	struct caniot_ctrl_bulk bulk = {
+		.did	   = did,
+		.write	   = false,
+		.window	   = BULK_TEST_KEYS,
+		.timeout   = 100u,
+		.attrs	   = attrs,
+		.count	   = BULK_TEST_KEYS,
+		.cb	   = bulk_test_cb,
+		.user_data = &completed,
+	};
+
+	bulk_test_sent_count = 0u;
+	CHECK_0(caniot_controller_driv_init(
+		&ctrl, &driv, caniot_controller_dbg_event_cb_stub, NULL));
+
+	caniot_controller_bulk_keys_range(
+		attrs, BULK_TEST_KEYS, CANIOT_ATTR_KEY_CONFIG_TELEMETRY_PERIOD);
+	CHECK(attrs[1].key == CANIOT_ATTR_KEY_CONFIG_TELEMETRY_DELAY);
+
+	/* the window is bounded by the pipeline depth */
+	CHECK_0(caniot_controller_bulk_start(&ctrl, &bulk));
+	CHECK(caniot_controller_bulk_start(&ctrl, &bulk) == -CANIOT_EBUSY);
+	CHECK(bulk_test_sent_count == CONFIG_CANIOT_CTRL_PIPELINE_DEPTH);
+
+	/* answer queries in order, the 3rd one with an error and the last one
+	 * never: a query is sent for the next attribute after each response */
+	for (uint32_t i = 0u; i < BULK_TEST_KEYS - 1u; i++) {
+		CHECK(i < bulk_test_sent_count);
+
+		const uint16_t key = bulk_test_sent[i].attr.key;
+		CHECK(key == attrs[i].key);
+
+		resp	      = bulk_test_sent[i];
+		resp.id.query = CANIOT_RESPONSE;
+		resp.id.cls   = CANIOT_DID_CLS(did);
+		resp.id.sid   = CANIOT_DID_SID(did);
+		if (i == 2u) {
+			resp.id.type  = CANIOT_FRAME_TYPE_WRITE_ATTRIBUTE;
+			resp.err.code = -CANIOT_EKEYATTR;
+			resp.err.arg  = key;
+		} else {
+			resp.attr.val = 1000u + key;
+		}
+
+		CHECK_0(caniot_controller_rx_frame(&ctrl, 1u, &resp));
+		CHECK(completed == 0u);
+	}
+
+	CHECK(bulk_test_sent_count == BULK_TEST_KEYS);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 100u, NULL));
+	CHECK(completed == 1u);
+	CHECK(bulk.failed == 2u);
+
+	for (uint32_t i = 0u; i < BULK_TEST_KEYS - 1u; i++) {
+		if (i == 2u) {
+			CHECK(attrs[i].status == -CANIOT_EKEYATTR);
+		} else {
+			CHECK_0(attrs[i].status);
+			CHECK(attrs[i].val == 1000u + attrs[i].key);
+		}
+	}
+	CHECK(attrs[BULK_TEST_KEYS - 1u].status == -CANIOT_ETIMEOUT);
+
+	/* cancelled operation: pending and not queried attributes */
+	bulk_test_sent_count = 0u;
+	bulk.window	     = 2u;
+	CHECK_0(caniot_controller_bulk_start(&ctrl, &bulk));
+	CHECK(bulk_test_sent_count == 2u);
+	CHECK_0(caniot_controller_bulk_cancel(&ctrl, &bulk));
+	CHECK(caniot_controller_bulk_cancel(&ctrl, &bulk) == -CANIOT_ENOHANDLE);
+	CHECK(completed == 2u);
+	CHECK(bulk.failed == BULK_TEST_KEYS);
+	CHECK(bulk_test_sent_count == 2u);
+	for (uint32_t i = 0u; i < BULK_TEST_KEYS; i++) {
+		CHECK(attrs[i].status == -CANIOT_ECANCELED);
+	}
+	const int free = caniot_controller_dbg_free_pendq(&ctrl);
+	CHECK(free == CONFIG_CANIOT_MAX_PENDING_QUERIES);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_SHADOW
+
+/* Answer the writes sent by the controller with the value written */
+static bool shadow_test_answer(struct caniot_controller *ctrl, caniot_did_t did)
+{
+	struct caniot_frame resp;
+
+	for (uint32_t i = 0u; i < bulk_test_sent_count; i++) {
+		resp	      = bulk_test_sent[i];
+		resp.id.query = CANIOT_RESPONSE;
+		resp.id.type  = CANIOT_FRAME_TYPE_READ_ATTRIBUTE;
+		resp.id.cls   = CANIOT_DID_CLS(did);
+		resp.id.sid   = CANIOT_DID_SID(did);
+		resp.len      = 6u;
+
+		CHECK_0(caniot_controller_rx_frame(ctrl, 1u, &resp));
+	}
+
+	return true;
+}
+
+/* Check only the configuration attributes which differ from the shadow are
+ * written */
+bool z_func_ctrl_shadow(void)
+{
+	struct caniot_controller ctrl;
+	struct caniot_ctrl_shadow shadow;
+	struct caniot_device_config config;
+	uint32_t completed = 0u;
+	int ret;
+	const caniot_did_t did		     = CANIOT_DID(CANIOT_DEVICE_CLASS0, 1u);
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = bulk_test_send,
+		.recv	  = stub_recv,
+	};
+
+	CHECK_0(caniot_controller_driv_init(
+		&ctrl, &driv, caniot_controller_dbg_event_cb_stub, NULL));
+	CHECK_0(caniot_controller_shadow_attach(&ctrl, did, &shadow));
+
+	for (uint32_t i = 0u; i < sizeof(config); i++) {
+		((uint8_t *)&config)[i] = (uint8_t)rand();
+	}
+
+	/* nothing known: the 13 writable attributes of class 0, telemetry.delay
+	 * and telemetry.delay_min being the same one */
+	bulk_test_sent_count = 0u;
+	ret = caniot_controller_shadow_sync(&ctrl, did, &config, 4u, 100u, bulk_test_cb,
+					    &completed);
+	CHECK(ret == 12);
+	CHECK(shadow_test_answer(&ctrl, did));
+	CHECK(bulk_test_sent_count == 12u);
+	CHECK(completed == 1u);
+	CHECK(shadow.bulk.failed == 0u);
+
+	/* in sync */
+	bulk_test_sent_count = 0u;
+	ret = caniot_controller_shadow_sync(&ctrl, did, &config, 4u, 100u, bulk_test_cb,
+					    &completed);
+	CHECK_0(ret);
+	CHECK(bulk_test_sent_count == 0u);
+
+	/* class 1 attributes are ignored for a class 0 device */
+	config.timezone++;
+	config.telemetry.delay_min++;
+	config.cls0_gpio.outputs_default++;
+	config.cls1_gpio.directions++;
+	ret = caniot_controller_shadow_sync(&ctrl, did, &config, 4u, 100u, bulk_test_cb,
+					    &completed);
+	CHECK(ret == 3);
+	CHECK(shadow.attrs[0].key == CANIOT_ATTR_KEY_CONFIG_TELEMETRY_DELAY);
+	CHECK(shadow.attrs[1].key == CANIOT_ATTR_KEY_CONFIG_TIMEZONE);
+	CHECK(shadow.attrs[2].key == CANIOT_ATTR_KEY_CONFIG_CLS0_GPIO_OUTPUTS_DEFAULT);
+	CHECK(shadow.attrs[1].val == (uint32_t)config.timezone);
+	CHECK(caniot_controller_shadow_attach(&ctrl, did, NULL) == -CANIOT_EBUSY);
+
+	CHECK(shadow_test_answer(&ctrl, did));
+	CHECK(completed == 2u);
+	CHECK(shadow.config.timezone == config.timezone);
+	CHECK_0(memcmp(&shadow.config.cls0_gpio,
+		       &config.cls0_gpio,
+		       sizeof(struct caniot_class0_config)));
+
+	CHECK_0(caniot_controller_shadow_attach(&ctrl, did, NULL));
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_REGISTRY
+
+static bool registry_test_cb(struct caniot_controller *ctrl,
+			     const struct caniot_ctrl_device_info *info,
+			     void *user_data)
+{
+	(void)ctrl;
+
+	uint64_t *const seen = user_data;
+	*seen |= 1llu << info->did;
+
+	return true;
+}
+
+/* Check devices are recorded from any frame received, orphans included */
+bool z_func_ctrl_registry(void)
+{
+	struct caniot_controller ctrl;
+	struct caniot_ctrl_device_info info;
+	struct caniot_frame resp;
+	uint64_t seen = 0u;
+	const caniot_did_t did1 = CANIOT_DID(CANIOT_DEVICE_CLASS1, 2u);
+	const caniot_did_t did2 = CANIOT_DID(CANIOT_DEVICE_CLASS0, 5u);
+
+	CHECK_0(caniot_controller_init(&ctrl, caniot_controller_dbg_event_cb_stub, NULL));
+	CHECK(caniot_controller_registry_alive(&ctrl, CANIOT_TIMEOUT_FOREVER) == 0u);
+	CHECK(caniot_controller_registry_get(&ctrl, did1, &info) == -CANIOT_EDEVICE);
+
+	caniot_build_query_telemetry(&resp, CANIOT_ENDPOINT_APP);
+	resp.id.query = CANIOT_RESPONSE;
+	resp.id.cls   = CANIOT_DID_CLS(did1);
+	resp.id.sid   = CANIOT_DID_SID(did1);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+
+	resp.id.endpoint = CANIOT_ENDPOINT_BOARD_CONTROL;
+	resp.id.cls	 = CANIOT_DID_CLS(did2);
+	resp.id.sid	 = CANIOT_DID_SID(did2);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 100u, &resp));
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 50u, NULL));
+
+	CHECK_0(caniot_controller_registry_get(&ctrl, did1, &info));
+	CHECK(info.did == did1);
+	CHECK(info.cls == CANIOT_DEVICE_CLASS1);
+	CHECK(info.sid == 2u);
+	CHECK(info.age_ms == 150u);
+	CHECK(info.endpoint == CANIOT_ENDPOINT_APP);
+	CHECK(info.type == CANIOT_FRAME_TYPE_TELEMETRY);
+
+	CHECK_0(caniot_controller_registry_get(&ctrl, did2, &info));
+	CHECK(info.age_ms == 50u);
+	CHECK(info.endpoint == CANIOT_ENDPOINT_BOARD_CONTROL);
+
+	CHECK(caniot_controller_registry_alive(&ctrl, CANIOT_TIMEOUT_FOREVER) ==
+	      ((1llu << did1) | (1llu << did2)));
+	CHECK(caniot_controller_registry_alive(&ctrl, 100u) == (1llu << did2));
+
+	const int count =
+		caniot_controller_registry_iterate(&ctrl, 200u, registry_test_cb, &seen);
+	CHECK(count == 2);
+	CHECK(seen == ((1llu << did1) | (1llu << did2)));
+
+	caniot_controller_registry_forget(&ctrl, did2);
+	CHECK(caniot_controller_registry_get(&ctrl, did2, &info) == -CANIOT_EDEVICE);
+	CHECK(caniot_controller_registry_alive(&ctrl, CANIOT_TIMEOUT_FOREVER) ==
+	      (1llu << did1));
+	caniot_controller_registry_forget(&ctrl, CANIOT_DID_BROADCAST);
+	CHECK(caniot_controller_registry_alive(&ctrl, CANIOT_TIMEOUT_FOREVER) == 0u);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_SCHED
+
+#define SCHED_TEST_SENT_MAX 256u
+
+static struct caniot_controller *sched_test_ctrl;
+static struct {
+	caniot_did_t did;
+	uint32_t time_ms;
+} sched_test_sent[SCHED_TEST_SENT_MAX];
+static uint32_t sched_test_sent_count;
+
+static int sched_test_send(const struct caniot_frame *frame, uint32_t delay_ms)
+{
+	(void)delay_ms;
+
+	if (sched_test_sent_count >= SCHED_TEST_SENT_MAX) return -CANIOT_EDRIVER;
+
+	const caniot_did_t did = CANIOT_DID(frame->id.cls, frame->id.sid);
+
+	sched_test_sent[sched_test_sent_count].did     = did;
+	sched_test_sent[sched_test_sent_count].time_ms = sched_test_ctrl->clock_ms;
+	sched_test_sent_count++;
+
+	return 0;
+}
+
+static void sched_test_run(struct caniot_controller *ctrl, uint32_t duration_ms)
+{
+	for (uint32_t t = 0u; t < duration_ms; t++) {
+		caniot_controller_process(ctrl);
+		caniot_controller_rx_frame(ctrl, 1u, NULL);
+	}
+}
+
+/* Check jobs are phased over their period, sent periodically and that the
+ * traffic stays under the load ceiling, high priority jobs first */
+bool z_func_ctrl_sched(void)
+{
+	struct caniot_controller ctrl;
+	struct caniot_frame req, resp;
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = sched_test_send,
+		.recv	  = stub_recv,
+	};
+	int jobs[8u];
+	const uint32_t query_bits = CANIOT_FRAME_BITS_MAX(0u);
+
+	sched_test_ctrl	      = &ctrl;
+	sched_test_sent_count = 0u;
+
+	CHECK_0(caniot_controller_driv_init(
+		&ctrl, &driv, caniot_controller_dbg_event_cb_stub, NULL));
+	CHECK(caniot_controller_sched_next_deadline(&ctrl) == CANIOT_TIMEOUT_FOREVER);
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	CHECK(caniot_controller_sched_add(
+		      &ctrl, CANIOT_DID_BROADCAST, &req, 100u, 50u, 0u) == -CANIOT_EINVAL);
+	CHECK(caniot_controller_sched_add(&ctrl, 1u, &req, 0u, 50u, 0u) == -CANIOT_EINVAL);
+	CHECK(caniot_controller_sched_config(&ctrl, 500000u, 101u) == -CANIOT_EINVAL);
+
+	/* jobs of the same period are spread over it: 0, 1/2, 1/4, 3/4 */
+	for (caniot_did_t did = 1u; did <= 4u; did++) {
+		const int job =
+			caniot_controller_sched_add(&ctrl, did, &req, 100u, 50u, 0u);
+		CHECK(job == (int)did - 1);
+	}
+	CHECK(caniot_controller_sched_next_deadline(&ctrl) == 0u);
+
+	sched_test_run(&ctrl, 400u);
+	CHECK(sched_test_sent_count == 16u);
+	for (uint32_t i = 0u; i < sched_test_sent_count; i++) {
+		static const uint32_t phases[] = {0u, 50u, 25u, 75u};
+		const caniot_did_t did	       = sched_test_sent[i].did;
+
+		CHECK(sched_test_sent[i].time_ms % 100u == phases[did - 1u]);
+	}
+	for (int job = 0; job < 4; job++) {
+		CHECK(ctrl.sched.jobs[job].runs == 4u);
+		CHECK(ctrl.sched.jobs[job].missed == 0u);
+	}
+
+	/* next one is did 1, due at 400 */
+	CHECK(caniot_controller_sched_next_deadline(&ctrl) == 0u);
+	caniot_controller_process(&ctrl);
+	CHECK(caniot_controller_sched_next_deadline(&ctrl) == 25u);
+	CHECK(caniot_controller_next_timeout(&ctrl) <= 25u);
+
+	for (int job = 0; job < 4; job++) {
+		CHECK_0(caniot_controller_sched_remove(&ctrl, job));
+	}
+	CHECK(caniot_controller_sched_remove(&ctrl, 0) == -CANIOT_EINVAL);
+	CHECK(caniot_controller_sched_next_deadline(&ctrl) == CANIOT_TIMEOUT_FOREVER);
+
+	/* frames received are charged to the budget */
+	const int32_t credits = ctrl.sched.credits;
+	resp		      = req;
+	resp.id.query	      = CANIOT_RESPONSE;
+	resp.id.cls	      = CANIOT_DID_CLS(7u);
+	resp.id.sid	      = CANIOT_DID_SID(7u);
+	resp.len	      = 8u;
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 0u, &resp));
+	CHECK(ctrl.sched.credits == credits - (int32_t)CANIOT_FRAME_BITS_MAX(8u));
+
+	/* 1 bit/ms: one high priority job every 100 ms, and 8 low priority jobs
+	 * every 10 ms competing for the rest of the budget */
+	CHECK_0(caniot_controller_sched_config(&ctrl, 10000u, 10u));
+	jobs[0] = caniot_controller_sched_add(&ctrl, 10u, &req, 100u, 50u, 0u);
+	for (caniot_did_t i = 1u; i < ARRAY_SIZE(jobs); i++) {
+		jobs[i] = caniot_controller_sched_add(&ctrl, 10u + i, &req, 10u, 5u, 1u);
+	}
+
+	const int32_t budget  = ctrl.sched.credits;
+	sched_test_sent_count = 0u;
+	sched_test_run(&ctrl, 1000u);
+
+	CHECK(sched_test_sent_count * query_bits <= (uint32_t)budget + 1000u);
+	CHECK(ctrl.sched.jobs[jobs[0]].runs == 10u);
+	CHECK(ctrl.sched.jobs[jobs[0]].missed == 0u);
+
+	uint32_t low_runs = 0u, low_missed = 0u;
+	for (uint32_t i = 1u; i < ARRAY_SIZE(jobs); i++) {
+		low_runs += ctrl.sched.jobs[jobs[i]].runs;
+		low_missed += ctrl.sched.jobs[jobs[i]].missed;
+	}
+	CHECK(low_runs > 0u);
+	CHECK(low_missed > 0u);
+	CHECK(low_runs + 10u == sched_test_sent_count);
+
+	caniot_controller_deinit(&ctrl);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_BUSLOAD
+
+/* Bit-serial reference: frame bits are laid out one at a time, the CRC is
+ * computed a bit at a time and stuff bits are inserted as on the bus */
+static uint32_t busload_test_ref_bits(uint16_t std_id, const uint8_t *data, uint8_t len)
+{
+	uint8_t bits[128u];
+	uint32_t n    = 0u;
+	uint16_t crc  = 0u;
+	uint32_t run  = 0u;
+	uint8_t level = 2u;
+	uint32_t total;
+
+	bits[n++] = 0u; /* SOF */
+	for (int i = 10; i >= 0; i--) {
+		bits[n++] = (std_id >> i) & 1u;
+	}
+	bits[n++] = 0u; /* RTR */
+	bits[n++] = 0u; /* IDE */
+	bits[n++] = 0u; /* r0 */
+	for (int i = 3; i >= 0; i--) {
+		bits[n++] = (len >> i) & 1u;
+	}
+	for (uint8_t b = 0u; b < len; b++) {
+		for (int i = 7; i >= 0; i--) {
+			bits[n++] = (data[b] >> i) & 1u;
+		}
+	}
+
+	for (uint32_t i = 0u; i < n; i++) {
+		const uint8_t feedback = bits[i] ^ ((crc >> 14u) & 1u);
+
+		crc = (crc << 1u) & 0x7FFFu;
+		if (feedback) crc ^= 0x4599u;
+	}
+	for (int i = 14; i >= 0; i--) {
+		bits[n++] = (crc >> i) & 1u;
+	}
+
+	total = n;
+	for (uint32_t i = 0u; i < n; i++) {
+		run   = (bits[i] == level) ? run + 1u : 1u;
+		level = bits[i];
+		if (run == 5u) {
+			/* the stuff bit starts a run of the opposite level */
+			total++;
+			level = !level;
+			run   = 1u;
+		}
+	}
+
+	return total + 13u;
+}
+
+static uint32_t busload_test_ms;
+
+static void busload_test_get_time(uint32_t *sec, uint16_t *ms)
+{
+	*sec = busload_test_ms / 1000u;
+	if (ms != NULL) *ms = busload_test_ms % 1000u;
+}
+
+/* Check exact bit counts against the bit-serial reference and the worst case,
+ * the rolling meter and the controller hooks */
+bool z_func_busload(void)
+{
+	struct caniot_frame frames[64u];
+	uint32_t bits[ARRAY_SIZE(frames)];
+	uint64_t sum = 0u;
+	uint8_t data[8u];
+
+	/* all dominant: 34 bits, a stuff bit every 5 bits */
+	memset(data, 0x00u, sizeof(data));
+	CHECK(caniot_can_frame_bits(0u, data, 0u) == 34u + 6u + 13u);
+	CHECK(busload_test_ref_bits(0u, data, 0u) == 34u + 6u + 13u);
+
+	for (uint32_t i = 0u; i < 2000u; i++) {
+		const uint16_t std_id = (uint16_t)rand_range(0u, 0x7FFu);
+		const uint8_t len     = (uint8_t)rand_range(0u, 8u);
+		const uint8_t pattern = (uint8_t)rand_range(0u, 3u);
+
+		for (uint8_t b = 0u; b < len; b++) {
+			/* long runs are more likely to reveal stuffing errors */
+			data[b] = (pattern == 0u) ? r8() : (pattern == 1u) ? 0x00u
+						   : (pattern == 2u) ? 0xFFu
+								     : 0x0Fu;
+		}
+
+		const uint32_t b = caniot_can_frame_bits(std_id, data, len);
+
+		CHECK(b == busload_test_ref_bits(std_id, data, len));
+		CHECK(b <= CANIOT_FRAME_BITS_MAX(len));
+		CHECK(b >= 47u + 8u * len);
+	}
+
+	/* traces */
+	for (uint32_t i = 0u; i < ARRAY_SIZE(frames); i++) {
+		caniot_build_query_telemetry(&frames[i], CANIOT_ENDPOINT_APP);
+		frames[i].id.cls = CANIOT_DID_CLS(rand_range(0u, 63u));
+		frames[i].id.sid = CANIOT_DID_SID(rand_range(0u, 63u));
+		frames[i].len	 = (uint8_t)rand_range(0u, 8u);
+		for (uint8_t b = 0u; b < frames[i].len; b++) {
+			frames[i].buf[b] = r8();
+		}
+		sum += caniot_frame_bits(&frames[i]);
+	}
+	CHECK(caniot_frames_bits(frames, ARRAY_SIZE(frames), bits) == sum);
+	CHECK(caniot_frames_bits(frames, ARRAY_SIZE(frames), NULL) == sum);
+	for (uint32_t i = 0u; i < ARRAY_SIZE(frames); i++) {
+		CHECK(bits[i] == caniot_frame_bits(&frames[i]));
+	}
+
+	/* meter: 1000 bits per bucket at 10 kbit/s is 100 % */
+	const uint32_t bucket_ms = CONFIG_CANIOT_BUSLOAD_BUCKET_MS;
+	const uint32_t window_ms = bucket_ms * (CONFIG_CANIOT_BUSLOAD_BUCKETS - 1u);
+	struct caniot_busload bl;
+
+	caniot_busload_init(&bl, 10000u * 100u / bucket_ms, 1000u);
+	CHECK(caniot_busload_get(&bl, 1000u) == 0u);
+
+	for (uint32_t t = 0u; t < CONFIG_CANIOT_BUSLOAD_BUCKETS; t++) {
+		caniot_busload_add(&bl, 1000u + t * bucket_ms, 500u);
+		caniot_busload_add(&bl, 1000u + t * bucket_ms + bucket_ms / 2u, 500u);
+	}
+	CHECK(bl.frames == 2u * CONFIG_CANIOT_BUSLOAD_BUCKETS);
+	CHECK(bl.bits == 1000u * CONFIG_CANIOT_BUSLOAD_BUCKETS);
+
+	/* window of BUCKETS - 1 full buckets plus half of the current one */
+	const uint32_t now = 1000u + window_ms + bucket_ms / 2u;
+	CHECK(caniot_busload_window_bits(&bl, now) ==
+	      1000u * CONFIG_CANIOT_BUSLOAD_BUCKETS);
+	CHECK(caniot_busload_get(&bl, now) ==
+	      10000u * CONFIG_CANIOT_BUSLOAD_BUCKETS * bucket_ms /
+		      (window_ms + bucket_ms / 2u));
+
+	/* the oldest bucket rolls out */
+	CHECK(caniot_busload_window_bits(&bl, now + bucket_ms) ==
+	      1000u * (CONFIG_CANIOT_BUSLOAD_BUCKETS - 1u));
+
+	/* a long idle period clears all buckets */
+	CHECK(caniot_busload_get(&bl, now + 100u * window_ms) == 0u);
+
+	/* controller: frames sent and received are accounted */
+	struct caniot_controller ctrl;
+	struct caniot_frame req, resp;
+	const struct caniot_drivers_api driv = {
+		.get_time = busload_test_get_time,
+		.send	  = stub_send,
+		.recv	  = stub_recv,
+	};
+
+	busload_test_ms = 0u;
+	caniot_busload_init(&bl, 500000u, 0u);
+	CHECK_0(caniot_controller_driv_init(
+		&ctrl, &driv, caniot_controller_dbg_event_cb_stub, NULL));
+	caniot_controller_busload_attach(&ctrl, &bl);
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	CHECK(caniot_controller_query(&ctrl, 3u, &req, 0u) == 0);
+	req.id.cls = CANIOT_DID_CLS(3u);
+	req.id.sid = CANIOT_DID_SID(3u);
+	CHECK(bl.frames == 1u);
+	CHECK(bl.bits == caniot_frame_bits(&req));
+
+	resp	      = req;
+	resp.id.query = CANIOT_RESPONSE;
+	resp.len      = 8u;
+	memset(resp.buf, 0x55u, sizeof(resp.buf));
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+	CHECK(bl.frames == 2u);
+	CHECK(bl.bits == caniot_frame_bits(&req) + caniot_frame_bits(&resp));
+	CHECK(bl.head_ms == 0u);
+
+	caniot_controller_busload_attach(&ctrl, NULL);
+	CHECK_0(caniot_controller_rx_frame(&ctrl, 10u, &resp));
+	CHECK(bl.frames == 2u);
+
+	caniot_controller_deinit(&ctrl);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_TXQ
+
+#define TXQ_TEST_SENT_MAX 16u
+
+/* Driver with "txq_test_mailbox" free slots, failing if "txq_test_fail" */
+static uint32_t txq_test_mailbox;
+static bool txq_test_fail;
+static uint16_t txq_test_sent[TXQ_TEST_SENT_MAX];
+static uint32_t txq_test_sent_count;
+
+static caniot_controller_event_t txq_test_ev;
+static uint32_t txq_test_ev_count;
+
+static int txq_test_send(const struct caniot_frame *frame, uint32_t delay_ms)
+{
+	if (delay_ms != 0u) return -CANIOT_EINVAL;
+	if (txq_test_fail) return -CANIOT_EDRIVER;
+	if (txq_test_mailbox == 0u) return -CANIOT_EAGAIN;
+	if (txq_test_sent_count >= TXQ_TEST_SENT_MAX) return -CANIOT_EDRIVER;
+
+	txq_test_mailbox--;
+	txq_test_sent[txq_test_sent_count++] = caniot_id_to_canid(frame->id);
+
+	return 0;
+}
+
+static bool txq_test_event_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	(void)user_data;
+
+	txq_test_ev = *ev;
+	txq_test_ev_count++;
+
+	return true;
+}
+
+static void txq_test_frame(struct caniot_frame *frame, caniot_did_t did, uint8_t mark)
+{
+	caniot_build_query_telemetry(frame, CANIOT_ENDPOINT_APP);
+	frame->id.cls = CANIOT_DID_CLS(did);
+	frame->id.sid = CANIOT_DID_SID(did);
+	frame->len    = 1u;
+	frame->buf[0] = mark;
+}
+
+/* Check released frames leave by order of CAN identifier then of insertion,
+ * that the controller flushes its queue as the mailbox frees up, and that a
+ * query whose frame is dropped is cancelled right away */
+bool z_func_txq(void)
+{
+	struct caniot_txq txq;
+	struct caniot_txq_item *item;
+	struct caniot_frame frame;
+
+	caniot_txq_init(&txq);
+	CHECK(caniot_txq_peek(&txq, 0u) == NULL);
+	CHECK(caniot_txq_next_release(&txq, 0u) == UINT32_MAX);
+
+	for (uint32_t i = 0u; i < CONFIG_CANIOT_TXQ_SIZE; i++) {
+		txq_test_frame(&frame, (caniot_did_t)rand_range(0u, 62u), (uint8_t)i);
+		const uint32_t delay = (uint32_t)rand_range(0u, 3u);
+
+		CHECK_0(caniot_txq_push(&txq, &frame, 1000u, delay, 0u));
+	}
+	CHECK(caniot_txq_push(&txq, &frame, 1000u, 0u, 0u) == -CANIOT_EAGAIN);
+	CHECK(txq.stats.full == 1u);
+	CHECK(txq.stats.high_watermark == CONFIG_CANIOT_TXQ_SIZE);
+
+	/* at each ms, the frames released leave by order of identifier, the
+	 * ones with the same identifier by order of insertion */
+	for (uint32_t now = 1000u; caniot_txq_count(&txq) != 0u; now++) {
+		uint16_t last_id  = 0u;
+		uint8_t last_mark = 0u;
+		bool first	  = true;
+
+		while ((item = caniot_txq_peek(&txq, now)) != NULL) {
+			CHECK((int32_t)(now - item->release_ms) >= 0);
+			CHECK(first || (item->can_id > last_id) ||
+			      ((item->can_id == last_id) &&
+			       (item->frame.buf[0] > last_mark)));
+
+			last_id	  = item->can_id;
+			last_mark = item->frame.buf[0];
+			first	  = false;
+			caniot_txq_remove(&txq, item);
+		}
+
+		const uint32_t next = caniot_txq_next_release(&txq, now);
+		CHECK((caniot_txq_count(&txq) == 0u) ? (next == UINT32_MAX)
+						     : (next >= 1u));
+	}
+
+	txq_test_frame(&frame, 1u, 0u);
+	CHECK_0(caniot_txq_push(&txq, &frame, UINT32_MAX - 1u, 5u, 0u));
+	CHECK(caniot_txq_next_release(&txq, UINT32_MAX - 1u) == 5u);
+	CHECK(caniot_txq_peek(&txq, 2u) == NULL);
+	CHECK(caniot_txq_peek(&txq, 3u) != NULL);
+
+	/* controller: queries wait for the mailbox */
+	struct caniot_controller ctrl;
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = txq_test_send,
+		.recv	  = stub_recv,
+	};
+	static const caniot_did_t dids[] = {40u, 3u, 17u, 3u, 60u};
+
+	txq_test_mailbox    = 0u;
+	txq_test_sent_count = 0u;
+	CHECK_0(caniot_controller_driv_init(
+		&ctrl, &driv, caniot_controller_dbg_event_cb_stub, NULL));
+
+	for (uint32_t i = 0u; i < ARRAY_SIZE(dids); i++) {
+		txq_test_frame(&frame, dids[i], (uint8_t)i);
+		CHECK(caniot_controller_query(&ctrl, dids[i], &frame, 0u) == 0);
+	}
+	CHECK(txq_test_sent_count == 0u);
+	CHECK(caniot_txq_count(&ctrl.txq) == ARRAY_SIZE(dids));
+	CHECK(caniot_controller_next_timeout(&ctrl) <= 1u);
+
+	txq_test_mailbox = 2u;
+	CHECK_0(caniot_controller_process(&ctrl));
+	CHECK(txq_test_sent_count == 2u);
+
+	txq_test_mailbox = 8u;
+	CHECK_0(caniot_controller_process(&ctrl));
+	CHECK(txq_test_sent_count == ARRAY_SIZE(dids));
+	CHECK(caniot_txq_count(&ctrl.txq) == 0u);
+	CHECK(ctrl.txq.stats.sent == ARRAY_SIZE(dids));
+	CHECK(ctrl.txq.stats.mailbox_full >= 2u);
+	CHECK(caniot_controller_next_timeout(&ctrl) == CANIOT_TIMEOUT_FOREVER);
+
+	for (uint32_t i = 1u; i < txq_test_sent_count; i++) {
+		CHECK(txq_test_sent[i - 1u] <= txq_test_sent[i]);
+	}
+
+#if CONFIG_CANIOT_CTRL_METRICS
+	struct caniot_ctrl_metrics metrics;
+	caniot_controller_metrics_snapshot(&ctrl, &metrics);
+	CHECK(metrics.sent == ARRAY_SIZE(dids));
+#endif
+
+	caniot_controller_deinit(&ctrl);
+
+	/* a query waiting for the mailbox is cancelled once its frame is dropped,
+	 * a query failing to send its frame right away is not registered */
+	txq_test_mailbox  = 0u;
+	txq_test_fail	  = false;
+	txq_test_ev_count = 0u;
+	CHECK_0(caniot_controller_driv_init(&ctrl, &driv, txq_test_event_cb, NULL));
+
+	txq_test_frame(&frame, 12u, 0u);
+	const int handle = caniot_controller_query(&ctrl, 12u, &frame, 10000u);
+	CHECK(handle > 0);
+	CHECK(caniot_controller_next_timeout(&ctrl) == 1u);
+
+	txq_test_fail = true;
+	txq_test_frame(&frame, 13u, 1u);
+	CHECK(caniot_controller_query(&ctrl, 13u, &frame, 10000u) == -CANIOT_EDRIVER);
+	CHECK(caniot_txq_count(&ctrl.txq) == 0u);
+	CHECK(ctrl.txq.stats.dropped == 2u);
+	CHECK(caniot_controller_next_timeout(&ctrl) == 0u);
+
+	CHECK_0(caniot_controller_process(&ctrl));
+	CHECK(txq_test_ev_count == 1u);
+	CHECK(txq_test_ev.status == CANIOT_CONTROLLER_EVENT_STATUS_CANCELLED);
+	CHECK(txq_test_ev.handle == (caniot_handle_t)handle);
+	CHECK(txq_test_ev.terminated == 1u);
+	CHECK(caniot_controller_query_pending(&ctrl, (caniot_handle_t)handle) == false);
+	CHECK(caniot_controller_next_timeout(&ctrl) == CANIOT_TIMEOUT_FOREVER);
+
+	/* a frame sent without query fails with the driver error */
+	txq_test_fail = true;
+	txq_test_frame(&frame, 14u, 2u);
+	CHECK(caniot_controller_send(&ctrl, 14u, &frame) == -CANIOT_EDRIVER);
+	CHECK(caniot_txq_count(&ctrl.txq) == 0u);
+	CHECK(ctrl.txq.stats.dropped == 3u);
+	CHECK(txq_test_ev_count == 1u);
+
+	txq_test_fail = false;
+	caniot_controller_deinit(&ctrl);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_DEVICE_DRIVERS_API && CONFIG_CANIOT_DRIVERS_BURST_SIZE && \
+	!CONFIG_CANIOT_TXQ
+
+#define DEV_BURST_TEST_DID CANIOT_DID(CANIOT_DEVICE_CLASS1, 3u)
+
+/* Device drivers: the requests of "dev_burst_test_reqs" are received at once,
+ * send_burst() and send() accept up to "*_accept" frames */
+static struct caniot_frame dev_burst_test_reqs[4u];
+static uint32_t dev_burst_test_req_count;
+static uint32_t dev_burst_test_burst_accept;
+static uint32_t dev_burst_test_accept;
+static uint32_t dev_burst_test_fail;
+static uint32_t dev_burst_test_sent;
+
+static int dev_burst_test_recv_burst(struct caniot_frame *frames, size_t max)
+{
+	const uint32_t count = MIN(dev_burst_test_req_count, max);
+
+	memcpy(frames, dev_burst_test_reqs, count * sizeof(frames[0]));
+	dev_burst_test_req_count = 0u;
+
+	return (int)count;
+}
+
+static int dev_burst_test_send_burst(const struct caniot_frame *frames,
+				     size_t count,
+				     const uint32_t *delays_ms)
+{
+	(void)frames;
+	(void)delays_ms;
+
+	const uint32_t sent = MIN(count, dev_burst_test_burst_accept);
+
+	dev_burst_test_burst_accept -= sent;
+	dev_burst_test_sent += sent;
+
+	return (int)sent;
+}
+
+static int dev_burst_test_send(const struct caniot_frame *frame, uint32_t delay_ms)
+{
+	(void)frame;
+	(void)delay_ms;
+
+	if (dev_burst_test_fail != 0u) {
+		dev_burst_test_fail--;
+		return -CANIOT_EDRIVER;
+	}
+
+	if (dev_burst_test_accept == 0u) return -CANIOT_EAGAIN;
+
+	dev_burst_test_accept--;
+	dev_burst_test_sent++;
+
+	return 0;
+}
+
+static int dev_burst_test_telemetry(struct caniot_device *dev,
+				    caniot_endpoint_t ep,
+				    unsigned char *buf,
+				    uint8_t *len)
+{
+	(void)dev;
+	(void)ep;
+
+	buf[0] = 0x42u;
+	*len   = 1u;
+
+	return 0;
+}
+
+static void dev_burst_test_receive(uint32_t count)
+{
+	for (uint32_t i = 0u; i < count; i++) {
+		caniot_build_query_telemetry(&dev_burst_test_reqs[i], CANIOT_ENDPOINT_APP);
+		dev_burst_test_reqs[i].id.cls = CANIOT_DID_CLS(DEV_BURST_TEST_DID);
+		dev_burst_test_reqs[i].id.sid = CANIOT_DID_SID(DEV_BURST_TEST_DID);
+	}
+
+	dev_burst_test_req_count = count;
+}
+
+/* Check no response is lost when send_burst() only takes some of them */
+bool z_func_dev_burst(void)
+{
+	const struct caniot_device_id id = {.did = DEV_BURST_TEST_DID};
+	struct caniot_device_config config = CANIOT_CONFIG_DEFAULT_INIT();
+	const struct caniot_device_api api =
+		CANIOT_DEVICE_API_MIN_INIT(NULL, dev_burst_test_telemetry);
+	const struct caniot_drivers_api driv = {
+		.get_time   = stub_get_time,
+		.send	    = dev_burst_test_send,
+		.recv	    = stub_recv,
+		.recv_burst = dev_burst_test_recv_burst,
+		.send_burst = dev_burst_test_send_burst,
+	};
+	struct caniot_device dev = {
+		.identification = &id,
+		.config		= &config,
+		.api		= &api,
+		.driv		= &driv,
+	};
+
+	caniot_app_init(&dev);
+	dev_burst_test_sent = 0u;
+
+	/* all responses sent at once */
+	dev_burst_test_receive(4u);
+	dev_burst_test_burst_accept = 4u;
+	dev_burst_test_accept	    = 0u;
+	CHECK_0(caniot_device_process(&dev));
+	CHECK(dev_burst_test_sent == 4u);
+	CHECK(dev.system.sent.total == 4u);
+
+	/* send_burst() takes 1 response, the others are sent one by one */
+	dev_burst_test_receive(4u);
+	dev_burst_test_burst_accept = 1u;
+	dev_burst_test_accept	    = 3u;
+	CHECK_0(caniot_device_process(&dev));
+	CHECK(dev_burst_test_sent == 8u);
+	CHECK(dev.system.sent.total == 8u);
+
+	/* the mailbox is full: the caller is told */
+	dev_burst_test_receive(4u);
+	dev_burst_test_burst_accept = 2u;
+	dev_burst_test_accept	    = 0u;
+	CHECK(caniot_device_process(&dev) == -CANIOT_EAGAIN);
+	CHECK(dev_burst_test_sent == 10u);
+	CHECK(dev.system.sent.total == 10u);
+
+	/* a response fails to be sent: it is dropped, the next ones are sent */
+	dev_burst_test_receive(4u);
+	dev_burst_test_burst_accept = 1u;
+	dev_burst_test_accept	    = 2u;
+	dev_burst_test_fail	    = 1u;
+	CHECK(caniot_device_process(&dev) == -CANIOT_EDRIVER);
+	CHECK(dev_burst_test_sent == 13u);
+	CHECK(dev.system.sent.total == 13u);
+
+	/* no request: nothing to send */
+	CHECK(caniot_device_process(&dev) == -CANIOT_EAGAIN);
+	CHECK(dev_burst_test_sent == 13u);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_SOCKETCAN
+
+/* Check a delayed frame which fails to be sent is dropped and counted, the
+ * socket is a datagram socket pair whose peer is closed */
+bool z_func_socketcan_delayed_drop(void)
+{
+	struct caniot_socketcan sc = {.delayed_count = 0u, .delayed_dropped = 0u};
+	struct caniot_frame frame;
+	int fds[2];
+
+	CHECK_0(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0, fds));
+	sc.fd = fds[0];
+
+	caniot_build_query_telemetry(&frame, CANIOT_ENDPOINT_APP);
+	CHECK_0(caniot_socketcan_send(&sc, &frame, 1u));
+	CHECK(sc.delayed_count == 1u);
+
+	close(fds[1]);
+	usleep(2000u);
+
+	/* the delayed frame is sent (and dropped) before the new one */
+	CHECK(caniot_socketcan_send(&sc, &frame, 0u) == -CANIOT_EDRIVER);
+	CHECK(sc.delayed_count == 0u);
+	CHECK(sc.delayed_dropped == 1u);
+
+	close(fds[0]);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_SOCKETCAN && CONFIG_CANIOT_DRIVERS_BURST_SIZE
+
+/* Check send_burst() only reports the leading frames it sent or delayed, the
+ * socket is a datagram socket pair whose queue fills up */
+bool z_func_socketcan_send_burst(void)
+{
+	struct caniot_socketcan sc = {.delayed_count = 0u};
+	struct caniot_frame frames[CANIOT_SOCKETCAN_BURST_MAX];
+	uint32_t delays[CANIOT_SOCKETCAN_BURST_MAX];
+	struct can_frame cf;
+	uint32_t index = 0u, sent = 0u;
+	int fds[2];
+
+	CHECK_0(socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK, 0, fds));
+	sc.fd = fds[0];
+
+	/* every 8th frame is delayed */
+	for (uint32_t i = 0u; i < ARRAY_SIZE(frames); i++) {
+		caniot_build_query_telemetry(&frames[i], CANIOT_ENDPOINT_APP);
+		frames[i].buf[0] = (uint8_t)i;
+		frames[i].len	 = 1u;
+		delays[i]	 = (i % 8u == 7u) ? 60000u : 0u;
+	}
+
+	const int ret =
+		caniot_socketcan_send_burst(&sc, frames, ARRAY_SIZE(frames), delays);
+	CHECK(ret > 0);
+
+	while (read(fds[1], &cf, sizeof(cf)) == sizeof(cf)) {
+		/* frames leave in order, delayed ones are skipped */
+		if (index % 8u == 7u) index++;
+		CHECK(cf.data[0] == index);
+		index++;
+		sent++;
+	}
+
+	/* frames sent and delayed are the leading ones */
+	CHECK(sc.delayed_count == (uint32_t)ret / 8u);
+	CHECK(sent + sc.delayed_count == (uint32_t)ret);
+
+	close(fds[0]);
+	close(fds[1]);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+
+#define SUBMIT_TEST_PRODUCERS 4u
+#define SUBMIT_TEST_QUERIES   500u
+
+static uint32_t submit_test_next[SUBMIT_TEST_PRODUCERS];
+static bool submit_test_order_ok;
+
+/* user_data encodes the producer index and the query sequence number */
+static void submit_test_cb(struct caniot_controller *ctrl, int ret, void *user_data)
+{
+	(void)ctrl;
+
+	const uintptr_t x	 = (uintptr_t)user_data;
+	const uint32_t producer = x % SUBMIT_TEST_PRODUCERS;
+	const uint32_t seq	 = x / SUBMIT_TEST_PRODUCERS;
+
+	/* queries of a producer are performed in submission order */
+	if ((ret != 0) || (submit_test_next[producer]++ != seq)) {
+		submit_test_order_ok = false;
+	}
+}
+
+struct submit_test_producer {
+	struct caniot_controller *ctrl;
+	uint32_t index;
+};
+
+static void *submit_test_producer_thread(void *arg)
+{
+	struct submit_test_producer *p = arg;
+	struct caniot_frame req;
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+
+	for (uint32_t seq = 0u; seq < SUBMIT_TEST_QUERIES; seq++) {
+		const uintptr_t x = seq * SUBMIT_TEST_PRODUCERS + p->index;
+		void *user_data	  = (void *)x;
+
+		while (caniot_controller_submit(
+			       p->ctrl, p->index, &req, 0u, submit_test_cb, user_data) ==
+		       -CANIOT_EAGAIN) {
+		}
+	}
+
+	return NULL;
+}
+
+/* Check queries submitted concurrently are all performed, in order per producer */
+bool z_func_ctrl_submit(void)
+{
+	struct caniot_controller ctrl;
+	pthread_t threads[SUBMIT_TEST_PRODUCERS];
+	struct submit_test_producer producers[SUBMIT_TEST_PRODUCERS];
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = stub_send,
+		.recv	  = stub_recv,
+	};
+
+	stub_sent	     = 0u;
+	submit_test_order_ok = true;
+	memset(submit_test_next, 0x00u, sizeof(submit_test_next));
+
+	CHECK_0(caniot_controller_driv_init(
+		&ctrl, &driv, caniot_controller_dbg_event_cb_stub, NULL));
+
+	for (uint32_t i = 0u; i < SUBMIT_TEST_PRODUCERS; i++) {
+		producers[i].ctrl  = &ctrl;
+		producers[i].index = i;
+		CHECK_0(pthread_create(
+			&threads[i], NULL, submit_test_producer_thread, &producers[i]));
+	}
+
+	while (stub_sent < SUBMIT_TEST_PRODUCERS * SUBMIT_TEST_QUERIES) {
+		CHECK_0(caniot_controller_process(&ctrl));
+		usleep(100u);
+	}
+
+	for (uint32_t i = 0u; i < SUBMIT_TEST_PRODUCERS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	CHECK_0(caniot_controller_process(&ctrl));
+	CHECK(stub_sent == SUBMIT_TEST_PRODUCERS * SUBMIT_TEST_QUERIES);
+	CHECK(submit_test_order_ok);
+
+	return true;
+}
+
+static uint32_t submit_test_cancelled;
+
+static void submit_test_cancel_cb(struct caniot_controller *ctrl,
+				  int ret,
+				  void *user_data)
+{
+	(void)ctrl;
+	(void)user_data;
+
+	if (ret == -CANIOT_ECANCELED) submit_test_cancelled++;
+}
+
+/* Check queries still in the submission ring are completed on deinit */
+bool z_func_ctrl_submit_cancel(void)
+{
+	struct caniot_controller ctrl;
+	struct caniot_frame req;
+	const struct caniot_drivers_api driv = {
+		.get_time = stub_get_time,
+		.send	  = stub_send,
+		.recv	  = stub_recv,
+	};
+
+	stub_sent	      = 0u;
+	submit_test_cancelled = 0u;
+
+	CHECK_0(caniot_controller_driv_init(
+		&ctrl, &driv, caniot_controller_dbg_event_cb_stub, NULL));
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	CHECK_0(caniot_controller_submit(
+		&ctrl, 1u, &req, 0u, submit_test_cancel_cb, NULL));
+	CHECK_0(caniot_controller_submit(
+		&ctrl, 2u, &req, 0u, submit_test_cancel_cb, NULL));
+
+	CHECK_0(caniot_controller_deinit(&ctrl));
+
+	CHECK(submit_test_cancelled == 2u);
+	CHECK(stub_sent == 0u);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_GROUP
+
+#define GROUP_TEST_BUSES 2u
+
+/* Loopback drivers: bus "n" answers every query sent by its controller */
+static struct caniot_frame group_test_resp[GROUP_TEST_BUSES];
+static bool group_test_resp_ready[GROUP_TEST_BUSES];
+static uint32_t group_test_events[GROUP_TEST_BUSES];
+
+static int group_test_send(uint8_t bus, const struct caniot_frame *frame)
+{
+	group_test_resp[bus]	      = *frame;
+	group_test_resp[bus].id.query = CANIOT_RESPONSE;
+	group_test_resp_ready[bus]    = true;
+
+	return 0;
+}
+
+static int group_test_recv(uint8_t bus, struct caniot_frame *frame)
+{
+	if (!group_test_resp_ready[bus]) return -CANIOT_EAGAIN;
+
+	*frame			   = group_test_resp[bus];
+	group_test_resp_ready[bus] = false;
+
+	return 0;
+}
+
+static int group_test_send0(const struct caniot_frame *frame, uint32_t delay_ms)
+{
+	(void)delay_ms;
+	return group_test_send(0u, frame);
+}
+
+static int group_test_recv0(struct caniot_frame *frame)
+{
+	return group_test_recv(0u, frame);
+}
+
+static int group_test_send1(const struct caniot_frame *frame, uint32_t delay_ms)
+{
+	(void)delay_ms;
+	return group_test_send(1u, frame);
+}
+
+static int group_test_recv1(struct caniot_frame *frame)
+{
+	return group_test_recv(1u, frame);
+}
+
+static bool group_test_cb(struct caniot_ctrl_group *group,
+			  uint8_t bus,
+			  const caniot_controller_event_t *ev,
+			  void *user_data)
+{
+	(void)group;
+	(void)user_data;
+
+	TEST_ASSERT(ev->context == CANIOT_CONTROLLER_EVENT_CONTEXT_QUERY);
+	TEST_ASSERT(ev->status == CANIOT_CONTROLLER_EVENT_STATUS_OK);
+
+	/* Each bus only carries queries to the device matching its index */
+	TEST_ASSERT(ev->did == bus);
+	TEST_ASSERT((uintptr_t)ev->user_data == bus);
+
+	__atomic_add_fetch(&group_test_events[bus], 1u, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/* Check queries are routed to their bus and events come back tagged with it */
+bool z_func_ctrl_group(void)
+{
+	struct caniot_ctrl_group group;
+	struct caniot_frame req;
+	const struct caniot_drivers_api drivs[GROUP_TEST_BUSES] = {
+		{.get_time = stub_get_time,
+		 .send	   = group_test_send0,
+		 .recv	   = group_test_recv0},
+		{.get_time = stub_get_time,
+		 .send	   = group_test_send1,
+		 .recv	   = group_test_recv1},
+	};
+
+	memset(group_test_events, 0x00u, sizeof(group_test_events));
+	memset(group_test_resp_ready, 0x00u, sizeof(group_test_resp_ready));
+
+	CHECK_0(caniot_ctrl_group_init(&group, group_test_cb, NULL));
+	for (uint8_t bus = 0u; bus < GROUP_TEST_BUSES; bus++) {
+		CHECK(caniot_ctrl_group_add_bus(&group, &drivs[bus]) == bus);
+	}
+	group.poll_period_us = 100u;
+	CHECK_0(caniot_ctrl_group_start(&group));
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	for (uint8_t bus = 0u; bus < GROUP_TEST_BUSES; bus++) {
+		CHECK_0(caniot_ctrl_group_submit(
+			&group, bus, bus, &req, 1000u, NULL, (void *)(uintptr_t)bus));
+	}
+	CHECK(caniot_ctrl_group_submit(
+		      &group, GROUP_TEST_BUSES, 0u, &req, 1000u, NULL, NULL) == -CANIOT_EINVAL);
+
+	for (uint32_t i = 0u; i < 1000u; i++) {
+		if ((__atomic_load_n(&group_test_events[0], __ATOMIC_ACQUIRE) == 1u) &&
+		    (__atomic_load_n(&group_test_events[1], __ATOMIC_ACQUIRE) == 1u)) {
+			break;
+		}
+		usleep(1000u);
+	}
+
+	CHECK_0(caniot_ctrl_group_stop(&group));
+
+	CHECK(group_test_events[0] == 1u);
+	CHECK(group_test_events[1] == 1u);
+
+	return true;
+}
+
+#endif
+
+#if CONFIG_CANIOT_CTRL_EVQ
+
+#define EVQ_TEST_EXTRA 4u
+
+static uint32_t evq_test_order[CONFIG_CANIOT_CTRL_EVQ_SIZE + EVQ_TEST_EXTRA];
+static uint32_t evq_test_count;
+static struct caniot_frame evq_test_resp;
+
+static bool evq_test_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	(void)user_data;
+
+	const uint32_t n = __atomic_fetch_add(&evq_test_count, 1u, __ATOMIC_RELAXED);
+	if (n < ARRAY_SIZE(evq_test_order)) {
+		evq_test_order[n] = (uint32_t)(uintptr_t)ev->user_data;
+	}
+	if (ev->response) {
+		evq_test_resp = *ev->response;
+	}
+
+	return true;
+}
+
+static void evq_test_post(struct caniot_ctrl_evq *evq, uint32_t n)
+{
+	caniot_controller_event_t ev;
+
+	memset(&ev, 0x00u, sizeof(ev));
+	for (uint32_t i = 0u; i < n; i++) {
+		ev.user_data = (void *)(uintptr_t)i;
+		caniot_ctrl_evq_post(&ev, evq);
+	}
+}
+
+/* Check overflow policies, drop counters and copy of response frames */
+bool z_func_ctrl_evq(void)
+{
+	struct caniot_ctrl_evq evq;
+	struct caniot_ctrl_evq_stats stats;
+	caniot_controller_event_t ev;
+	struct caniot_frame resp;
+	pthread_t workers[2u];
+	const uint32_t size = CONFIG_CANIOT_CTRL_EVQ_SIZE;
+
+	/* drop newest: first events are kept */
+	evq_test_count = 0u;
+	CHECK_0(caniot_ctrl_evq_init(
+		&evq, CANIOT_CTRL_EVQ_DROP_NEWEST, evq_test_cb, NULL));
+	evq_test_post(&evq, size + EVQ_TEST_EXTRA);
+	while (caniot_ctrl_evq_dispatch(&evq, false) == 1) {
+	}
+	caniot_ctrl_evq_stats_get(&evq, &stats);
+	CHECK(evq_test_count == size);
+	for (uint32_t i = 0u; i < size; i++) {
+		CHECK(evq_test_order[i] == i);
+	}
+	CHECK(stats.posted == size);
+	CHECK(stats.dispatched == size);
+	CHECK(stats.dropped_newest == EVQ_TEST_EXTRA);
+	CHECK(stats.dropped_oldest == 0u);
+	CHECK(stats.high_watermark == size);
+	caniot_ctrl_evq_deinit(&evq);
+
+	/* drop oldest: last events are kept */
+	evq_test_count = 0u;
+	CHECK_0(caniot_ctrl_evq_init(
+		&evq, CANIOT_CTRL_EVQ_DROP_OLDEST, evq_test_cb, NULL));
+	evq_test_post(&evq, size + EVQ_TEST_EXTRA);
+	while (caniot_ctrl_evq_dispatch(&evq, false) == 1) {
+	}
+	caniot_ctrl_evq_stats_get(&evq, &stats);
+	CHECK(evq_test_count == size);
+	for (uint32_t i = 0u; i < size; i++) {
+		CHECK(evq_test_order[i] == i + EVQ_TEST_EXTRA);
+	}
+	CHECK(stats.posted == size + EVQ_TEST_EXTRA);
+	CHECK(stats.dropped_oldest == EVQ_TEST_EXTRA);
+	CHECK(stats.dropped_newest == 0u);
+
+	/* the response frame is copied when posted */
+	memset(&ev, 0x00u, sizeof(ev));
+	caniot_build_query_telemetry(&resp, CANIOT_ENDPOINT_BOARD_CONTROL);
+	resp.len    = 1u;
+	resp.buf[0] = 0x5Au;
+	ev.response = &resp;
+	caniot_ctrl_evq_post(&ev, &evq);
+	resp.buf[0] = 0x00u;
+	CHECK(caniot_ctrl_evq_dispatch(&evq, false) == 1);
+	CHECK(evq_test_resp.buf[0] == 0x5Au);
+	CHECK(evq_test_resp.id.endpoint == CANIOT_ENDPOINT_BOARD_CONTROL);
+	CHECK(caniot_ctrl_evq_dispatch(&evq, false) == 0);
+	caniot_ctrl_evq_deinit(&evq);
+
+	/* block: nothing is dropped while workers drain the queue */
+	evq_test_count = 0u;
+	CHECK_0(caniot_ctrl_evq_init(&evq, CANIOT_CTRL_EVQ_BLOCK, evq_test_cb, NULL));
+	for (uint32_t i = 0u; i < ARRAY_SIZE(workers); i++) {
+		CHECK_0(pthread_create(&workers[i], NULL, caniot_ctrl_evq_worker, &evq));
+	}
+	evq_test_post(&evq, 100u * size);
+	caniot_ctrl_evq_close(&evq);
+	for (uint32_t i = 0u; i < ARRAY_SIZE(workers); i++) {
+		CHECK_0(pthread_join(workers[i], NULL));
+	}
+	caniot_ctrl_evq_stats_get(&evq, &stats);
+	CHECK(evq_test_count == 100u * size);
+	CHECK(stats.dispatched == 100u * size);
+	CHECK(stats.dropped_oldest == 0u);
+	CHECK(stats.dropped_newest == 0u);
+	CHECK(stats.high_watermark <= size);
+
+	/* events posted once closed are dropped */
+	evq_test_post(&evq, 1u);
+	caniot_ctrl_evq_stats_get(&evq, &stats);
+	CHECK(stats.dropped_newest == 1u);
+	caniot_ctrl_evq_deinit(&evq);
+
+	return true;
+}
+
+#endif
+
+/*____________________________________________________________________________*/
+
+#define TWHEEL_TEST_NODES 64u
+
+/* Check nodes expire exactly when their timeout is reached, whatever the level
+ * they have been queued in, and that next_timeout() matches the earliest one */
+bool z_func_twheel_expiry(void)
+{
+	struct caniot_twheel wheel;
+	struct caniot_twheel_node nodes[TWHEEL_TEST_NODES];
+	uint32_t timeouts[TWHEEL_TEST_NODES];
+	bool expired[TWHEEL_TEST_NODES] = {false};
+	uint32_t elapsed		= 0u;
+	uint32_t remaining		= TWHEEL_TEST_NODES;
+
+	caniot_twheel_init(&wheel);
+	caniot_twheel_advance(&wheel, rand_range(0u, 1000000u));
+
+	for (uint32_t i = 0u; i < TWHEEL_TEST_NODES; i++) {
+		timeouts[i] = rand_range(1u, (i & 1u) ? 300u : 20000000u);
+		caniot_twheel_add(&wheel, &nodes[i], timeouts[i]);
+	}
+
+	while (remaining != 0u) {
+		uint32_t next = (uint32_t)-1;
+		for (uint32_t i = 0u; i < TWHEEL_TEST_NODES; i++) {
+			if (!expired[i]) next = MIN(next, timeouts[i] - elapsed);
+		}
+		CHECK(caniot_twheel_next_timeout(&wheel) == next);
+
+		const uint32_t step = rand_range(1u, 2u * next);
+		caniot_twheel_advance(&wheel, step);
+		elapsed += step;
+
+		struct caniot_twheel_node *node;
+		while ((node = caniot_twheel_pop_expired(&wheel)) != NULL) {
+			const uint32_t i = node - nodes;
+			CHECK(!expired[i] && (timeouts[i] <= elapsed));
+			expired[i] = true;
+			remaining--;
+		}
+
+		for (uint32_t i = 0u; i < TWHEEL_TEST_NODES; i++) {
+			CHECK(expired[i] || (timeouts[i] > elapsed));
+		}
+	}
+
+	CHECK(caniot_twheel_next_timeout(&wheel) == (uint32_t)-1);
+	CHECK(caniot_twheel_pop(&wheel) == NULL);
+
+	return true;
+}
+
+/* Check cancelled nodes never expire and leave the wheel empty */
+bool z_func_twheel_cancel(void)
+{
+	struct caniot_twheel wheel;
+	struct caniot_twheel_node nodes[TWHEEL_TEST_NODES];
+
+	caniot_twheel_init(&wheel);
+
+	for (uint32_t i = 0u; i < TWHEEL_TEST_NODES; i++) {
+		caniot_twheel_add(&wheel, &nodes[i], rand_range(1u, 100000u));
+	}
+
+	for (uint32_t i = 0u; i < TWHEEL_TEST_NODES; i += 2u) {
+		CHECK(caniot_twheel_remove(&wheel, &nodes[i]) == true);
+		CHECK(caniot_twheel_remove(&wheel, &nodes[i]) == false);
+	}
+
+	caniot_twheel_advance(&wheel, 100000u);
+
+	uint32_t count = 0u;
+	struct caniot_twheel_node *node;
+	while ((node = caniot_twheel_pop_expired(&wheel)) != NULL) {
+		CHECK(((node - nodes) & 1u) == 1u);
+		count++;
+	}
+	CHECK(count == TWHEEL_TEST_NODES / 2u);
+
+	for (uint32_t i = 0u; i < CANIOT_TWHEEL_LEVELS; i++) {
+		CHECK(wheel.occupied[i] == 0u);
+	}
+
+	return true;
+}
+
+/*____________________________________________________________________________*/
+
+/* C++ coroutine front-end, see test_coro.cpp */
+bool z_func_ctrl_coro(void);
+
 /*____________________________________________________________________________*/
 
 struct test {
@@ -528,6 +3117,85 @@ const struct test tests[] = {
 	TEST(z_func_ctrl3, 1U),
 	TEST(z_func_ctrl4, 1U),
 	TEST(z_func_dev0, 1U),
+#if CONFIG_CANIOT_CTRL_PIPELINE_DEPTH > 1
+	TEST(z_func_ctrl_pipeline, 10U),
+#endif
+	TEST(z_func_ctrl_forever, 10U),
+	TEST(z_func_ctrl_rx_frames, 10U),
+#if CONFIG_CANIOT_CTRL_BCAST_EXPECT
+	TEST(z_func_ctrl_broadcast_expect, 1U),
+#if CONFIG_CANIOT_CONTROLLER_DISCOVERY && CONFIG_CANIOT_CTRL_DRIVERS_API
+	TEST(z_func_ctrl_discovery_expect, 1U),
+#endif
+#endif
+#if CONFIG_CANIOT_CTRL_BCAST_AGGREGATE
+	TEST(z_func_ctrl_aggregate, 1U),
+#endif
+#if CONFIG_CANIOT_DRIVERS_BURST_SIZE
+	TEST(z_func_ctrl_recv_burst, 1U),
+#endif
+#if CONFIG_CANIOT_CTRL_CACHE
+	TEST(z_func_ctrl_cache, 10U),
+#endif
+#if CONFIG_CANIOT_CTRL_COALESCE
+	TEST(z_func_ctrl_coalesce, 10U),
+#endif
+#if CONFIG_CANIOT_CTRL_RETRY
+	TEST(z_func_ctrl_retry, 10U),
+#endif
+#if CONFIG_CANIOT_CTRL_RTT
+	TEST(z_func_ctrl_rtt, 10U),
+#endif
+#if CONFIG_CANIOT_CTRL_METRICS
+	TEST(z_func_ctrl_metrics, 2U),
+#endif
+#if CONFIG_CANIOT_CTRL_POOL_EXT && CONFIG_CANIOT_CTRL_COALESCE
+	TEST(z_func_ctrl_pool, 1U),
+#endif
+#if CONFIG_CANIOT_CTRL_HANDLE_GEN
+	TEST(z_func_ctrl_handle_gen, 10U),
+#endif
+#if CONFIG_CANIOT_CTRL_BULK
+	TEST(z_func_ctrl_bulk, 10U),
+#endif
+#if CONFIG_CANIOT_CTRL_SHADOW
+	TEST(z_func_ctrl_shadow, 10U),
+#endif
+#if CONFIG_CANIOT_CTRL_REGISTRY
+	TEST(z_func_ctrl_registry, 1U),
+#endif
+#if CONFIG_CANIOT_CTRL_SCHED
+	TEST(z_func_ctrl_sched, 1U),
+#endif
+#if CONFIG_CANIOT_BUSLOAD
+	TEST(z_func_busload, 1U),
+#endif
+#if CONFIG_CANIOT_TXQ
+	TEST(z_func_txq, 5U),
+#endif
+#if CONFIG_CANIOT_DEVICE_DRIVERS_API && CONFIG_CANIOT_DRIVERS_BURST_SIZE && \
+	!CONFIG_CANIOT_TXQ
+	TEST(z_func_dev_burst, 1U),
+#endif
+#if CONFIG_CANIOT_SOCKETCAN
+	TEST(z_func_socketcan_delayed_drop, 1U),
+#endif
+#if CONFIG_CANIOT_SOCKETCAN && CONFIG_CANIOT_DRIVERS_BURST_SIZE
+	TEST(z_func_socketcan_send_burst, 1U),
+#endif
+#if CONFIG_CANIOT_CTRL_SUBMIT_RING_SIZE
+	TEST(z_func_ctrl_submit, 5U),
+	TEST(z_func_ctrl_submit_cancel, 5U),
+#endif
+#if CONFIG_CANIOT_CTRL_GROUP
+	TEST(z_func_ctrl_group, 5U),
+#endif
+#if CONFIG_CANIOT_CTRL_EVQ
+	TEST(z_func_ctrl_evq, 5U),
+#endif
+	TEST(z_func_ctrl_coro, 1U),
+	TEST(z_func_twheel_expiry, 20U),
+	TEST(z_func_twheel_cancel, 20U),
 };
 
 int main(void)
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2023 Lucas Dietrich <ld.adecy@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cstring>
+
+#include <caniot/caniot_private.h>
+#include <caniot/controller.hpp>
+
+#define CHECK(statement)                                                                 \
+	if ((statement) == false) {                                                      \
+		return false;                                                            \
+	}
+
+/* Loopback drivers: queries to devices below CORO_TEST_DEAD_DID are answered */
+#define CORO_TEST_DEAD_DID 32u
+#define CORO_TEST_RESP_MAX 8u
+
+static struct caniot_frame coro_test_resp[CORO_TEST_RESP_MAX];
+static uint32_t coro_test_resp_count;
+static uint32_t coro_test_ms;
+static uint32_t coro_test_unsolicited;
+static bool coro_test_cb_ret;
+
+static void coro_test_get_time(uint32_t *sec, uint16_t *ms)
+{
+	*sec = coro_test_ms / 1000u;
+	if (ms != NULL) *ms = coro_test_ms % 1000u;
+}
+
+static int coro_test_send(const struct caniot_frame *frame, uint32_t delay_ms)
+{
+	(void)delay_ms;
+
+	const caniot_did_t did = CANIOT_DID(frame->id.cls, frame->id.sid);
+
+	if (did < CORO_TEST_DEAD_DID && coro_test_resp_count < CORO_TEST_RESP_MAX) {
+		struct caniot_frame *const resp = &coro_test_resp[coro_test_resp_count++];
+
+		*resp	       = *frame;
+		resp->id.query = CANIOT_RESPONSE;
+		resp->len      = 8u;
+		memset(resp->buf, did, sizeof(resp->buf));
+	}
+
+	return 0;
+}
+
+static int coro_test_recv(struct caniot_frame *frame)
+{
+	if (coro_test_resp_count == 0u) return -CANIOT_EAGAIN;
+
+	*frame = coro_test_resp[0u];
+	memmove(&coro_test_resp[0u],
+		&coro_test_resp[1u],
+		--coro_test_resp_count * sizeof(coro_test_resp[0u]));
+
+	return 0;
+}
+
+static bool coro_test_cb(const caniot_controller_event_t *ev, void *user_data)
+{
+	(void)ev;
+	(void)user_data;
+
+	coro_test_unsolicited++;
+
+	return coro_test_cb_ret;
+}
+
+static caniot::task coro_test_poll(caniot::controller &ctrl,
+				   caniot_did_t did,
+				   uint32_t count,
+				   uint32_t &ok,
+				   caniot_controller_event_status_t &last)
+{
+	struct caniot_frame req;
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+
+	for (uint32_t i = 0u; i < count; i++) {
+		const caniot::query_result res = co_await ctrl.query(did, req, 100u);
+
+		last = res.status;
+		if (!res.ok()) break;
+		if (res.did != did || res.response.buf[0] != did) break;
+
+		ok++;
+	}
+}
+
+static caniot::task coro_test_untracked(caniot::controller &ctrl, int &ret)
+{
+	struct caniot_frame req;
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+
+	const caniot::query_result res = co_await ctrl.query(1u, req, 0u);
+
+	ret = res.ret;
+}
+
+static caniot::task coro_test_bcast(caniot::controller &ctrl,
+				    caniot_controller_event_status_t &status)
+{
+	struct caniot_frame req;
+
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+
+	const caniot::query_result res =
+		co_await ctrl.query(CANIOT_DID_BROADCAST, req, 100u);
+
+	status = res.status;
+}
+
+/* Check awaited queries resume on response and timeout, that destroying a
+ * suspended coroutine cancels its query, and that an awaited broadcast query
+ * goes on whatever the event callback returns for its responses */
+extern "C" bool z_func_ctrl_coro(void)
+{
+	struct caniot_drivers_api driv = {};
+	caniot_controller_event_status_t alive_status, dead_status, orphan_status;
+	uint32_t alive_ok = 0u, dead_ok = 0u, orphan_ok = 0u;
+
+	driv.get_time = coro_test_get_time;
+	driv.send     = coro_test_send;
+	driv.recv     = coro_test_recv;
+
+	coro_test_ms	      = 0u;
+	coro_test_resp_count  = 0u;
+	coro_test_unsolicited = 0u;
+	coro_test_cb_ret      = true;
+
+	caniot::controller ctrl(&driv, coro_test_cb, NULL);
+	CHECK(ctrl.init_ret() == 0);
+
+	caniot::task alive = coro_test_poll(ctrl, 1u, 3u, alive_ok, alive_status);
+	caniot::task dead  = coro_test_poll(
+		 ctrl, CORO_TEST_DEAD_DID, 3u, dead_ok, dead_status);
+	caniot::task orphan = coro_test_poll(
+		ctrl, CORO_TEST_DEAD_DID + 1u, 1u, orphan_ok, orphan_status);
+	CHECK(ctrl.pending_count() == 3u);
+
+	/* responses to "alive" queries complete them one after the other */
+	for (uint32_t i = 0u; i < 3u; i++) {
+		CHECK(ctrl.process() == 0);
+	}
+	CHECK(alive.done());
+	CHECK(alive_ok == 3u);
+	CHECK(alive_status == CANIOT_CONTROLLER_EVENT_STATUS_OK);
+	CHECK(!dead.done());
+
+	/* destroying a suspended coroutine cancels its query, without event */
+	orphan.reset();
+	CHECK(ctrl.pending_count() == 1u);
+
+	/* "dead" queries time out */
+	coro_test_ms += 100u;
+	CHECK(ctrl.process() == 0);
+	CHECK(dead.done());
+	CHECK(dead_ok == 0u);
+	CHECK(dead_status == CANIOT_CONTROLLER_EVENT_STATUS_TIMEOUT);
+	CHECK(ctrl.pending_count() == 0u);
+	CHECK(coro_test_unsolicited == 0u);
+
+	/* events of queries not awaited are passed to the event callback */
+	struct caniot_frame req;
+	caniot_build_query_telemetry(&req, CANIOT_ENDPOINT_APP);
+	CHECK(caniot_controller_query(ctrl.get(), 2u, &req, 100u) > 0);
+	CHECK(ctrl.process() == 0);
+	CHECK(coro_test_unsolicited == 1u);
+
+	/* an untracked query cannot be awaited */
+	int ret			= 0;
+	caniot::task untracked	= coro_test_untracked(ctrl, ret);
+	CHECK(untracked.done());
+	CHECK(ret == -CANIOT_EINVAL);
+
+	/* responses to an awaited broadcast query are passed to the event
+	 * callback, the coroutine resumes on timeout even if it returned false */
+	caniot_controller_event_status_t bcast_status = CANIOT_CONTROLLER_EVENT_STATUS_OK;
+	caniot::task bcast = coro_test_bcast(ctrl, bcast_status);
+	CHECK(ctrl.pending_count() == 1u);
+
+	coro_test_cb_ret      = false;
+	coro_test_unsolicited = 0u;
+	for (caniot_did_t did = 1u; did <= 2u; did++) {
+		struct caniot_frame *const resp = &coro_test_resp[coro_test_resp_count++];
+
+		*resp	       = req;
+		resp->id.query = CANIOT_RESPONSE;
+		resp->id.cls   = CANIOT_DID_CLS(did);
+		resp->id.sid   = CANIOT_DID_SID(did);
+		resp->len      = 8u;
+		memset(resp->buf, did, sizeof(resp->buf));
+	}
+	CHECK(ctrl.process() == 0);
+	CHECK(coro_test_unsolicited == 2u);
+	CHECK(!bcast.done());
+	CHECK(ctrl.pending_count() == 1u);
+
+	coro_test_ms += 100u;
+	CHECK(ctrl.process() == 0);
+	CHECK(bcast.done());
+	CHECK(bcast_status == CANIOT_CONTROLLER_EVENT_STATUS_TIMEOUT);
+	CHECK(ctrl.pending_count() == 0u);
+	coro_test_cb_ret = true;
+
+	return true;
+}